@@ -0,0 +1,73 @@
+/**
+*
+* This header contains the rate monotonic schedulability analysis of the
+* fixed priority services, run from the measured execution times
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>   // for bool
+
+#include "../includes/services.h"
+
+#define ANALYSIS_MAX_ITERATIONS   (1000)       // response time iterations before giving up
+
+// Result of one periodic fixed priority service
+typedef struct {
+  const service_desc_t *svc;
+  int core;                                    // core the service is analyzed on
+  long long wcet_ns;                           // measured maximum, the configured WCET before the first job
+  bool measured;
+  long long period_ns;                         // period, also the deadline
+  long long response_ns;                       // worst case response time, -1 if past the deadline
+  double margin;                               // (deadline - response) / deadline
+}analysis_result_t;
+
+// Utilization test of one core
+typedef struct {
+  int core;
+  int nservices;
+  double utilization;
+  double ll_bound;                             // Liu-Layland bound n(2^(1/n) - 1)
+}analysis_core_t;
+
+/**
+ * @brief Function to run the Liu-Layland utilization test and the exact
+ * response time analysis on every core. Only periodic SCHED_FIFO/RR
+ * services take part, each on the first core of its list, with the
+ * deadline equal to the period.
+ * @param table - service table
+ * @param results - one entry per analyzed service, SERVICE_MAX entries
+ * @param nresults - number of results
+ * @param cores - one entry per core in use, SERVICE_MAX entries
+ * @param ncores - number of cores
+ * @return number of services whose response time exceeds the deadline
+ */
+int analysis_run(const service_table_t *table, analysis_result_t *results, int *nresults,
+                 analysis_core_t *cores, int *ncores);
+
+/**
+ * @brief Function to run the analysis and report the margin of every
+ * service to syslog
+ * @param table - service table
+ * @param verbose - also print the report to stdout
+ * @return number of services whose response time exceeds the deadline
+ */
+int analysis_report(const service_table_t *table, bool verbose);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // ANALYSIS_H
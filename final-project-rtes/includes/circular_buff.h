@@ -53,12 +53,35 @@ typedef enum {
   END_OF_ENUM_PTR_TYPE  
 }pointer_type_t;
 
+// Pixel formats held in the frame buffer
+typedef enum {
+  FRAME_FORMAT_RGB,                          // packed RGB24, dumped as P6 PPM
+  FRAME_FORMAT_GRAY                          // luma plane from the YUYV Y samples, dumped as P5 PGM
+}frame_format_t;
+
+// Stages a frame passes on its way from the camera to the disk, stamped
+// on the pipeline clock (trace_now()) as the frame reaches them
+typedef enum {
+  FRAME_STAGE_CAPTURED,                      // dequeued from V4L2 or read from the replay
+  FRAME_STAGE_STORED,                        // converted into the frame buffer
+  FRAME_STAGE_DIFFERENCED,                   // compared with the previous frame
+  FRAME_STAGE_SELECTED,                      // picked by frame selection
+  FRAME_STAGE_QUEUED,                        // pushed to the writeback queue
+  FRAME_STAGE_DEQUEUED,                      // taken by a writeback worker
+  FRAME_STAGE_WRITTEN,                       // written out by the worker
+  FRAME_STAGE_COMMITTED,                     // committed in frame count order
+  FRAME_STAGES
+}frame_stage_t;
+
 
 typedef struct {
   struct timespec timestamp;                 // timestamp in milliseconds for the acquired frame
   int usefulness;                            // usefulness of the frame. 1=useful, -1=not useful, 0=not marked 
   int size;                                  // size of the buffer     
   unsigned int frame_count;                  // frame count for the frame data                   
+  frame_format_t format;                     // pixel format of the frame data
+  int64_t stage_ns[FRAME_STAGES];            // time each stage was reached, 0 if it was not
+  unsigned char *native;                     // packed YUYV 4:2:2 as captured, NULL unless kept for the Y4M sink
   unsigned char buffer[MAX_BUFFER_LENGTH];   // buffer for storing frame data
 }cbuff_struct_t;
 
@@ -74,8 +97,11 @@ bool circular_buff_unlock(void);
 cbuff_struct_t *get_wptr(cbuff_struct_t *frame_buffer);
 int getMSfromTimestamp(struct timespec *time);
 bool write_framecount(cbuff_struct_t *frame_buffer, int framecount);
+bool write_stage_time(cbuff_struct_t *frame_buffer, pointer_type_t type, frame_stage_t stage, int64_t ns);
 cbuff_struct_t *read_cbuf_entry(cbuff_struct_t *frame_buffer);
 void print_cbuf_info(void);
+int  get_cbuf_depth(void);                   // frames held in the buffer, read without locking
+unsigned long long get_cbuf_frames(void);    // frames written since start, read without locking
 //void init_circular_buffer(cbuff_struct_t *global_buff);
 unsigned char *read_frame_ptr(cbuff_struct_t *frame_buffer, pointer_type_t type, int *size);
 
@@ -29,6 +29,33 @@ int differencing(cbuff_struct_t *frame_buffer);
 int frame_select(cbuff_struct_t *frame_buffer);
 unsigned int getFrameCount(void);
 
+/**
+ * @brief Function to count the pixels of a frame that changed from the
+ * previous one by more than the difference threshold
+ * @param new - current frame
+ * @param prev - previous frame
+ * @param size - frame size in bytes
+ * @param stride - pixel stride, the count is scaled back up by it
+ * @return changed pixels, -ERROR_BUFFER_SIZE if the frame is too large
+ */
+int perform_diff(unsigned char *new, unsigned char *prev, int size, int stride);
+
+/**
+ * @brief Function to make differencing compare every stride-th pixel only,
+ * the cheaper kernel used when differencing sheds load
+ * @param stride - pixel stride, 1 compares every pixel
+ * @return no return
+ */
+void set_diff_stride(int stride);
+
+/**
+ * @brief Function to lower the frame selection rate while selection is
+ * degraded, frames are selected FRAME_SELECTION_TIME_MS * divider apart
+ * @param divider - rate divider, 1 is FRAME_SELECTION_RATE_HZ
+ * @return no return
+ */
+void set_selection_divider(int divider);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -49,6 +49,7 @@ extern "C" {
 
 #define FRAME_RATE_SET        (60)
 #define YUV_TO_RGB_FACTOR     (6/4)
+#define NATIVE_FRAME_LENGTH   (HRES * VRES * 2)   // packed YUYV 4:2:2
 
 // capture buffer defination
 struct buffer {
@@ -108,6 +109,67 @@ void uninit_device(void);
  */
 void read_frames(const int fd, cbuff_struct_t *frame_buffer);
 
+/**
+ * @brief Function to read a frame from the replay source instead of the
+ * camera, see replay.h
+ * @param frame_buffer - circular buffer
+ * @param offset_ns - release time since the start of the recording, the
+ * frame shown then is stored with that timestamp
+ * @return no return
+ */
+void read_replay_frame(cbuff_struct_t *frame_buffer, long long offset_ns);
+
+/**
+ * @brief Function to convert a packed YUYV frame to packed RGB24
+ * @param p - YUYV frame
+ * @param size - size of the YUYV frame
+ * @param bigbuffer - output buffer, size*3/2 bytes
+ * @return no return
+ */
+void process_image(const void *p, int size, unsigned char *bigbuffer);
+
+/**
+ * @brief Function to extract the luma plane of a packed YUYV frame
+ * @param p - YUYV frame
+ * @param size - size of the YUYV frame
+ * @param graybuffer - output buffer, size/2 bytes
+ * @return no return
+ */
+void process_image_gray(const void *p, int size, unsigned char *graybuffer);
+
+/**
+ * @brief Function to select the pixel format stored in the frame buffer.
+ * Must be called before the capture service is started.
+ * @param format - FRAME_FORMAT_RGB or FRAME_FORMAT_GRAY
+ * @return no return
+ */
+void set_frame_format(frame_format_t format);
+
+/**
+ * @brief Function to keep the packed YUYV of every frame next to the
+ * stored format, for a sink that writes YUV without converting back from
+ * RGB. The replay has no YUYV, its RGB frames are converted once at
+ * capture. Must be called before the capture service is started.
+ * @param frame_buffer - circular buffer
+ * @param entries - number of entries in the buffer
+ * @return 0 on success, -1 out of memory
+ */
+int keep_native_frames(cbuff_struct_t *frame_buffer, int entries);
+
+/**
+ * @brief Function to free the YUYV copies of keep_native_frames()
+ * @param frame_buffer - circular buffer
+ * @param entries - number of entries in the buffer
+ * @return no return
+ */
+void release_native_frames(cbuff_struct_t *frame_buffer, int entries);
+
+/**
+ * @brief Function to get the pixel format stored in the frame buffer
+ * @return format - current frame format
+ */
+frame_format_t get_frame_format(void);
+
 
 #ifdef	__cplusplus
 }
@@ -0,0 +1,93 @@
+/**
+*
+* This header contains the helper functions for writing frame files to
+* storage, either through the page cache or with aligned O_DIRECT writes.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef FRAMEIO_H
+#define FRAMEIO_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>    // for uint8_t etc.
+#include <stdbool.h>   // for bool
+
+#define FRAMEIO_ALIGNMENT        (4096)          // O_DIRECT buffer, offset and length alignment
+#define FRAMEIO_MAX_FSYNC_BATCH  (64)            // files held open waiting for a batched fsync
+#define FRAMEIO_MEMINFO_FILES    (4)             // page cache sampled every that many retired files
+
+// Output modes
+typedef enum {
+  FRAMEIO_BUFFERED,                              // plain write() through the page cache
+  FRAMEIO_DIRECT                                 // fallocate + aligned O_DIRECT writes
+}frameio_mode_t;
+
+// Counters for the output path
+typedef struct {
+  unsigned long long files;                      // frame files written
+  unsigned long long bytes;                      // payload bytes written (header included)
+  unsigned long long direct_writes;              // files written with O_DIRECT
+  unsigned long long buffered_writes;            // files written through the page cache
+  unsigned long long direct_fallbacks;           // O_DIRECT refused by the filesystem
+  unsigned long long fallocate_failures;         // preallocation not supported
+  unsigned long long fsyncs;                     // fdatasync calls issued by the batch policy
+  unsigned long long fadvise_calls;              // posix_fadvise(DONTNEED) calls
+  long dirty_kb_start;                           // /proc/meminfo Dirty at init
+  long dirty_kb_max;                             // highest Dirty seen in the samples
+  long cached_kb_start;                          // /proc/meminfo Cached at init
+  long cached_kb_last;                           // Cached at the last sample
+  unsigned long long meminfo_samples;            // /proc/meminfo reads after init
+}frameio_stats_t;
+
+/**
+ * @brief Function to select the output mode and fsync policy
+ * @param mode - FRAMEIO_BUFFERED or FRAMEIO_DIRECT
+ * @param fsync_batch - fdatasync every fsync_batch files, 0 to never sync
+ * @return no return
+ */
+void frameio_init(frameio_mode_t mode, int fsync_batch);
+
+/**
+ * @brief Function to write one frame file made of a header and a payload
+ * @param path - file to create
+ * @param header - header bytes
+ * @param header_len - header length
+ * @param payload - frame data
+ * @param size - frame data length
+ * @return bytes written, -1 on error
+ */
+int frameio_write(const char *path, const char *header, int header_len,
+                  const unsigned char *payload, int size);
+
+/**
+ * @brief Function to sync and close any files still waiting for a batched fsync
+ * @return no return
+ */
+void frameio_flush(void);
+
+/**
+ * @brief Function to copy the output counters
+ * @param stats - destination for the counters
+ * @return no return
+ */
+void frameio_get_stats(frameio_stats_t *stats);
+
+/**
+ * @brief Function to print the output counters
+ * @return no return
+ */
+void frameio_print_stats(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // FRAMEIO_H
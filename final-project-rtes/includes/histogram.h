@@ -0,0 +1,89 @@
+/**
+*
+* This header contains the fixed memory log-linear latency histograms
+* recorded by the services
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Values below 2^HISTOGRAM_SUB_BITS ns are counted exactly, above that
+// every power of two is split in 2^(HISTOGRAM_SUB_BITS - 1) buckets, so a
+// percentile is within 1/64 (1.6%) of the recorded value. Values beyond
+// 2^HISTOGRAM_MAX_BITS ns (9 minutes) land in the last bucket.
+#define HISTOGRAM_SUB_BITS     (7)
+#define HISTOGRAM_MAX_BITS     (39)
+#define HISTOGRAM_HALF_SUB     (1 << (HISTOGRAM_SUB_BITS - 1))
+#define HISTOGRAM_BUCKETS      ((1 << HISTOGRAM_SUB_BITS) + \
+                                (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_HALF_SUB)
+
+typedef struct {
+  uint64_t count;
+  int64_t min;
+  int64_t max;
+  int64_t sum;
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+}histogram_t;
+
+// Percentile summary in ns
+typedef struct {
+  uint64_t count;
+  int64_t min;
+  int64_t mean;
+  int64_t p50;
+  int64_t p90;
+  int64_t p99;
+  int64_t p999;
+  int64_t max;
+}histogram_summary_t;
+
+/**
+ * @brief Function to clear a histogram, also needed before the first use
+ * @param hist - histogram
+ * @return no return
+ */
+void histogram_reset(histogram_t *hist);
+
+/**
+ * @brief Function to record a value. Lock-free and allocation free, several
+ * threads may record into one histogram. Negative values count as 0.
+ * @param hist - histogram
+ * @param value - value in ns
+ * @return no return
+ */
+void histogram_record(histogram_t *hist, int64_t value);
+
+/**
+ * @brief Function to get the value below which a share of the recorded
+ * values lies, the upper end of its bucket
+ * @param hist - histogram
+ * @param percentile - 0.0 .. 100.0
+ * @return value in ns, 0 if the histogram is empty
+ */
+int64_t histogram_percentile(const histogram_t *hist, double percentile);
+
+/**
+ * @brief Function to summarize a histogram, safe while it is recorded into
+ * @param hist - histogram
+ * @param summary - count, min, mean, p50, p90, p99, p99.9 and max
+ * @return no return
+ */
+void histogram_summarize(const histogram_t *hist, histogram_summary_t *summary);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // HISTOGRAM_H
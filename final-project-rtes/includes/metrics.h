@@ -0,0 +1,146 @@
+/**
+*
+* This header contains the live metrics page published in POSIX shared
+* memory for external monitors such as tools/synchronome-top
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "../includes/services.h"
+
+#define METRICS_MAGIC          (0x53594e4d45545231ULL)   // "SYNMETR1"
+#define METRICS_VERSION        (1)
+#define METRICS_DEFAULT_NAME   "/synchronome"
+#define METRICS_PERIOD_MS      (200)                     // publisher wakeup period
+#define METRICS_FPS_WINDOW     (5)                       // periods the frame rates are averaged over
+#define METRICS_MAX_SERVICES   (8)
+#define METRICS_NAME_LENGTH    (24)
+
+// State of the producing process
+#define METRICS_STATE_STARTING (0)
+#define METRICS_STATE_RUNNING  (1)
+#define METRICS_STATE_FINISHED (2)                       // last update, the page is unlinked
+
+// One service, times in ns
+typedef struct {
+  char name[METRICS_NAME_LENGTH];
+  uint32_t period_us;                          // 0 for a best effort service
+  int32_t level;                               // current degradation level
+  int32_t max_level;
+  uint32_t reserved;
+  uint64_t releases;
+  uint64_t jobs;
+  uint64_t misses;                             // deadline misses
+  uint64_t skipped;
+  uint64_t decimated;
+  int64_t latency_p99;                         // job start - scheduled release
+  int64_t latency_max;
+  int64_t exec_p50;                            // CPU time of a job
+  int64_t exec_p99;
+  int64_t exec_max;
+}metrics_service_t;
+
+// The page. Fixed size types only, the monitors may be built apart from
+// the pipeline; a layout change bumps METRICS_VERSION.
+//
+// seq is a seqlock: odd while the publisher writes, a reader copies the
+// page and retries until seq was even and unchanged around the copy.
+typedef struct {
+  uint64_t magic;                              // METRICS_MAGIC
+  uint32_t version;                            // METRICS_VERSION
+  uint32_t size;                               // sizeof(metrics_page_t)
+  uint32_t seq;
+  uint32_t state;                              // METRICS_STATE_*
+  int32_t pid;                                 // producing process
+  uint32_t period_ms;                          // update period
+  uint32_t virtual_time;                       // 1 for a simulation run
+  uint32_t nservices;
+  int64_t start_ns;                            // pipeline clock at open
+  int64_t update_ns;                           // pipeline clock at the latest update
+  int64_t update_mono_ns;                      // CLOCK_MONOTONIC at the latest update, for staleness
+  uint64_t updates;
+
+  // frames
+  uint64_t frames_captured;                    // written to the frame buffer
+  uint64_t frames_queued;                      // selected and pushed to writeback
+  uint64_t frames_committed;                   // written to storage
+  uint64_t frames_dropped;                     // selected but the writeback queue was full
+  double capture_fps;                          // over the last METRICS_FPS_WINDOW updates
+  double commit_fps;
+  double commit_fps_avg;                       // since start
+
+  // queues
+  int32_t cbuf_depth;                          // frames in the frame buffer
+  int32_t cbuf_capacity;
+  int32_t fifo_depth;                          // frames waiting for writeback
+  int32_t fifo_capacity;
+  int32_t fifo_high_water;
+  int32_t writeback_workers;
+
+  // writeback latency, queued to committed, ns
+  uint64_t writeback_count;
+  int64_t writeback_p50;
+  int64_t writeback_p99;
+  int64_t writeback_max;
+
+  metrics_service_t services[METRICS_MAX_SERVICES];
+}metrics_page_t;
+
+/**
+ * @brief Function to create the shared memory page and start the publisher
+ * thread under SCHED_OTHER. The services are not touched, the publisher
+ * reads the counters they keep anyway.
+ * @param name - shm_open() name, e.g. METRICS_DEFAULT_NAME
+ * @param table - service table to publish
+ * @return 0 on success, -1 on error
+ */
+int metrics_open(const char *name, service_table_t *table);
+
+/**
+ * @brief Function to stop the publisher, write a final update marked
+ * METRICS_STATE_FINISHED and unlink the page, no-op if it was not opened
+ * @return no return
+ */
+void metrics_close(void);
+
+/**
+ * @brief Function to take a consistent copy of a page, for the monitors
+ * @param page - mapped page
+ * @param copy - copy of the page
+ * @return 0 on success, -1 if the publisher kept writing
+ */
+static inline int metrics_read(const volatile metrics_page_t *page, metrics_page_t *copy) {
+  uint32_t before, after;
+  int tries;
+
+  for(tries = 0; tries < 1000; tries++) {
+    before = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+    if(before & 1)
+      continue;
+    __builtin_memcpy(copy, (const void *)page, sizeof(metrics_page_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&page->seq, __ATOMIC_RELAXED);
+    if(before == after)
+      return 0;
+  }
+  return -1;
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,117 @@
+/**
+*
+* This header contains the optional per-thread performance counters read
+* around every job of a service
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>   // for bool
+
+// Counters kept per thread. The hardware group counts the first five,
+// the software fallbacks what the kernel still offers.
+typedef enum {
+  PERFCOUNT_CYCLES,
+  PERFCOUNT_INSTRUCTIONS,
+  PERFCOUNT_CACHE_MISSES,
+  PERFCOUNT_LLC_LOADS,
+  PERFCOUNT_CONTEXT_SWITCHES,
+  PERFCOUNT_TASK_CLOCK,                        // ns on the CPU
+  PERFCOUNT_PAGE_FAULTS,
+  PERFCOUNT_EVENTS
+}perfcount_event_t;
+
+#define PERFCOUNT_NOT_COUNTED  (-1)
+#define PERFCOUNT_FROM_RUSAGE  (-2)             // slot of a counter read with getrusage()
+
+// Where the counters come from, best first
+typedef enum {
+  PERFCOUNT_OFF,                               // not enabled, or nothing could be opened
+  PERFCOUNT_HARDWARE,                          // perf_event_open() PMU group
+  PERFCOUNT_SOFTWARE,                          // perf_event_open() software events, no PMU access
+  PERFCOUNT_RUSAGE                             // getrusage(RUSAGE_THREAD), perf_event_open() refused
+}perfcount_mode_t;
+
+// Counters of one thread. Only the owner writes, the report reads the
+// totals without locking once the threads are joined or with relaxed loads.
+typedef struct {
+  perfcount_mode_t mode;
+  int leader;                                  // group leader fd, -1 without perf events
+  int fds[PERFCOUNT_EVENTS];                   // -1 if the event is not counted
+  int slot[PERFCOUNT_EVENTS];                  // position in the group read or PERFCOUNT_FROM_RUSAGE
+                                               // or PERFCOUNT_NOT_COUNTED
+  int nslots;
+  uint64_t start[PERFCOUNT_EVENTS];            // values at the job start
+  uint64_t start_enabled;
+  uint64_t start_running;
+  uint64_t total[PERFCOUNT_EVENTS];            // summed over the jobs
+  uint64_t jobs;
+  uint64_t multiplexed;                        // jobs scaled because the PMU was shared
+}perfcount_t;
+
+/**
+ * @brief Function to turn the counters on for the threads opened after it
+ * @return no return
+ */
+void perfcount_enable(void);
+
+/**
+ * @brief Function to tell whether the counters are on
+ * @return true if perfcount_enable() was called
+ */
+bool perfcount_enabled(void);
+
+/**
+ * @brief Function to open the counters of the calling thread, falling back
+ * from the PMU to software events and to getrusage() when the kernel
+ * refuses them. No-op unless perfcount_enable() was called.
+ * @param perf - counters of the thread
+ * @return counter source in use
+ */
+perfcount_mode_t perfcount_open(perfcount_t *perf);
+
+/**
+ * @brief Function to read the counters at a job start, one read() of the group
+ * @param perf - counters of the calling thread
+ * @return no return
+ */
+void perfcount_job_start(perfcount_t *perf);
+
+/**
+ * @brief Function to read the counters at a job end and add the job to the totals
+ * @param perf - counters of the calling thread
+ * @return no return
+ */
+void perfcount_job_end(perfcount_t *perf);
+
+/**
+ * @brief Function to close the counters of a thread
+ * @param perf - counters of the thread
+ * @return no return
+ */
+void perfcount_close(perfcount_t *perf);
+
+/**
+ * @brief Function to get the name of a counter source
+ * @param mode - counter source
+ * @return name, e.g. "hardware"
+ */
+const char *perfcount_mode_name(perfcount_mode_t mode);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // PERFCOUNT_H
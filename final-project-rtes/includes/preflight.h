@@ -0,0 +1,79 @@
+/**
+*
+* This header contains the scheduling latency preflight, a cyclictest
+* style measurement of the wakeup latency on every core the pipeline uses
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>   // for bool
+#include <stdint.h>
+
+#include "../includes/services.h"
+#include "../includes/histogram.h"
+
+#define PREFLIGHT_DEFAULT_MS     (5000)        // measurement time when only --preflight-abort is given
+#define PREFLIGHT_INTERVAL_US    (1000)        // wakeup period of the measurement threads
+#define PREFLIGHT_BUDGET_PCT     (10)          // worst wakeup latency allowed, share of the capture period
+#define PREFLIGHT_MAX_THREADS    (SERVICE_MAX * SERVICE_MAX_CPUS + 1)
+#define PREFLIGHT_MAX_CORES      (2 * SERVICE_MAX_CPUS)
+
+// Wakeup latency of one core, over every measurement thread pinned to it
+typedef struct {
+  int cpu;
+  int threads;                                 // measurement threads on the core
+  int max_priority;                            // highest priority measured on it
+  histogram_t hist;                            // clock_nanosleep() wakeup - requested time
+}preflight_core_t;
+
+typedef struct {
+  int ncores;
+  preflight_core_t cores[PREFLIGHT_MAX_CORES];
+  int64_t budget_ns;                           // PREFLIGHT_BUDGET_PCT of the capture period
+  int64_t worst_ns;                            // highest latency seen on any core
+  int worst_cpu;
+}preflight_result_t;
+
+/**
+ * @brief Function to measure the wakeup latency the services will see.
+ * One measurement thread is started for the sequencer and for every
+ * periodic service on each of its cores, with the policy and priority the
+ * service will run under, and sleeps to absolute PREFLIGHT_INTERVAL_US
+ * deadlines for the given time. Deadline services are measured under
+ * SCHED_FIFO just below the sequencer, which is where they preempt.
+ * Best effort services are left out, they have no release to be late for.
+ * @param table - service table, after services_assign_priorities()
+ * @param sequencer_core - core of the sequencer thread
+ * @param sequencer_priority - SCHED_FIFO priority of the sequencer
+ * @param duration_ms - measurement time
+ * @param result - filled with the per core histograms and the verdict
+ * @return 0 within the budget, 1 if a core exceeded it, -1 if the threads
+ *         could not be started, e.g. without real-time privileges
+ */
+int preflight_run(const service_table_t *table, int sequencer_core, int sequencer_priority,
+                  unsigned int duration_ms, preflight_result_t *result);
+
+/**
+ * @brief Function to print the per core latency percentiles and whether
+ * the worst case fits the budget
+ * @param result - result of preflight_run()
+ * @return no return
+ */
+void preflight_report(const preflight_result_t *result);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // PREFLIGHT_H
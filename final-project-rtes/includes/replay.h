@@ -0,0 +1,77 @@
+/**
+*
+* This header contains the replay frame source, which plays back a
+* directory of recorded PPM/PGM frames in place of the camera
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>   // for bool
+#include <time.h>
+
+#define REPLAY_MAX_FRAMES     (8192)
+#define REPLAY_PATH_LENGTH    (512)
+
+/**
+ * @brief Function to load the frame list of a recording: every .ppm/.pgm
+ * file of the directory in name order, with the timestamp of its
+ * "#<sec> sec <msec> msec" header comment
+ * @param dir - recording directory, e.g. frames@10Hz
+ * @return number of frames, -1 on error
+ */
+int replay_open(const char *dir);
+
+/**
+ * @brief Function to check whether frames come from a recording
+ * @return true after a successful replay_open()
+ */
+bool replay_active(void);
+
+/**
+ * @brief Function to get the timestamp of the first recorded frame, the
+ * start of the replay timeline
+ * @param epoch - timestamp of the first frame
+ * @return no return
+ */
+void replay_epoch(struct timespec *epoch);
+
+/**
+ * @brief Function to get the recorded frame shown at a point of the replay
+ * timeline: the last frame recorded at or before it, the last frame of the
+ * recording once it has ended
+ * @param offset_ns - time since the first frame
+ * @return HRES x VRES packed RGB frame, NULL on a read error. The buffer
+ * stays valid until the next call.
+ */
+const unsigned char *replay_frame_at(long long offset_ns);
+
+/**
+ * @brief Function to check whether a point of the replay timeline lies
+ * past the last recorded frame, where replay_frame_at() would only repeat it
+ * @param offset_ns - time since the first frame
+ * @return true once the recording has ended
+ */
+bool replay_ended(long long offset_ns);
+
+/**
+ * @brief Function to release the replay buffers
+ * @return no return
+ */
+void replay_close(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // REPLAY_H
@@ -0,0 +1,71 @@
+/**
+*
+* This header contains the helper functions for building the static
+* cyclic-executive release table of the sequencer
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>    // for uint8_t etc.
+#include <stdbool.h>   // for bool
+#include <semaphore.h>
+
+#define SCHEDULE_MAX_SERVICES   (16)
+#define SCHEDULE_MAX_ENTRIES    (1024)         // release points in one hyperperiod
+
+// A periodic service as seen by the sequencer
+typedef struct {
+  const char *name;
+  unsigned int period_us;                      // release period
+  sem_t *release;                              // semaphore posted on every release
+}schedule_service_t;
+
+// One release point of the table
+typedef struct {
+  unsigned long long offset_us;                // release time within the hyperperiod
+  unsigned int release_mask;                   // bit i releases service i
+}schedule_entry_t;
+
+typedef struct {
+  int nservices;
+  schedule_service_t services[SCHEDULE_MAX_SERVICES];
+  unsigned int minor_frame_us;                 // greatest common divisor of the periods
+  unsigned long long hyperperiod_us;           // least common multiple of the periods
+  int nentries;                                // ticks that release at least one service
+  schedule_entry_t entries[SCHEDULE_MAX_ENTRIES];
+}schedule_t;
+
+/**
+ * @brief Function to build the release table from a list of service periods.
+ * Service i is released at every multiple of its period, the first time one
+ * period after the sequencer starts.
+ * @param sched - table to fill
+ * @param services - periodic services
+ * @param nservices - number of services
+ * @return 0 on success, -1 if a period is 0 or the table does not fit
+ */
+int schedule_build(schedule_t *sched, const schedule_service_t *services, int nservices);
+
+/**
+ * @brief Function to print the minor frame, hyperperiod and release table
+ * @param sched - table to print
+ * @return no return
+ */
+void schedule_print(const schedule_t *sched);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // SCHEDULE_H
@@ -10,18 +10,31 @@
 #include <sys/sysinfo.h>
 #include <errno.h>
 #include <signal.h>
+#include <string.h>
+#include <limits.h>
 
 #include "../includes/circular_buff.h"
+#include "../includes/services.h"
 
 #define TRUE                    (1)
 #define FALSE                   (0)
 
+#define SEQUENCER_CLOCK         CLOCK_MONOTONIC       // clock_nanosleep() does not take MONOTONIC_RAW
+#define SEQUENCER_ANALYSIS_US   (1000000)             // period of the RM analysis from the measured WCETs
+#define SEQUENCER_CORE          (0)                   // default core for the sequencer thread
+#define FREE_RUN_MAX_LEAD       (QUEUE_DEPTH / 2)     // captures a free run may be ahead of the last service
+
+// Sequencer tick statistics
 typedef struct {
-    int threadIdx;
-    cbuff_struct_t *global_cbuf;
-} threadParams_t;
+    unsigned long long ticks;                 // release points executed (wakeups)
+    unsigned long long overruns;              // release points skipped because the wakeup was too late
+    long long min_lateness_ns;                // wakeup lateness after the absolute release time
+    long long max_lateness_ns;
+    long long sum_lateness_ns;
+} sequencer_stats_t;
 
-void Sequencer(int id);
+void *Sequencer(void *threadp);
+void get_sequencer_stats(sequencer_stats_t *stats);
 void *Service_1(void *threadp);
 void *Service_2(void *threadp);
 void *Service_3(void *threadp);
@@ -0,0 +1,378 @@
+/**
+*
+* This header contains the service descriptor table and the generic
+* launcher that creates the service threads from it
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef SERVICES_H
+#define SERVICES_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>    // for uint32_t
+#include <stdbool.h>   // for bool
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "../includes/circular_buff.h"
+#include "../includes/histogram.h"
+#include "../includes/perfcount.h"
+
+#define SERVICE_MAX              (8)           // descriptors in the table
+#define SERVICE_DEFAULTS         (4)           // services of services_add_defaults()
+#define SERVICE_MAX_INSTANCES    (8)           // threads started from one descriptor
+#define SERVICE_MAX_CPUS         (16)          // cores listed for one descriptor
+#define SERVICE_NAME_LENGTH      (24)
+#define SERVICE_PRIO_AUTO        (-1)          // derive the priority by rate monotonic order
+#define SERVICE_DL_MARGIN_PCT    (20)          // runtime reserved above the WCET under SCHED_DEADLINE
+#define SERVICE_EXEC_SAMPLES     (1024)        // execution times kept per thread, power of two
+#define SERVICE_MAX_DEGRADE      (3)           // deepest overload degradation level
+#define SERVICE_RECOVER_JOBS     (20)          // on-time jobs before the level is lowered again
+
+// Scheduling policies a service can run under
+typedef enum {
+  SERVICE_POLICY_FIFO,
+  SERVICE_POLICY_RR,
+  SERVICE_POLICY_OTHER,
+  SERVICE_POLICY_DEADLINE
+}service_policy_t;
+
+// What a periodic service does when a job is still running at its next release
+typedef enum {
+  SERVICE_OVERLOAD_NONE,                       // only count the miss
+  SERVICE_OVERLOAD_SKIP,                       // drop the releases that piled up
+  SERVICE_OVERLOAD_SHED,                       // switch to a cheaper kernel, see service_degrade_level()
+  SERVICE_OVERLOAD_DECIMATE                    // run every 2^level-th release only
+}service_overload_t;
+
+// Deadline misses and degradation events of a periodic service
+typedef struct {
+  unsigned long long releases;                 // releases seen by the service
+  unsigned long long misses;                   // jobs that ended after the next release
+  unsigned long long skipped;                  // releases dropped by the skip policy
+  unsigned long long decimated;                // releases not run by the decimate policy
+  unsigned long long degrades;                 // level raised
+  unsigned long long recoveries;               // level lowered
+  int level;                                   // current degradation level, 0 is full quality
+  int max_level;
+  int on_time;                                 // consecutive jobs that met the deadline
+}service_overload_stats_t;
+
+// Thread function of a service
+typedef void *(*service_entry_t)(void *);
+
+// Start time jitter of a periodic service, the deviation of the interval
+// between two job starts from the release period
+typedef struct {
+  unsigned long long releases;
+  long long last_start_ns;
+  long long min_dev_ns;
+  long long max_dev_ns;
+  double sum_dev_ns;
+  double sum_sq_dev_ns;
+}service_jitter_t;
+
+// One service of the pipeline
+typedef struct {
+  char name[SERVICE_NAME_LENGTH];
+  service_entry_t entry;                       // thread function
+  unsigned int period_us;                      // release period, 0 for a best effort service
+  int priority;                                // SCHED_FIFO/RR priority or SERVICE_PRIO_AUTO
+  int effective_priority;                      // priority the threads are created with
+  service_policy_t policy;
+  int cpus[SERVICE_MAX_CPUS];                  // cores the service may run on
+  int ncpus;
+  int instances;                               // threads started, instance i on cpus[i % ncpus]
+  unsigned int wcet_us;                        // worst case execution time of one job
+  unsigned int runtime_us;                     // SCHED_DEADLINE runtime, 0 derives it from the WCET
+  unsigned int deadline_us;                    // SCHED_DEADLINE relative deadline, 0 for the period
+  unsigned int dl_period_us;                   // SCHED_DEADLINE period, 0 for the release period
+  int admission;                               // 0 or the errno of the SCHED_DEADLINE admission
+  bool affinity_dropped;                       // cpus ignored to pass the admission
+  service_overload_t overload;                 // reaction to a deadline miss
+  sem_t release;                               // posted by the sequencer on every release
+  service_jitter_t jitter;
+  service_overload_stats_t overload_stats;
+  int trace_ring;                              // trace ring of instance 0, -1 if not traced
+  int64_t release_ns;                          // scheduled time of the latest release, set by the sequencer
+  unsigned long long completed;                // releases run, decimated or skipped, read by a free run
+  histogram_t hist_latency;                    // job start - scheduled release
+  histogram_t hist_exec;                       // CPU time of a job, every instance
+  histogram_t hist_interval;                   // job start - previous job start
+}service_desc_t;
+
+typedef struct {
+  int count;
+  service_desc_t services[SERVICE_MAX];
+}service_table_t;
+
+// Execution times of the jobs of one thread. Only the owning thread
+// writes it, readers take a snapshot without locking, so a sample being
+// overwritten during the copy is the worst that can happen.
+typedef struct {
+  unsigned long long jobs;                     // completed jobs, published last
+  long long start_ns;                          // thread CPU time at the job start
+  long long min_ns;
+  long long max_ns;
+  long long sum_ns;
+  uint32_t samples[SERVICE_EXEC_SAMPLES];      // ring of the latest execution times in ns
+}service_exec_t;
+
+// Execution time summary of a service, over all its threads
+typedef struct {
+  unsigned long long jobs;
+  long long min_ns;
+  long long avg_ns;
+  long long max_ns;
+  long long p99_ns;                            // over the samples still in the rings
+}service_exec_summary_t;
+
+// Parameters passed to every service thread
+typedef struct {
+  int threadIdx;
+  int instance;                                // instance of the descriptor
+  service_desc_t *svc;                         // descriptor the thread was started from
+  cbuff_struct_t *global_cbuf;
+  service_exec_t exec;                         // execution times of this thread
+  perfcount_t perf;                            // performance counters of this thread, see perfcount_enable()
+}threadParams_t;
+
+/**
+ * @brief Function to add a descriptor to the table
+ * @param table - service table
+ * @param name - service name used by the config file and -s option
+ * @param entry - thread function
+ * @param period_us - release period, 0 for best effort
+ * @param policy - scheduling policy
+ * @param cpu - default core
+ * @return descriptor, NULL if the table is full
+ */
+service_desc_t *services_add(service_table_t *table, const char *name, void *(*entry)(void *),
+                             unsigned int period_us, service_policy_t policy, int cpu);
+
+/**
+ * @brief Function to add the default services of the synchronome: capture,
+ * differencing, selection and the writeback pool, with their periods,
+ * cores, overload policies and WCETs. Priorities are derived later in rate
+ * monotonic order, the WCETs only size the SCHED_DEADLINE reservations
+ * until they are measured on the target board.
+ * @param table - service table
+ * @param entries - SERVICE_DEFAULTS thread functions in that order, NULL
+ *                  for a table that is only analysed, e.g. by tools/rmsim
+ * @return no return
+ */
+void services_add_defaults(service_table_t *table, const service_entry_t *entries);
+
+/**
+ * @brief Function to look a descriptor up by name
+ * @param table - service table
+ * @param name - service name
+ * @return descriptor, NULL if there is no such service
+ */
+service_desc_t *services_find(service_table_t *table, const char *name);
+
+/**
+ * @brief Function to set one field of a descriptor. Keys are period (ms),
+ * priority (number or auto), cpus (comma separated list), policy
+ * (fifo, rr, other, deadline), instances, overload (none, skip, shed,
+ * decimate) and the SCHED_DEADLINE parameters wcet, runtime, deadline
+ * and dlperiod (us).
+ * @param svc - descriptor
+ * @param key - field name
+ * @param value - field value
+ * @return 0 on success, -1 on an unknown key or a bad value
+ */
+int services_set(service_desc_t *svc, const char *key, const char *value);
+
+/**
+ * @brief Function to apply one service line: a service name followed by
+ * whitespace separated key=value fields, e.g. "writeback instances=2 cpus=2,3".
+ * Used for config file lines and for the -s command line option.
+ * @param table - service table
+ * @param line - service line
+ * @return 0 on success, -1 on error
+ */
+int services_parse_line(service_table_t *table, const char *line);
+
+/**
+ * @brief Function to load a config file made of service lines,
+ * '#' starts a comment.
+ * @param table - service table
+ * @param path - config file
+ * @return 0 on success, -1 on error
+ */
+int services_load_config(service_table_t *table, const char *path);
+
+/**
+ * @brief Function to parse a comma separated core list such as "2,3"
+ * @param arg - core list
+ * @param cores - parsed cores
+ * @param max_cores - capacity of cores
+ * @return number of cores, -1 on error
+ */
+int services_parse_cpus(const char *arg, int *cores, int max_cores);
+
+/**
+ * @brief Function to resolve SERVICE_PRIO_AUTO by rate monotonic order:
+ * the shorter the period the higher the priority, starting one below
+ * max_prio which is left to the sequencer
+ * @param table - service table
+ * @param max_prio - highest priority available
+ * @return no return
+ */
+void services_assign_priorities(service_table_t *table, int max_prio);
+
+/**
+ * @brief Function to get the config name of a policy
+ * @param policy - scheduling policy
+ * @return name, e.g. "fifo"
+ */
+const char *services_policy_name(service_policy_t policy);
+
+/**
+ * @brief Function to switch every service of the table to one policy,
+ * used by the -M option to compare the FIFO and DEADLINE modes
+ * @param table - service table
+ * @param policy - policy for every service
+ * @return no return
+ */
+void services_set_mode(service_table_t *table, service_policy_t policy);
+
+/**
+ * @brief Function to fill in the SCHED_DEADLINE parameters left at 0:
+ * runtime is the WCET plus SERVICE_DL_MARGIN_PCT, deadline and period
+ * default to the release period
+ * @param table - service table
+ * @return 0 on success, -1 if a deadline service has no usable parameters
+ */
+int services_derive_deadline(service_table_t *table);
+
+/**
+ * @brief Function to print the table
+ * @param table - service table
+ * @return no return
+ */
+void services_print(const service_table_t *table);
+
+/**
+ * @brief Function to create every service thread described by the table
+ * @param table - service table
+ * @param frame_buffer - global circular buffer handed to the services
+ * @return number of threads created, -1 on error
+ */
+int services_launch(service_table_t *table, cbuff_struct_t *frame_buffer);
+
+/**
+ * @brief Function to print the SCHED_DEADLINE admission result of every
+ * deadline service and the bandwidth it reserves against the kernel limit
+ * @param table - service table, after services_launch()
+ * @return number of services the kernel refused
+ */
+int services_print_admission(const service_table_t *table);
+
+/**
+ * @brief Function to wait for every thread started by services_launch()
+ * @return no return
+ */
+void services_join(void);
+
+/**
+ * @brief Function to record the start of a job, called by a service
+ * right after its release
+ * @param params - parameters of the calling thread
+ * @return true to run the job, false if the decimate policy skips this release
+ */
+bool service_job_start(threadParams_t *params);
+
+/**
+ * @brief Function to record the end of a job. The execution time is the
+ * thread CPU time since service_job_start(), so time spent preempted or
+ * blocked is not counted. A periodic job that ends with its next release
+ * already pending has missed its deadline and the overload policy of the
+ * service is applied.
+ * @param params - parameters of the calling thread
+ * @return no return
+ */
+void service_job_end(threadParams_t *params);
+
+/**
+ * @brief Function to get the degradation level of the calling service,
+ * a service with the shed policy picks a cheaper kernel from it
+ * @param params - parameters of the calling thread
+ * @return 0 at full quality, up to SERVICE_MAX_DEGRADE
+ */
+int service_degrade_level(const threadParams_t *params);
+
+/**
+ * @brief Function to print the deadline misses and degradation events of
+ * every periodic service
+ * @param table - service table
+ * @return total number of deadline misses
+ */
+unsigned long long services_report_overload(const service_table_t *table);
+
+/**
+ * @brief Function to summarize the execution times of a service
+ * @param svc - descriptor
+ * @param summary - filled with the summary, jobs is 0 before the first job
+ * @return no return
+ */
+void services_exec_summary(const service_desc_t *svc, service_exec_summary_t *summary);
+
+/**
+ * @brief Function to print the execution time summary of every service
+ * @param table - service table
+ * @return no return
+ */
+void services_report_exec(const service_table_t *table);
+
+/**
+ * @brief Function to print the release latency, execution time and release
+ * interval percentiles of every service, safe while the services run
+ * @param table - service table
+ * @return no return
+ */
+void services_report_histograms(const service_table_t *table);
+
+/**
+ * @brief Function to print the performance counters of every service per
+ * job, summed over its threads: IPC and cache misses per 1000 instructions
+ * tell a memory bound kernel from a compute bound one. No-op unless the
+ * counters were enabled.
+ * @param table - service table
+ * @return no return
+ */
+void services_report_perf(const service_table_t *table);
+
+/**
+ * @brief Function to print the start jitter of every periodic service and
+ * append it to a CSV log, one row per service tagged with the mode
+ * @param table - service table
+ * @param mode - mode label of this run, e.g. "fifo"
+ * @param path - CSV log, NULL to print only
+ * @return no return
+ */
+void services_report_jitter(const service_table_t *table, const char *mode, const char *path);
+
+/**
+ * @brief Function to print the latest FIFO and DEADLINE rows of the CSV
+ * log side by side for every service
+ * @param path - CSV log written by services_report_jitter()
+ * @return 0 on success, -1 if the log cannot be read
+ */
+int services_compare_jitter(const char *path);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // SERVICES_H
@@ -0,0 +1,142 @@
+/**
+*
+* This header contains the time source used by the sequencer and the
+* services, either the real clocks or a virtual clock for simulation runs
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>   // for bool
+#include <time.h>
+
+typedef enum {
+  TIMESOURCE_REAL,                             // MY_CLOCK and SEQUENCER_CLOCK
+  TIMESOURCE_VIRTUAL,                          // advanced by the sequencer once the services are idle
+  TIMESOURCE_FREE_RUN                          // real clocks, the sequencer releases on progress instead of time
+}timesource_mode_t;
+
+#define TIMESOURCE_PROGRESS_POLL_MS   (10)     // longest wait for progress in a free run
+
+/**
+ * @brief Function to select the time source, called before any thread starts
+ * @param mode - real, virtual or free running time
+ * @param start - virtual time at startup, ignored for real time
+ * @param frame_wallclock - derive the wall clock of the frame headers from
+ * the frame timestamp instead of CLOCK_REALTIME, so replayed output does
+ * not depend on when it was produced
+ * @return no return
+ */
+void timesource_init(timesource_mode_t mode, const struct timespec *start, bool frame_wallclock);
+
+/**
+ * @brief Function to check for the virtual clock
+ * @return true in a simulation run
+ */
+bool timesource_is_virtual(void);
+
+/**
+ * @brief Function to check for a free run, released as fast as the services go
+ * @return true in a free run
+ */
+bool timesource_is_free_run(void);
+
+/**
+ * @brief Function to read the time used for timestamps and logs, MY_CLOCK
+ * in real time
+ * @param ts - current time
+ * @return no return
+ */
+void timesource_gettime(struct timespec *ts);
+
+/**
+ * @brief Function to read the time the sequencer schedules on,
+ * SEQUENCER_CLOCK in real time
+ * @param ts - current time
+ * @return no return
+ */
+void timesource_sequencer_time(struct timespec *ts);
+
+/**
+ * @brief Function to sleep until an absolute sequencer time. The virtual
+ * clock waits for every released job and the idle check to finish, then
+ * jumps to the wakeup time.
+ * @param wakeup - absolute time
+ * @return 0 on success, else an errno value
+ */
+int timesource_sleep_until(const struct timespec *wakeup);
+
+/**
+ * @brief Function to get the wall clock printed in a frame header
+ * @param frame_time - timestamp of the frame
+ * @param wall - wall clock
+ * @return no return
+ */
+void timesource_wallclock(const struct timespec *frame_time, struct timespec *wall);
+
+/**
+ * @brief Function to count a job released by the sequencer, no-op unless virtual
+ * @return no return
+ */
+void timesource_job_released(void);
+
+/**
+ * @brief Function to count a finished or skipped job, no-op in real time
+ * @return no return
+ */
+void timesource_job_done(void);
+
+/**
+ * @brief Function to wake a sequencer waiting in timesource_wait_idle(),
+ * called when the state seen by the idle check changes
+ * @return no return
+ */
+void timesource_notify(void);
+
+/**
+ * @brief Function to register the check for work outside the released
+ * jobs, e.g. frames still queued for writeback. It runs with the time lock
+ * held, so it must not block or take a lock: read counters atomically and
+ * call timesource_notify() when the work is done.
+ * @param pending - returns the amount of pending work, 0 when idle
+ * @return no return
+ */
+void timesource_set_idle_check(int (*pending)(void));
+
+/**
+ * @brief Function to wait until every released job is done and the idle
+ * check reports no pending work, returns at once unless virtual
+ * @return no return
+ */
+void timesource_wait_idle(void);
+
+/**
+ * @brief Function to read the progress count of a free run, bumped by
+ * every finished job and every timesource_notify()
+ * @return progress count
+ */
+unsigned long long timesource_progress(void);
+
+/**
+ * @brief Function to wait until the progress count moves past a value
+ * read before, or TIMESOURCE_PROGRESS_POLL_MS at most
+ * @param seen - progress count read with timesource_progress()
+ * @return no return
+ */
+void timesource_wait_progress(unsigned long long seen);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // TIMESOURCE_H
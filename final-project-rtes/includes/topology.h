@@ -0,0 +1,85 @@
+/**
+*
+* This header contains the helper functions for reading the CPU topology
+* from sysfs and deriving a core placement plan for the services
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>   // for bool
+
+#define TOPOLOGY_MAX_CPUS      (256)
+#define TOPOLOGY_SYSFS_ROOT    "/sys/devices/system/cpu"
+
+// One logical CPU
+typedef struct {
+  bool online;
+  bool isolated;                               // in the isolcpus mask
+  bool nohz_full;                              // in the nohz_full mask
+  int package;                                 // physical package id
+  int core;                                    // lowest CPU among the SMT siblings
+  int llc;                                     // lowest CPU sharing the last level cache, -1 if unknown
+  int llc_level;                               // level of that cache, 0 if unknown
+}topology_cpu_t;
+
+typedef struct {
+  int ncpus;                                   // highest possible CPU + 1
+  int nonline;
+  int ncores;                                  // physical cores with an online CPU
+  topology_cpu_t cpus[TOPOLOGY_MAX_CPUS];
+}topology_t;
+
+// Cores picked for the pipeline
+typedef struct {
+  int sequencer;
+  int capture;
+  int differencing;
+  int selection;                               // shares the differencing core and its cache
+  int writer[TOPOLOGY_MAX_CPUS];               // cores of the writeback pool
+  int nwriter;
+}topology_plan_t;
+
+/**
+ * @brief Function to read the online CPUs, SMT siblings, cache sharing and
+ * the isolcpus/nohz_full masks
+ * @param topo - topology to fill
+ * @param root - sysfs CPU directory, TOPOLOGY_SYSFS_ROOT
+ * @return 0 on success, -1 if the online mask cannot be read
+ */
+int topology_read(topology_t *topo, const char *root);
+
+/**
+ * @brief Function to derive the placement: the sequencer on a housekeeping
+ * core, capture and differencing/selection on separate physical cores,
+ * preferring isolated ones that share one last level cache, and the
+ * writeback pool on the cores left over
+ * @param topo - topology
+ * @param plan - placement to fill
+ * @return no return
+ */
+void topology_plan(const topology_t *topo, topology_plan_t *plan);
+
+/**
+ * @brief Function to print the topology and the placement plan
+ * @param topo - topology
+ * @param plan - placement
+ * @return no return
+ */
+void topology_print(const topology_t *topo, const topology_plan_t *plan);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // TOPOLOGY_H
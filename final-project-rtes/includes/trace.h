@@ -0,0 +1,147 @@
+/**
+*
+* This header contains the in-memory event tracer used on the hot paths
+* of the services instead of syslog, and the layout of the trace file
+* read back by tools/tracedump
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>   // for bool
+#include <pthread.h>
+
+#define TRACE_MAGIC            "SYNTRACE"
+#define TRACE_VERSION          (2)
+#define TRACE_MAX_RINGS        (32)             // threads that may record events
+#define TRACE_RING_EVENTS      (4096)           // per thread, must be a power of 2
+#define TRACE_NAME_LENGTH      (24)
+#define TRACE_DRAIN_MS         (50)             // drainer wakeup period
+
+// How an event is drawn on a timeline
+#define TRACE_INSTANT          (0)
+#define TRACE_BEGIN            (1)              // opens a slice on the thread
+#define TRACE_END              (2)              // closes it
+#define TRACE_SPAN             (3)              // slice ending at the event, arg1 is its length in ns
+
+// Events: id, name, kind and the meaning of the three arguments (NULL if unused)
+#define TRACE_EVENTS(X) \
+  X(TRACE_SEQ_RELEASE,   "seq_release",     TRACE_INSTANT, "entry",   "lateness_ns", "mask")     \
+  X(TRACE_SEM_POST,      "release",         TRACE_INSTANT, "ring",    "service",     NULL)       \
+  X(TRACE_JOB_START,     "job",             TRACE_BEGIN,   "release", NULL,          NULL)       \
+  X(TRACE_JOB_END,       "job_end",         TRACE_END,     "job",     "exec_ns",     "cpu")      \
+  X(TRACE_JOB_MISS,      "deadline_miss",   TRACE_INSTANT, "pending", "level",       NULL)       \
+  X(TRACE_JOB_SKIP,      "release_skipped", TRACE_INSTANT, "count",   NULL,          NULL)       \
+  X(TRACE_JOB_DECIMATE,  "release_decimated", TRACE_INSTANT, "release", "level",     NULL)       \
+  X(TRACE_SELECT_RETURN, "v4l2_select",     TRACE_SPAN,    "ready",   "wait_ns",     NULL)       \
+  X(TRACE_V4L2_DQBUF,    "v4l2_dqbuf",      TRACE_SPAN,    "buffer",  "ioctl_ns",    NULL)       \
+  X(TRACE_FRAME_READ,    "frame_read",      TRACE_INSTANT, "buffer",  "bytes",       "frame_ns") \
+  X(TRACE_REPLAY_READ,   "replay_read",     TRACE_INSTANT, "garbage", "bytes",       "frame_ns") \
+  X(TRACE_LOCK_WAIT,     "mutex_wait",      TRACE_SPAN,    "lock",    "wait_ns",     NULL)       \
+  X(TRACE_DIFF_USEFUL,   "diff_useful",     TRACE_INSTANT, "slot",    "diff",        NULL)       \
+  X(TRACE_DIFF_DONE,     "diff_done",       TRACE_INSTANT, "frames",  "stride",      NULL)       \
+  X(TRACE_FRAME_SELECTED, "frame_selected", TRACE_INSTANT, "frame",   "pushed",      "diff")     \
+  X(TRACE_SELECT_DONE,   "select_done",     TRACE_INSTANT, "result",  "divider",     NULL)       \
+  X(TRACE_FRAME_WRITTEN, "frame_write",     TRACE_SPAN,    "frame",   "io_ns",       "bytes")    \
+  X(TRACE_FRAME_COMMIT,  "frame_commit",    TRACE_INSTANT, "frame",   "result",      NULL)
+
+#define TRACE_EVENT_ID(id, name, kind, a0, a1, a2)   id,
+typedef enum {
+  TRACE_EVENTS(TRACE_EVENT_ID)
+  TRACE_EVENT_COUNT
+}trace_event_t;
+#undef TRACE_EVENT_ID
+
+// Locks whose contention is recorded as TRACE_LOCK_WAIT
+typedef enum {
+  TRACE_LOCK_CBUF,                             // frame buffer, circular_buff_lock()
+  TRACE_LOCK_FIFO,                             // writeback queue
+  TRACE_LOCK_REORDER                           // writeback reorder buffer
+}trace_lock_t;
+
+// One event, 32 bytes. The ring it came from identifies the thread.
+typedef struct {
+  int64_t ns;                                  // MY_CLOCK, or the virtual clock in a simulation
+  uint16_t id;                                 // trace_event_t
+  uint16_t ring;
+  int32_t arg0;
+  int64_t arg1;
+  int64_t arg2;
+}trace_record_t;
+
+// File header, rewritten with the ring names and drop counts on close.
+// The records of all rings follow in the order they were drained.
+typedef struct {
+  char magic[8];                               // TRACE_MAGIC, not terminated
+  uint32_t version;
+  uint32_t nrings;
+  uint32_t virtual_time;                       // 1 for a simulation run
+  uint32_t reserved;
+  char names[TRACE_MAX_RINGS][TRACE_NAME_LENGTH];
+  uint64_t dropped[TRACE_MAX_RINGS];           // events lost to a full ring
+}trace_file_header_t;
+
+/**
+ * @brief Function to open the trace file and start the drainer thread
+ * under SCHED_OTHER. Events are only recorded after this.
+ * @param path - trace file
+ * @return 0 on success, -1 on error
+ */
+int trace_open(const char *path);
+
+/**
+ * @brief Function to stop the drainer, write the remaining events and
+ * the final header, no-op if tracing is off
+ * @return no return
+ */
+void trace_close(void);
+
+/**
+ * @brief Function to give the calling thread a ring of its own, called
+ * once at thread start. Threads without a ring record nothing.
+ * @param name - service name
+ * @param instance - instance of the service, appended as "name/N" if > 0
+ * @return ring of the thread, -1 if tracing is off or no ring is left
+ */
+int trace_register(const char *name, int instance);
+
+/**
+ * @brief Function to record an event in the ring of the calling thread.
+ * Lock-free and without system calls, a full ring drops the event.
+ * @param id - event
+ * @param arg0, arg1, arg2 - event arguments
+ * @return no return
+ */
+void trace_event(trace_event_t id, int32_t arg0, int64_t arg1, int64_t arg2);
+
+/**
+ * @brief Function to get the time events are stamped with, in ns
+ * @return current time
+ */
+int64_t trace_now(void);
+
+/**
+ * @brief Function to lock a mutex and record the wait if it was contended,
+ * an uncontended lock costs one trylock
+ * @param mutex - mutex to lock
+ * @param lock - lock recorded in the event
+ * @return pthread_mutex_lock() result
+ */
+int trace_mutex_lock(pthread_mutex_t *mutex, trace_lock_t lock);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif // TRACE_H
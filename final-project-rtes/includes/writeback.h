@@ -22,12 +22,37 @@ extern "C" {
 #include <stdbool.h>   // for bool
 
 #include "../includes/circular_buff.h"
-
-#define MAX_FIFO_DEPTH     (10)
+#include "../includes/histogram.h"
+
+#define MAX_FIFO_DEPTH          (10)
+#define WRITEBACK_MAX_WORKERS   (8)        // upper bound for the writeback pool
+#define WRITEBACK_REORDER_DEPTH (16)       // frames in flight ahead of the oldest uncommitted one
+
+// Counters of the writeback path, read without locking by the monitors
+typedef struct {
+    unsigned long long queued;             // frames pushed by selection
+    unsigned long long committed;          // frames written and committed in order
+    unsigned long long dropped;            // frames selection could not push, queue full
+    int fifo_depth;                        // frames waiting in the queue
+    int fifo_high_water;                   // largest fifo_depth seen
+    const histogram_t *latency;            // queued to committed, ns
+} writeback_stats_t;
 
 int push_frame_fifo(cbuff_struct_t *element);
+cbuff_struct_t *pop_frame_fifo(void);
 int writeback(void);
 void init_fifoQ(void);
+void init_writeback_pool(int nworkers);
+int get_writeback_workers(void);
+void stop_writeback_pool(void);
+int init_y4m_sink(const char *path);
+void close_y4m_sink(void);
+void init_frame_headers(void);
+int writeback_pending(void);                   // frames pushed and not committed yet
+void writeback_get_stats(writeback_stats_t *stats);
+int init_latency_log(const char *path);          // per-frame stage breakdown as CSV, -1 on error
+void close_latency_log(void);
+void writeback_report_latency(void);             // stage latency histograms of the committed frames
 
 
 #ifdef	__cplusplus
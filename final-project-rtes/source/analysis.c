@@ -0,0 +1,140 @@
+/**
+*
+* This file contains the rate monotonic schedulability analysis of the
+* services. The execution times are the maxima measured by the services
+* themselves, the configured WCET stands in until a service has run once.
+* Every core is checked against the Liu-Layland utilization bound, which
+* is sufficient only, and with the exact response time analysis
+*
+*     R = C(i) + sum over higher priority j of ceil(R / T(j)) * C(j)
+*
+* iterated to a fixed point. The margin is the fraction of the deadline
+* left after the worst case response.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../includes/analysis.h"
+
+// for logging
+#include <syslog.h>
+
+// highest priority first, shorter period first on a tie
+static int compare_priority(const void *a, const void *b) {
+    const analysis_result_t *x = (const analysis_result_t *)a;
+    const analysis_result_t *y = (const analysis_result_t *)b;
+
+    if(x->core != y->core)
+        return x->core - y->core;
+    if(x->svc->effective_priority != y->svc->effective_priority)
+        return y->svc->effective_priority - x->svc->effective_priority;
+    return (x->period_ns > y->period_ns) - (x->period_ns < y->period_ns);
+}
+
+static long long response_time(const analysis_result_t *results, int first, int i) {
+    long long response = results[i].wcet_ns, next;
+    int j, iter;
+
+    for(iter = 0; iter < ANALYSIS_MAX_ITERATIONS; iter++) {
+        next = results[i].wcet_ns;
+        for(j = first; j < i; j++)
+            next += ((response + results[j].period_ns - 1) / results[j].period_ns) * results[j].wcet_ns;
+        if(next > results[i].period_ns)
+            return -1;
+        if(next == response)
+            return response;
+        response = next;
+    }
+    return -1;
+}
+
+int analysis_run(const service_table_t *table, analysis_result_t *results, int *nresults,
+                 analysis_core_t *cores, int *ncores) {
+    int i, first, n = 0, misses = 0;
+    service_exec_summary_t summary;
+    const service_desc_t *svc;
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->period_us == 0 ||
+           (svc->policy != SERVICE_POLICY_FIFO && svc->policy != SERVICE_POLICY_RR))
+            continue;
+        services_exec_summary(svc, &summary);
+        results[n].svc = svc;
+        results[n].core = svc->cpus[0];
+        results[n].measured = (summary.jobs != 0);
+        results[n].wcet_ns = results[n].measured ? summary.max_ns : svc->wcet_us * 1000LL;
+        results[n].period_ns = svc->period_us * 1000LL;
+        n++;
+    }
+    qsort(results, n, sizeof(analysis_result_t), compare_priority);
+
+    *ncores = 0;
+    for(first = 0; first < n; first = i) {
+        cores[*ncores].core = results[first].core;
+        cores[*ncores].utilization = 0.0;
+        for(i = first; i < n && results[i].core == results[first].core; i++) {
+            cores[*ncores].utilization += (double)results[i].wcet_ns / results[i].period_ns;
+            results[i].response_ns = response_time(results, first, i);
+            if(results[i].response_ns < 0) {
+                results[i].margin = 0.0;
+                misses++;
+            } else {
+                results[i].margin = 1.0 - (double)results[i].response_ns / results[i].period_ns;
+            }
+        }
+        cores[*ncores].nservices = i - first;
+        cores[*ncores].ll_bound = (i - first) * (pow(2.0, 1.0 / (i - first)) - 1.0);
+        (*ncores)++;
+    }
+    *nresults = n;
+    return misses;
+}
+
+int analysis_report(const service_table_t *table, bool verbose) {
+    analysis_result_t results[SERVICE_MAX];
+    analysis_core_t cores[SERVICE_MAX];
+    int nresults, ncores, misses, c, i;
+    bool estimated = false;
+    const analysis_core_t *core;
+    const analysis_result_t *result;
+
+    misses = analysis_run(table, results, &nresults, cores, &ncores);
+
+    for(c = 0, i = 0; c < ncores; c++) {
+        core = &cores[c];
+        if(verbose)
+            printf("RM analysis core %d: U=%.3f, Liu-Layland bound(%d)=%.3f %s\n", core->core,
+                   core->utilization, core->nservices, core->ll_bound,
+                   (core->utilization <= core->ll_bound) ? "met" : "exceeded, exact test decides");
+        syslog(LOG_INFO, "RM analysis core %d: U=%.3f LL bound=%.3f", core->core,
+               core->utilization, core->ll_bound);
+
+        for(; i < nresults && results[i].core == core->core; i++) {
+            result = &results[i];
+            estimated |= !result->measured;
+            if(verbose && result->response_ns >= 0)
+                printf("  %-16s C=%9.1f us%s T=%9.1f us R=%9.1f us margin %5.1f%%\n",
+                       result->svc->name, result->wcet_ns / 1000.0, result->measured ? " " : "*",
+                       result->period_ns / 1000.0, result->response_ns / 1000.0, result->margin * 100.0);
+            else if(verbose)
+                printf("  %-16s C=%9.1f us%s T=%9.1f us R > T, DEADLINE MISS\n",
+                       result->svc->name, result->wcet_ns / 1000.0, result->measured ? " " : "*",
+                       result->period_ns / 1000.0);
+            syslog(LOG_INFO, "RM analysis %s: C=%lld T=%lld R=%lld ns margin=%.1f%%",
+                   result->svc->name, result->wcet_ns, result->period_ns,
+                   result->response_ns, result->margin * 100.0);
+        }
+    }
+    if(verbose && estimated)
+        printf("  (* configured WCET, not measured yet)\n");
+    return misses;
+}
@@ -13,6 +13,7 @@
 #include <string.h> // for memcpy()
 #include "pthread.h"
 #include "../includes/circular_buff.h"
+#include "../includes/trace.h"
 
 
 // Declare memory for the queue/buffer, and our write and read pointers.
@@ -21,6 +22,7 @@ int  wptr      = 0;                  // write pointer
 int  rptr_diff = 0;                  // read pointer for differencing
 int  rptr_sel  = 0;                  // read pointer for selection
 int  depth = 0;                      // depth variable
+static unsigned long long frames_stored = 0;  // frames written since start
 
 pthread_mutex_t sgl;
 
@@ -92,6 +94,7 @@ bool write_size_and_time(cbuff_struct_t *frame_buffer, int size, struct timespec
   frame_buffer[wptr].size = size;
   frame_buffer[wptr].usefulness = -20;
   nextPtr(WRITE_POINTER);
+  __atomic_store_n(&frames_stored, frames_stored + 1, __ATOMIC_RELAXED);
   ret = true;
 
   return ret;
@@ -116,6 +119,26 @@ bool write_framecount(cbuff_struct_t *frame_buffer, int framecount) {
   return ret;
 } // write_usefulness() 
 
+bool write_stage_time(cbuff_struct_t *frame_buffer, pointer_type_t type, frame_stage_t stage, int64_t ns) {
+  bool ret = false;
+  int index = 0;
+
+  if(type == WRITE_POINTER)
+    index = wptr;
+  else if(type == READ_DIFF_POINTER)
+    index = rptr_diff;
+  else if(type == READ_SEL_POINTER)
+    index = rptr_sel;
+  else
+    return ret;
+
+  // write to queue
+  frame_buffer[index].stage_ns[stage] = ns;
+  ret = true;
+
+  return ret;
+} // write_stage_time()
+
 int read_usefulness(cbuff_struct_t *frame_buffer, pointer_type_t type) {
   int ret = ERROR_READ_UFN;
   bool valid_args = false; 
@@ -214,7 +237,7 @@ cbuff_struct_t *read_cbuf_entry(cbuff_struct_t *frame_buffer) {
 
 bool circular_buff_lock(void) {
   bool ret = false;
-  if(pthread_mutex_lock(&sgl) == 0)
+  if(trace_mutex_lock(&sgl, TRACE_LOCK_CBUF) == 0)
     ret = true;
 
   return ret;
@@ -238,4 +261,12 @@ int getMSfromTimestamp(struct timespec *time) {
 
 void print_cbuf_info(void) {
   printf("wptr:%d, rptr_diff:%d, rptr_sel:%d, depth:%d \n",wptr,rptr_diff,rptr_sel,depth);
+}
+
+int get_cbuf_depth(void) {
+  return __atomic_load_n(&depth, __ATOMIC_RELAXED);
+}
+
+unsigned long long get_cbuf_frames(void) {
+  return __atomic_load_n(&frames_stored, __ATOMIC_RELAXED);
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "../includes/circular_buff.h"
 #include "../includes/writeback.h"
 #include "../includes/differencing.h"
+#include "../includes/trace.h"
 // for logging
 #include <syslog.h>
 #include <stdio.h>
@@ -36,25 +37,38 @@ extern unsigned char *new_frame;
 int offset = 10.0;
 
 int new_ts, old_ts = 0;
+
+// overload degradation, set by the services before every job
+static int diff_stride = 1;                      // compare every diff_stride-th pixel
+static int selection_divider = 1;                // select at FRAME_SELECTION_RATE_HZ / selection_divider
 struct timespec temp_time;
 extern int garbage_frames;
 extern int  rptr_diff;                 // read pointer for differencing
 extern int  rptr_sel;                 // read pointer for selection
 
-static int perform_diff(unsigned char *new, unsigned char *prev, int size) {
+// a stride above 1 samples the frame and scales the count back up, so
+// PIXEL_DIFFERENCE_THRESHOLD keeps its meaning
+int perform_diff(unsigned char *new, unsigned char *prev, int size, int stride) {
     unsigned long diff_count = 0;
 
     if(size > MAX_BUFFER_LENGTH)
         return -ERROR_BUFFER_SIZE;
 
-    for(int pix = 0; pix < size; pix++) {
+    for(int pix = 0; pix < size; pix += stride) {
         if(new[pix] - prev[pix] > FRAME_DIFF_THRESHOLD) {
             diff_count++;
         }
     }
-    syslog(LOG_INFO, "Successfully calculated diff");
 
-    return diff_count;
+    return diff_count * stride;
+}
+
+void set_diff_stride(int stride) {
+    diff_stride = (stride < 1) ? 1 : stride;
+}
+
+void set_selection_divider(int divider) {
+    selection_divider = (divider < 1) ? 1 : divider;
 }
 
 int differencing(cbuff_struct_t *frame_buffer) {
@@ -78,12 +92,13 @@ int differencing(cbuff_struct_t *frame_buffer) {
                     new_frame = read_frame_ptr(frame_buffer, READ_DIFF_POINTER, &size);
                     // printf("entry in diff=%p\n", new_frame);
                     // printf("size got=%d \n", size); 
-                    temp = perform_diff(new_frame, previous_frame, size);
+                    temp = perform_diff(new_frame, previous_frame, size, diff_stride);
+                    write_stage_time(frame_buffer, READ_DIFF_POINTER, FRAME_STAGE_DIFFERENCED, trace_now());
                     //printf("Diff=%d \n", temp); 
                     if(temp < PIXEL_DIFFERENCE_THRESHOLD) {    // perform difference
                         write_usefulness(frame_buffer, temp);                                                 // marking // FRAME_USEFUL
                         //print_cbuf_info();
-                        syslog(LOG_INFO, "Differencing: pointer %d marked as useful", rptr_diff);
+                        trace_event(TRACE_DIFF_USEFUL, rptr_diff, temp, 0);
                     } else {
                         write_usefulness(frame_buffer, FRAME_NOT_USEFUL);
                     }
@@ -108,23 +123,26 @@ int frame_select(cbuff_struct_t *frame_buffer) {
               (frame_count <=  FRAME_CAPTURE_COUNT)) {
             read_timestamp(frame_buffer, READ_SEL_POINTER, &temp_time);
             new_ts = getMSfromTimestamp(&temp_time);
-            if((new_ts > old_ts) && ((new_ts - old_ts) > (FRAME_SELECTION_TIME_MS - offset))) {
+            if((new_ts > old_ts) &&
+               ((new_ts - old_ts) > (FRAME_SELECTION_TIME_MS * selection_divider - offset))) {
                 temp_diff = read_usefulness(frame_buffer, READ_SEL_POINTER);
                 if(temp_diff > -1) {
 
                     circular_buff_lock();
                         write_framecount(frame_buffer, frame_count);                           //write frame count
                         element = read_cbuf_entry(frame_buffer);
+                        element->stage_ns[FRAME_STAGE_SELECTED] = trace_now();
                         //printf("Frame select: size=%d framecount=%d time=%d\n", element->size, element->frame_count, element->timestamp.tv_sec);
                         temp = push_frame_fifo(element);                          // push pointer to queue
                     circular_buff_unlock();
-                
-                    if(temp == -1)
-                        printf("Queue full. Unable to push to queue\n");
+                    // pushed or dropped on a full queue, the trace and the
+                    // writeback counters have it, selection runs at RT priority
+                    trace_event(TRACE_FRAME_SELECTED, frame_count, temp == 0, temp_diff);
+
+                    // a dropped frame does not consume a frame count, the
+                    // writeback reorder buffer commits counts without gaps
                     if(temp == 0)
-                        printf("Frame %d successsfully pushed to queue, diff=%d, time=%d ", frame_count, temp_diff, new_ts);
-                        print_cbuf_info();
-                    frame_count++;
+                        frame_count++;
                     ret = 1;
                     old_ts = new_ts;
                     break;
@@ -16,6 +16,9 @@
 #include "../includes/circular_buff.h"   
 
 #include "../includes/sequencer.h"
+#include "../includes/timesource.h"
+#include "../includes/replay.h"
+#include "../includes/trace.h"
 
 // variables declaration 
 static struct v4l2_format fmt;                            // V4L2 struct
@@ -25,6 +28,7 @@ extern double start_realtime;
 struct buffer          *buffers;
 static unsigned int     n_buffers;        
 int garbage_frames = 20;                                
+static frame_format_t frame_format = FRAME_FORMAT_RGB;   // format stored in the frame buffer
 //unsigned char bigbuffer[(1280*960)];                      // buffer for RGB conversion 
 
 /**
@@ -96,7 +100,7 @@ static void yuv2rgb(int y, int u, int v, unsigned char *r, unsigned char *g, uns
  * @param size - size of the YUV buffer
  * @return no return
  */
-static void process_image(const void *p, int size, unsigned char *bigbuffer) {
+void process_image(const void *p, int size, unsigned char *bigbuffer) {
     int i, newi=0;
     int y_temp, y2_temp, u_temp, v_temp;
     unsigned char *pptr = (unsigned char *)p;
@@ -113,6 +117,26 @@ static void process_image(const void *p, int size, unsigned char *bigbuffer) {
     }
 }
 
+/**
+ * @brief Function to extract the luma plane from YUYV. The Y samples are
+ * copied as-is, so no colour conversion is done.
+ * @param p - input frame buffer in YUV format
+ * @param size - size of the YUV buffer
+ * @param graybuffer - output buffer, size/2 bytes
+ * @return no return
+ */
+void process_image_gray(const void *p, int size, unsigned char *graybuffer) {
+    int i, newi=0;
+    unsigned char *pptr = (unsigned char *)p;
+
+    // Pixels are YU and YV alternating, so YUYV which is 4 bytes
+    // Y1=first byte and Y2=third byte
+    for(i=0, newi=0; i<size; i=i+4, newi=newi+2) {
+        graybuffer[newi]=pptr[i];
+        graybuffer[newi+1]=pptr[i+2];
+    }
+}
+
 /**
  * @brief Function to initialize the memory map for frame capture
  * @param fd - file descriptor for video device
@@ -374,6 +398,7 @@ void read_frames(const int fd, cbuff_struct_t *frame_buffer) {
     cbuff_struct_t *buffer_entry;
     struct timespec frame_time;
     struct timespec current_time_val;
+    int64_t trace_start;
     struct timeval tv = {                                     // timeout val for select
         .tv_sec   = 2,
         .tv_usec  = 0
@@ -386,6 +411,7 @@ void read_frames(const int fd, cbuff_struct_t *frame_buffer) {
     dbuf.memory = V4L2_MEMORY_MMAP;
 
     // check if fd is ready to read new frame value
+    trace_start = trace_now();
     r = select(fd + 1, &fds, NULL, NULL, &tv);
     while(r <= 0) {
         if (-1 == r) {
@@ -399,15 +425,17 @@ void read_frames(const int fd, cbuff_struct_t *frame_buffer) {
         if(r == 0) {
             fprintf(stderr, "select timeout\n");
             syslog(LOG_INFO, "Select syscall timeout");
-            clock_gettime(MY_CLOCK, &current_time_val);
+            timesource_gettime(&current_time_val);
             syslog(LOG_INFO, "select exit called @ sec=%6.9lf\n", realtime(&current_time_val)-start_realtime);
             exit(EXIT_FAILURE);
         }
     }
-    syslog(LOG_INFO, "Select syscall returned %d", r);
     // capture frame acqisition time
-    clock_gettime(MY_CLOCK, &frame_time);                     // set start time
+    timesource_gettime(&frame_time);                          // set start time
+    trace_event(TRACE_SELECT_RETURN, r,
+                (int64_t)frame_time.tv_sec * 1000000000LL + frame_time.tv_nsec - trace_start, 0);
 
+    trace_start = trace_now();
     if(-1 == xioctl(fd, VIDIOC_DQBUF, &dbuf)) {
         switch (errno) {
             case EAGAIN:
@@ -419,15 +447,29 @@ void read_frames(const int fd, cbuff_struct_t *frame_buffer) {
         }
     }
     assert(dbuf.index < n_buffers);
+    trace_event(TRACE_V4L2_DQBUF, dbuf.index, trace_now() - trace_start, 0);
     
     if(garbage_frames == 0) {
         circular_buff_lock();
 
         buffer_entry = get_wptr(frame_buffer);
-        process_image(buffers[dbuf.index].start, dbuf.bytesused, buffer_entry->buffer);       // convert to RGB
-        //memcpy(ibuff, bigbuffer, sizeof(bigbuffer));                                        // transfer to o/p buffer
-        //CLEAR(bigbuffer);
-        write_size_and_time(frame_buffer, ((dbuf.bytesused * 6) / 4), &frame_time);                         // set the size for dumping and time
+        buffer_entry->format = frame_format;
+        memset(buffer_entry->stage_ns, 0, sizeof(buffer_entry->stage_ns));
+        buffer_entry->stage_ns[FRAME_STAGE_CAPTURED] = (int64_t)frame_time.tv_sec * 1000000000LL + frame_time.tv_nsec;
+        if(frame_format == FRAME_FORMAT_GRAY) {
+            process_image_gray(buffers[dbuf.index].start, dbuf.bytesused, buffer_entry->buffer);  // extract Y plane
+            buffer_entry->stage_ns[FRAME_STAGE_STORED] = trace_now();
+            write_size_and_time(frame_buffer, (dbuf.bytesused / 2), &frame_time);
+        } else {
+            process_image(buffers[dbuf.index].start, dbuf.bytesused, buffer_entry->buffer);       // convert to RGB
+            //memcpy(ibuff, bigbuffer, sizeof(bigbuffer));                                        // transfer to o/p buffer
+            //CLEAR(bigbuffer);
+            buffer_entry->stage_ns[FRAME_STAGE_STORED] = trace_now();
+            write_size_and_time(frame_buffer, ((dbuf.bytesused * 6) / 4), &frame_time);           // set the size for dumping and time
+        }
+        if(buffer_entry->native != NULL)                                                          // native 4:2:2 for the Y4M sink
+            memcpy(buffer_entry->native, buffers[dbuf.index].start,
+                   (dbuf.bytesused < NATIVE_FRAME_LENGTH) ? dbuf.bytesused : NATIVE_FRAME_LENGTH);
         circular_buff_unlock();
     }
 
@@ -439,5 +481,152 @@ void read_frames(const int fd, cbuff_struct_t *frame_buffer) {
     
     if(garbage_frames>0)
         garbage_frames--;
-    syslog(LOG_INFO, "Frame read successfully");
+    trace_event(TRACE_FRAME_READ, dbuf.index, dbuf.bytesused,
+                (int64_t)frame_time.tv_sec * 1000000000LL + frame_time.tv_nsec);
+}
+
+// BT.601 studio swing, the inverse of yuv2rgb()
+static void rgb2yuv(int r, int g, int b, int *y, int *u, int *v) {
+    *y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    *u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    *v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+/**
+ * @brief Helper function to convert a replayed RGB frame to packed YUYV,
+ * chroma averaged over each pixel pair
+ * @param rgb - HRES x VRES packed RGB frame
+ * @param dst - NATIVE_FRAME_LENGTH bytes
+ * @return no return
+ */
+static void store_replay_yuyv(const unsigned char *rgb, unsigned char *dst) {
+    int pix, y0, y1, u0, u1, v0, v1;
+
+    for(pix = 0; pix < HRES * VRES; pix += 2, rgb += 6, dst += 4) {
+        rgb2yuv(rgb[0], rgb[1], rgb[2], &y0, &u0, &v0);
+        rgb2yuv(rgb[3], rgb[4], rgb[5], &y1, &u1, &v1);
+        dst[0] = y0;
+        dst[1] = (u0 + u1) / 2;
+        dst[2] = y1;
+        dst[3] = (v0 + v1) / 2;
+    }
+}
+
+/**
+ * @brief Helper function to store a replayed RGB frame in the configured
+ * frame format
+ * @param rgb - HRES x VRES packed RGB frame
+ * @param dst - frame buffer entry
+ * @return size - bytes stored
+ */
+static int store_replay_image(const unsigned char *rgb, unsigned char *dst) {
+    int pix;
+
+    if(frame_format == FRAME_FORMAT_GRAY) {
+        for(pix = 0; pix < HRES * VRES; pix++, rgb += 3)
+            dst[pix] = ((66 * rgb[0] + 129 * rgb[1] + 25 * rgb[2] + 128) >> 8) + 16;
+        return HRES * VRES;
+    }
+    memcpy(dst, rgb, HRES * VRES * 3);
+    return HRES * VRES * 3;
+}
+
+/**
+ * @brief Function to read a frame from the replay source instead of the
+ * camera. Release n shows the recording n capture periods after its first
+ * frame and stamps the frame with that time, so a replay yields the same
+ * frames and timestamps in real and in virtual time.
+ * @param frame_buffer - circular buffer
+ * @param offset_ns - release time since the start of the recording
+ * @return no return
+ */
+void read_replay_frame(cbuff_struct_t *frame_buffer, long long offset_ns) {
+    struct timespec frame_time;
+    cbuff_struct_t *buffer_entry;
+    const unsigned char *rgb;
+    int size = 0;
+    int64_t captured_ns = trace_now();
+
+    rgb = replay_frame_at(offset_ns);
+    if(rgb == NULL) {
+        syslog(LOG_INFO, "Replay: unable to read frame");
+        exit(EXIT_FAILURE);
+    }
+
+    replay_epoch(&frame_time);
+    offset_ns += frame_time.tv_nsec;
+    frame_time.tv_sec += offset_ns / 1000000000LL;
+    frame_time.tv_nsec = offset_ns % 1000000000LL;
+
+    if(garbage_frames == 0) {
+        circular_buff_lock();
+
+        buffer_entry = get_wptr(frame_buffer);
+        buffer_entry->format = frame_format;
+        memset(buffer_entry->stage_ns, 0, sizeof(buffer_entry->stage_ns));
+        buffer_entry->stage_ns[FRAME_STAGE_CAPTURED] = captured_ns;
+        size = store_replay_image(rgb, buffer_entry->buffer);
+        if(buffer_entry->native != NULL)
+            store_replay_yuyv(rgb, buffer_entry->native);
+        buffer_entry->stage_ns[FRAME_STAGE_STORED] = trace_now();
+        write_size_and_time(frame_buffer, size, &frame_time);
+
+        circular_buff_unlock();
+    }
+
+    trace_event(TRACE_REPLAY_READ, garbage_frames, size,
+                (int64_t)frame_time.tv_sec * 1000000000LL + frame_time.tv_nsec);
+    if(garbage_frames>0)
+        garbage_frames--;
+}
+
+/**
+ * @brief Function to select the pixel format stored in the frame buffer.
+ * Must be called before the capture service is started.
+ * @param format - FRAME_FORMAT_RGB or FRAME_FORMAT_GRAY
+ * @return no return
+ */
+void set_frame_format(frame_format_t format) {
+    frame_format = format;
+}
+
+/**
+ * @brief Function to keep the packed YUYV of every frame next to the
+ * stored format, one allocation for the whole buffer
+ * @param frame_buffer - circular buffer
+ * @param entries - number of entries in the buffer
+ * @return 0 on success, -1 out of memory
+ */
+int keep_native_frames(cbuff_struct_t *frame_buffer, int entries) {
+    unsigned char *native;
+    int i;
+
+    native = malloc((size_t)entries * NATIVE_FRAME_LENGTH);
+    if(native == NULL)
+        return -1;
+    for(i = 0; i < entries; i++)
+        frame_buffer[i].native = native + (size_t)i * NATIVE_FRAME_LENGTH;
+    return 0;
+}
+
+/**
+ * @brief Function to free the YUYV copies of keep_native_frames()
+ * @param frame_buffer - circular buffer
+ * @param entries - number of entries in the buffer
+ * @return no return
+ */
+void release_native_frames(cbuff_struct_t *frame_buffer, int entries) {
+    int i;
+
+    free(frame_buffer[0].native);
+    for(i = 0; i < entries; i++)
+        frame_buffer[i].native = NULL;
+}
+
+/**
+ * @brief Function to get the pixel format stored in the frame buffer
+ * @return format - current frame format
+ */
+frame_format_t get_frame_format(void) {
+    return frame_format;
 }
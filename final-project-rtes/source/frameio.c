@@ -0,0 +1,278 @@
+/**
+*
+* This file contains the helper functions for writing frame files to
+* storage. In FRAMEIO_DIRECT mode every file is preallocated with
+* fallocate() and written in one aligned O_DIRECT write from a 4 KB aligned
+* staging buffer, so frames never sit in the page cache as dirty pages.
+* When the filesystem refuses O_DIRECT (tmpfs, some FUSE mounts) the file
+* is written through the page cache, flushed with sync_file_range() and
+* dropped with posix_fadvise(DONTNEED).
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "pthread.h"
+#include "../includes/frameio.h"
+#include "../includes/circular_buff.h"
+
+// for logging
+#include <syslog.h>
+
+#define STAGE_LENGTH   (((MAX_BUFFER_LENGTH + FRAMEIO_ALIGNMENT) + (FRAMEIO_ALIGNMENT - 1)) & \
+                        ~(FRAMEIO_ALIGNMENT - 1))
+#define ALIGN_UP(x)    (((x) + (FRAMEIO_ALIGNMENT - 1)) & ~(FRAMEIO_ALIGNMENT - 1))
+
+static frameio_mode_t frameio_mode = FRAMEIO_BUFFERED;
+static int fsync_batch = 0;
+static bool direct_supported = true;
+
+static int pending_fds[FRAMEIO_MAX_FSYNC_BATCH];  // files waiting for the batched fsync
+static int pending_count = 0;
+static unsigned long long retired_files = 0;      // guarded by sgl_frameio
+
+static frameio_stats_t frameio_stats;
+pthread_mutex_t sgl_frameio = PTHREAD_MUTEX_INITIALIZER;
+
+// one staging buffer per writer thread, allocated on its first frame
+static __thread unsigned char *stage = NULL;
+
+static void read_meminfo(long *dirty_kb, long *cached_kb) {
+    char line[128];
+    FILE *meminfo;
+
+    *dirty_kb = -1;
+    *cached_kb = -1;
+    meminfo = fopen("/proc/meminfo", "r");
+    if(meminfo == NULL)
+        return;
+    while(fgets(line, sizeof(line), meminfo) != NULL) {
+        if(strncmp(line, "Dirty:", 6) == 0)
+            *dirty_kb = strtol(&line[6], NULL, 10);
+        else if(strncmp(line, "Cached:", 7) == 0)
+            *cached_kb = strtol(&line[7], NULL, 10);
+    }
+    fclose(meminfo);
+}
+
+void frameio_init(frameio_mode_t mode, int batch) {
+    frameio_mode = mode;
+    if(batch < 0)
+        batch = 0;
+    if(batch > FRAMEIO_MAX_FSYNC_BATCH)
+        batch = FRAMEIO_MAX_FSYNC_BATCH;
+    fsync_batch = batch;
+
+    memset(&frameio_stats, 0, sizeof(frameio_stats));
+    read_meminfo(&frameio_stats.dirty_kb_start, &frameio_stats.cached_kb_start);
+    frameio_stats.dirty_kb_max = frameio_stats.dirty_kb_start;
+    frameio_stats.cached_kb_last = frameio_stats.cached_kb_start;
+}
+
+// record a page cache sample, must be called with sgl_frameio held
+static void record_meminfo(long dirty_kb, long cached_kb) {
+    if(dirty_kb > frameio_stats.dirty_kb_max)
+        frameio_stats.dirty_kb_max = dirty_kb;
+    frameio_stats.cached_kb_last = cached_kb;
+    frameio_stats.meminfo_samples++;
+}
+
+// sync the batch, must be called with sgl_frameio held
+static void sync_pending(void) {
+    int i;
+    long dirty_kb, cached_kb;
+
+    for(i = 0; i < pending_count; i++) {
+        fdatasync(pending_fds[i]);
+        close(pending_fds[i]);
+        frameio_stats.fsyncs++;
+    }
+    pending_count = 0;
+
+    read_meminfo(&dirty_kb, &cached_kb);
+    record_meminfo(dirty_kb, cached_kb);
+}
+
+// hand the file to the fsync policy, closes it when no batching is configured.
+// Runs on the writeback workers, which also sample the page cache every
+// FRAMEIO_MEMINFO_FILES files whatever the fsync batch, so the Dirty peak
+// is seen while the run writes and not only where it syncs.
+static void retire_fd(int fd) {
+    long dirty_kb, cached_kb;
+    bool sample;
+
+    pthread_mutex_lock(&sgl_frameio);
+    if(fsync_batch == 0) {
+        close(fd);
+    } else {
+        pending_fds[pending_count++] = fd;
+        if(pending_count >= fsync_batch)
+            sync_pending();
+    }
+    sample = ((++retired_files % FRAMEIO_MEMINFO_FILES) == 0);
+    pthread_mutex_unlock(&sgl_frameio);
+
+    // /proc/meminfo is read outside the lock, the other workers keep writing
+    if(sample) {
+        read_meminfo(&dirty_kb, &cached_kb);
+        pthread_mutex_lock(&sgl_frameio);
+        record_meminfo(dirty_kb, cached_kb);
+        pthread_mutex_unlock(&sgl_frameio);
+    }
+}
+
+static int write_all(int fd, const unsigned char *p, int size) {
+    int written, total = 0;
+
+    do {
+        written = write(fd, p + total, size - total);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += written;
+    } while(total < size);
+
+    return total;
+}
+
+static int write_buffered(const char *path, const char *header, int header_len,
+                          const unsigned char *payload, int size, bool hygiene) {
+    int fd, total;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(fd < 0) {
+        syslog(LOG_ERR, "frameio: unable to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    if(write_all(fd, (const unsigned char *)header, header_len) < 0 ||
+       (total = write_all(fd, payload, size)) < 0) {
+        syslog(LOG_ERR, "frameio: write to %s failed: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if(hygiene) {
+        // push the pages out now and drop them, so dirty pages never pile up
+        sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                  SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        __atomic_fetch_add(&frameio_stats.fadvise_calls, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&frameio_stats.buffered_writes, 1, __ATOMIC_RELAXED);
+
+    retire_fd(fd);
+    return header_len + total;
+}
+
+static int write_direct(const char *path, const char *header, int header_len,
+                        const unsigned char *payload, int size) {
+    int fd, length, aligned_length;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 00666);
+    if(fd < 0) {
+        if(errno == EINVAL) {
+            syslog(LOG_WARNING, "frameio: O_DIRECT not supported for %s, using fadvise", path);
+            direct_supported = false;
+            __atomic_fetch_add(&frameio_stats.direct_fallbacks, 1, __ATOMIC_RELAXED);
+            return write_buffered(path, header, header_len, payload, size, true);
+        }
+        syslog(LOG_ERR, "frameio: unable to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    if(stage == NULL) {
+        if(posix_memalign((void **)&stage, FRAMEIO_ALIGNMENT, STAGE_LENGTH) != 0) {
+            stage = NULL;
+            close(fd);
+            return -1;
+        }
+    }
+
+    length = header_len + size;
+    if(length > STAGE_LENGTH) {
+        close(fd);
+        return -1;
+    }
+    aligned_length = ALIGN_UP(length);
+
+    if(fallocate(fd, 0, 0, aligned_length) < 0)
+        __atomic_fetch_add(&frameio_stats.fallocate_failures, 1, __ATOMIC_RELAXED);
+
+    memcpy(stage, header, header_len);
+    memcpy(&stage[header_len], payload, size);
+    memset(&stage[length], 0, aligned_length - length);
+
+    if(write_all(fd, stage, aligned_length) < 0) {
+        syslog(LOG_ERR, "frameio: direct write to %s failed: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // drop the alignment padding
+    if(ftruncate(fd, length) < 0)
+        syslog(LOG_ERR, "frameio: unable to trim %s: %s", path, strerror(errno));
+
+    __atomic_fetch_add(&frameio_stats.direct_writes, 1, __ATOMIC_RELAXED);
+
+    retire_fd(fd);
+    return length;
+}
+
+int frameio_write(const char *path, const char *header, int header_len,
+                  const unsigned char *payload, int size) {
+    int ret;
+
+    if((frameio_mode == FRAMEIO_DIRECT) && direct_supported)
+        ret = write_direct(path, header, header_len, payload, size);
+    else
+        ret = write_buffered(path, header, header_len, payload, size, (frameio_mode == FRAMEIO_DIRECT));
+
+    if(ret > 0) {
+        __atomic_fetch_add(&frameio_stats.files, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&frameio_stats.bytes, ret, __ATOMIC_RELAXED);
+    }
+    return ret;
+}
+
+void frameio_flush(void) {
+    pthread_mutex_lock(&sgl_frameio);
+    sync_pending();
+    pthread_mutex_unlock(&sgl_frameio);
+}
+
+void frameio_get_stats(frameio_stats_t *stats) {
+    pthread_mutex_lock(&sgl_frameio);
+    memcpy(stats, &frameio_stats, sizeof(frameio_stats_t));
+    pthread_mutex_unlock(&sgl_frameio);
+}
+
+void frameio_print_stats(void) {
+    frameio_stats_t stats;
+
+    frameio_get_stats(&stats);
+    printf("Frame output (%s, fsync every %d files):\n",
+           (frameio_mode == FRAMEIO_DIRECT) ? "O_DIRECT" : "buffered", fsync_batch);
+    printf("  files=%llu bytes=%llu direct=%llu buffered=%llu\n",
+           stats.files, stats.bytes, stats.direct_writes, stats.buffered_writes);
+    printf("  direct fallbacks=%llu fallocate failures=%llu fsyncs=%llu fadvise=%llu\n",
+           stats.direct_fallbacks, stats.fallocate_failures, stats.fsyncs, stats.fadvise_calls);
+    printf("  page cache: Dirty start=%ld kB max=%ld kB, Cached start=%ld kB last=%ld kB (%llu samples)\n",
+           stats.dirty_kb_start, stats.dirty_kb_max, stats.cached_kb_start, stats.cached_kb_last,
+           stats.meminfo_samples);
+    syslog(LOG_INFO, "frameio: files=%llu direct=%llu buffered=%llu fsyncs=%llu dirty max=%ld kB",
+           stats.files, stats.direct_writes, stats.buffered_writes, stats.fsyncs, stats.dirty_kb_max);
+}
@@ -0,0 +1,110 @@
+/**
+*
+* This file contains the fixed memory log-linear latency histograms. A
+* record is a count leading zeros, a shift and relaxed atomic adds, so the
+* services keep them enabled in every run instead of dumping raw samples.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <string.h>
+#include <stdbool.h>   // for true
+#include "../includes/histogram.h"
+
+static int bucket_index(uint64_t value) {
+    int msb;
+
+    if(value < (1U << HISTOGRAM_SUB_BITS))
+        return (int)value;
+
+    msb = 63 - __builtin_clzll(value);
+    if(msb > HISTOGRAM_MAX_BITS)
+        return HISTOGRAM_BUCKETS - 1;
+
+    // the top HISTOGRAM_SUB_BITS bits of the value select the bucket
+    return (1 << HISTOGRAM_SUB_BITS) + (msb - HISTOGRAM_SUB_BITS) * HISTOGRAM_HALF_SUB +
+           (int)((value >> (msb - HISTOGRAM_SUB_BITS + 1)) - HISTOGRAM_HALF_SUB);
+}
+
+// highest value counted in a bucket
+static int64_t bucket_upper(int index) {
+    int octave, sub;
+
+    if(index < (1 << HISTOGRAM_SUB_BITS))
+        return index;
+
+    octave = (index - (1 << HISTOGRAM_SUB_BITS)) / HISTOGRAM_HALF_SUB;
+    sub = (index - (1 << HISTOGRAM_SUB_BITS)) % HISTOGRAM_HALF_SUB;
+    return ((int64_t)(HISTOGRAM_HALF_SUB + sub + 1) << (octave + 1)) - 1;
+}
+
+void histogram_reset(histogram_t *hist) {
+    memset(hist, 0, sizeof(histogram_t));
+    hist->min = INT64_MAX;
+}
+
+void histogram_record(histogram_t *hist, int64_t value) {
+    int64_t seen;
+
+    if(value < 0)
+        value = 0;
+
+    __atomic_fetch_add(&hist->buckets[bucket_index((uint64_t)value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+    seen = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while(value > seen && !__atomic_compare_exchange_n(&hist->max, &seen, value, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    seen = __atomic_load_n(&hist->min, __ATOMIC_RELAXED);
+    while(value < seen && !__atomic_compare_exchange_n(&hist->min, &seen, value, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELEASE);
+}
+
+int64_t histogram_percentile(const histogram_t *hist, double percentile) {
+    uint64_t total = 0, target, seen = 0;
+    int i;
+
+    for(i = 0; i < HISTOGRAM_BUCKETS; i++)
+        total += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+    if(total == 0)
+        return 0;
+
+    target = (uint64_t)((percentile / 100.0) * (double)total + 0.5);
+    if(target < 1)
+        target = 1;
+    if(target > total)
+        target = total;
+
+    for(i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        if(seen >= target)
+            break;
+    }
+    return bucket_upper(i);
+}
+
+void histogram_summarize(const histogram_t *hist, histogram_summary_t *summary) {
+    memset(summary, 0, sizeof(histogram_summary_t));
+    summary->count = __atomic_load_n(&hist->count, __ATOMIC_ACQUIRE);
+    if(summary->count == 0)
+        return;
+
+    summary->min = __atomic_load_n(&hist->min, __ATOMIC_RELAXED);
+    summary->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    summary->mean = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED) / (int64_t)summary->count;
+    summary->p50 = histogram_percentile(hist, 50.0);
+    summary->p90 = histogram_percentile(hist, 90.0);
+    summary->p99 = histogram_percentile(hist, 99.0);
+    summary->p999 = histogram_percentile(hist, 99.9);
+
+    // a bucket end may lie past the largest value recorded
+    if(summary->p50 > summary->max) summary->p50 = summary->max;
+    if(summary->p90 > summary->max) summary->p90 = summary->max;
+    if(summary->p99 > summary->max) summary->p99 = summary->max;
+    if(summary->p999 > summary->max) summary->p999 = summary->max;
+}
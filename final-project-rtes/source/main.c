@@ -10,18 +10,30 @@
 */
 #define _GNU_SOURCE
 
+#include <getopt.h>             /* getopt_long() */
+#include <signal.h>
+
 #include "../includes/circular_buff.h"
 #include "../includes/framecapture.h"
 #include "../includes/sequencer.h"
+#include "../includes/writeback.h"
+#include "../includes/frameio.h"
+#include "../includes/schedule.h"
+#include "../includes/services.h"
+#include "../includes/analysis.h"
+#include "../includes/topology.h"
+#include "../includes/timesource.h"
+#include "../includes/replay.h"
+#include "../includes/trace.h"
+#include "../includes/metrics.h"
+#include "../includes/preflight.h"
 
 #define FRAME_COUNTS                 (100)
-#define NUM_THREADS                  (4)
-#define NUM_CPU_CORES                (4)
 #define SEQUENCER_EXECUTION_CYCLES   (2000)
 
 // Global variables 
 int fd = -1;                                      // file descriptor 
-char *dev_name;                                   // device name place holder
+char *dev_name = DEFAULT_VIDEO_DEVICE;            // capture device, -d overrides it
 struct v4l2_buffer *capture_buf;                  // capture buffer pointer
 struct timespec frame_time;
 int unq_cnt = 0;
@@ -31,13 +43,9 @@ unsigned char *previous_frame;
 unsigned char *new_frame;
 
 unsigned long long sequencePeriods;
-sem_t semS1, semS2, semS3, semS4;
 
 // thread variables
-pthread_t threads[NUM_THREADS];
-threadParams_t threadParams[NUM_THREADS];
-pthread_attr_t rt_sched_attr[NUM_THREADS];
-int rt_max_prio, rt_min_prio, cpuidx;
+int rt_max_prio, rt_min_prio;
 pthread_attr_t main_attr;
 pid_t mainpid;
 
@@ -46,24 +54,433 @@ cpu_set_t threadcpu;
 cpu_set_t allcpuset;
 
 // scheduler parameters
-struct sched_param rt_param[NUM_THREADS];
 struct sched_param main_param;
 
-// timing variables
-timer_t timer_1;                           // main timer id
-struct itimerspec itime = {{1,0}, {1,0}};  // interval timer struct
-struct itimerspec last_itime;
+// sequencer thread variables
+pthread_t sequencer_thread;
+pthread_attr_t sequencer_attr;
+struct sched_param sequencer_param;
+int sequencer_core = SEQUENCER_CORE;
+
+// Service descriptors. The sequencer derives its minor frame, hyperperiod
+// and release table from the periods of the periodic services.
+service_table_t service_table;
+schedule_t sequencer_schedule;
 extern double start_realtime;              // declared in sequencer  
 
 void print_scheduler(void);
 
+// frame output settings
+frameio_mode_t output_mode = FRAMEIO_BUFFERED;
+int fsync_batch = 0;
+
+// Y4M stream sink, NULL for one file per frame
+char *y4m_path = NULL;
+
+// frames replayed from a recording instead of the camera, in real or virtual time
+char *replay_dir = NULL;
+bool sim_mode = false;
+bool free_run_mode = false;
+
+// scheduling mode, -M switches every service to SCHED_DEADLINE
+const char *sched_mode = "fifo";
+char *jitter_log = NULL;
+
+// binary event trace of the services, decoded by tools/tracedump
+char *trace_path = NULL;
+
+// shared memory page read by tools/synchronome-top, NULL if not published
+char *metrics_name = NULL;
+
+// per-frame stage latency log, NULL if not written
+char *latency_path = NULL;
+
+// wakeup latency measured on the service cores before the run, 0 ms skips it
+unsigned int preflight_ms = 0;
+bool preflight_abort = false;
+preflight_result_t preflight_result;
+
+// prints the latency histograms on SIGUSR1
+pthread_t stats_thread;
+
+// re-runs the RM analysis when the sequencer asks for it, off the RT threads
+pthread_t analysis_thread;
+sem_t analysis_due;
+static bool analysis_done = false;
+
+// Default service table, see services_add_defaults()
+static void init_service_table(void) {
+    static const service_entry_t entries[SERVICE_DEFAULTS] = { Service_1, Service_2, Service_3, Service_4 };
+
+    services_add_defaults(&service_table, entries);
+}
+
+// SIGUSR1 is blocked in every thread and taken here, so the report runs
+// in a normal thread context instead of a signal handler
+static void *stats_on_signal(void *arg) {
+    sigset_t *set = (sigset_t *)arg;
+    int sig;
+
+    while(sigwait(set, &sig) == 0)
+        services_report_histograms(&service_table);
+    return NULL;
+}
+
+// The sequencer only posts analysis_due, the analysis itself takes the
+// service locks, sorts and logs, so it runs here under SCHED_OTHER
+static void *analysis_on_request(void *arg) {
+    (void)arg;
+
+    while(1) {
+        while(sem_wait(&analysis_due) < 0 && errno == EINTR);
+        if(__atomic_load_n(&analysis_done, __ATOMIC_ACQUIRE))
+            break;
+        analysis_report(&service_table, false);
+    }
+    return NULL;
+}
+
+// build the sequencer release table from the periodic services
+static int build_schedule(void) {
+    schedule_service_t periodic[SCHEDULE_MAX_SERVICES];
+    service_desc_t *svc;
+    int i, n = 0;
+
+    for(i = 0; i < service_table.count; i++) {
+        svc = &service_table.services[i];
+        if(svc->period_us == 0)
+            continue;
+        periodic[n].name = svc->name;
+        periodic[n].period_us = svc->period_us;
+        periodic[n].release = &svc->release;
+        n++;
+    }
+    return schedule_build(&sequencer_schedule, periodic, n);
+}
+
+// place the services from the sysfs CPU topology, later options still override it
+static int auto_place(void) {
+    topology_t topo;
+    topology_plan_t plan;
+    char line[SERVICE_NAME_LENGTH + 16 + 8 * TOPOLOGY_MAX_CPUS];
+    int i, len;
+
+    if(topology_read(&topo, TOPOLOGY_SYSFS_ROOT) < 0)
+        return -1;
+    topology_plan(&topo, &plan);
+    topology_print(&topo, &plan);
+
+    sequencer_core = plan.sequencer;
+    snprintf(line, sizeof(line), "capture cpus=%d", plan.capture);
+    if(services_parse_line(&service_table, line) < 0)
+        return -1;
+    snprintf(line, sizeof(line), "differencing cpus=%d", plan.differencing);
+    if(services_parse_line(&service_table, line) < 0)
+        return -1;
+    snprintf(line, sizeof(line), "selection cpus=%d", plan.selection);
+    if(services_parse_line(&service_table, line) < 0)
+        return -1;
+    len = snprintf(line, sizeof(line), "writeback cpus=");
+    for(i = 0; i < plan.nwriter && i < SERVICE_MAX_CPUS; i++)
+        len += snprintf(line + len, sizeof(line) - len, "%s%d", i ? "," : "", plan.writer[i]);
+    return services_parse_line(&service_table, line);
+}
+
+static void usage(FILE *fp, char **argv) {
+    fprintf(fp,
+             "Usage: %s [options]\n\n"
+             "Options:\n"
+             "-h | --help          Print this message\n"
+             "-g | --gray          Keep the luma plane only and write P5 PGM frames\n"
+             "-D | --direct        Write frames with fallocate and aligned O_DIRECT\n"
+             "-b | --fsync-batch N fdatasync frame files in batches of N [%d]\n"
+             "-c | --config FILE   Load service descriptors from FILE\n"
+             "-s | --service LINE  Override one service, e.g. \"selection period=1000 cpus=2\"\n"
+             "                     keys: period (ms), priority (0..99|auto), policy (fifo|rr|other),\n"
+             "                           cpus (list), instances, overload (none|skip|shed|decimate)\n"
+             "-w | --writers N     Number of writeback workers, 1..%d [1]\n"
+             "-W | --writer-cores L Comma separated cores for the writeback workers [3]\n"
+             "-y | --y4m PATH      Append frames to one YUV4MPEG2 stream (file or named pipe),\n"
+             "                     4:2:2 from the camera YUYV, mono with -g\n"
+             "-S | --sequencer-core N Core for the sequencer thread [%d]\n"
+             "-M | --mode MODE     Run every service under fifo or deadline [fifo]\n"
+             "                     deadline keys: wcet, runtime, deadline, dlperiod (us)\n"
+             "-d | --device PATH   Capture from the V4L2 device PATH [%s]\n"
+             "-r | --replay DIR    Replay the recorded frames of DIR instead of the camera\n"
+             "-V | --sim           With -r, run in virtual time as fast as the services\n"
+             "                     complete, without real-time privileges. The selected\n"
+             "                     frames are reproducible between simulations, a\n"
+             "                     real-time run of the same recording may differ\n"
+             "-F | --free-run      With -r, release every service as soon as it is ready\n"
+             "                     instead of at its period and report the sustained\n"
+             "                     frame rate and the stage that saturates first. The\n"
+             "                     selected frames differ from a paced run\n"
+             "-A | --auto-place    Place the sequencer and services from the CPU topology\n"
+             "-J | --jitter-log FILE Append the start jitter of this run to FILE and\n"
+             "                     print it side by side with the other mode\n"
+             "-T | --trace FILE    Record the service events to FILE, see tools/tracedump\n"
+             "-P | --perf          Count cycles, instructions, cache misses and context\n"
+             "                     switches of every job with perf_event_open\n"
+             "-L | --latency-log FILE Write the capture to disk latency of every frame,\n"
+             "                     stage by stage, to FILE as CSV\n"
+             "-p | --preflight MS  Measure the wakeup latency on every service core for MS\n"
+             "                     milliseconds before the run and warn if it exceeds\n"
+             "                     %d%% of the capture period\n"
+             "-X | --preflight-abort Abort instead of warning, measures for %d ms unless\n"
+             "                     --preflight is given\n"
+             "-m | --metrics NAME  Publish live metrics to shared memory NAME, e.g. %s,\n"
+             "                     see tools/synchronome-top\n"
+             "\n"
+             "Send SIGUSR1 to print the latency histograms of the running services.\n"
+             "",
+             argv[0], fsync_batch, WRITEBACK_MAX_WORKERS, sequencer_core, DEFAULT_VIDEO_DEVICE, PREFLIGHT_BUDGET_PCT,
+             PREFLIGHT_DEFAULT_MS, METRICS_DEFAULT_NAME);
+}
+
+static const char short_options[] = "hgDb:c:s:w:W:y:S:M:J:Ad:r:VFT:m:PL:p:X";
+
+static const struct option
+long_options[] = {
+        { "help",   no_argument,       NULL, 'h' },
+        { "gray",   no_argument,       NULL, 'g' },
+        { "direct", no_argument,       NULL, 'D' },
+        { "fsync-batch", required_argument, NULL, 'b' },
+        { "config", required_argument, NULL, 'c' },
+        { "service", required_argument, NULL, 's' },
+        { "writers", required_argument, NULL, 'w' },
+        { "writer-cores", required_argument, NULL, 'W' },
+        { "y4m",    required_argument, NULL, 'y' },
+        { "sequencer-core", required_argument, NULL, 'S' },
+        { "mode",   required_argument, NULL, 'M' },
+        { "jitter-log", required_argument, NULL, 'J' },
+        { "auto-place", no_argument,   NULL, 'A' },
+        { "device", required_argument, NULL, 'd' },
+        { "replay", required_argument, NULL, 'r' },
+        { "sim",    no_argument,       NULL, 'V' },
+        { "free-run", no_argument,     NULL, 'F' },
+        { "trace",  required_argument, NULL, 'T' },
+        { "metrics", required_argument, NULL, 'm' },
+        { "perf",   no_argument,       NULL, 'P' },
+        { "latency-log", required_argument, NULL, 'L' },
+        { "preflight", required_argument, NULL, 'p' },
+        { "preflight-abort", no_argument, NULL, 'X' },
+        { 0, 0, 0, 0 }
+};
+
 /******************************/
-void main(void) {
+int main(int argc, char **argv) {
     struct timespec current_time_val, current_time_res;
     struct timespec start_time_val;
     double current_realtime, current_realtime_res;
+    static sigset_t stats_set;
+
+    int rc, scope;
+    char line[SERVICE_NAME_LENGTH + 64];
+    service_desc_t *writer;
+
+    // options are applied in order, later ones override earlier ones
+    init_service_table();
+
+    for (;;) {
+        int idx;
+        int c;
+
+        c = getopt_long(argc, argv, short_options, long_options, &idx);
+        if (-1 == c)
+            break;
+
+        switch (c) {
+            case 0: /* getopt_long() flag */
+                break;
+
+            case 'h':
+                usage(stdout, argv);
+                exit(EXIT_SUCCESS);
+
+            case 'g':
+                set_frame_format(FRAME_FORMAT_GRAY);
+                break;
+
+            case 'D':
+                output_mode = FRAMEIO_DIRECT;
+                break;
+
+            case 'b':
+                errno = 0;
+                fsync_batch = strtol(optarg, NULL, 0);
+                if (errno || fsync_batch < 0 || fsync_batch > FRAMEIO_MAX_FSYNC_BATCH) {
+                    fprintf(stderr, "fsync batch must be 0..%d\n", FRAMEIO_MAX_FSYNC_BATCH);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'c':
+                if (services_load_config(&service_table, optarg) < 0)
+                    exit(EXIT_FAILURE);
+                break;
+
+            case 's':
+                if (services_parse_line(&service_table, optarg) < 0)
+                    exit(EXIT_FAILURE);
+                break;
+
+            case 'w':
+                snprintf(line, sizeof(line), "writeback instances=%s", optarg);
+                if (services_parse_line(&service_table, line) < 0)
+                    exit(EXIT_FAILURE);
+                break;
+
+            case 'y':
+                y4m_path = optarg;
+                break;
+
+            case 'S':
+                errno = 0;
+                sequencer_core = strtol(optarg, NULL, 0);
+                if (errno || sequencer_core < 0 || sequencer_core >= CPU_SETSIZE) {
+                    fprintf(stderr, "invalid sequencer core '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'W':
+                snprintf(line, sizeof(line), "writeback cpus=%s", optarg);
+                if (services_parse_line(&service_table, line) < 0)
+                    exit(EXIT_FAILURE);
+                break;
+
+            case 'M':
+                if (strcmp(optarg, "deadline") == 0) {
+                    services_set_mode(&service_table, SERVICE_POLICY_DEADLINE);
+                } else if (strcmp(optarg, "fifo") != 0) {
+                    fprintf(stderr, "mode must be fifo or deadline\n");
+                    exit(EXIT_FAILURE);
+                }
+                sched_mode = optarg;
+                break;
+
+            case 'J':
+                jitter_log = optarg;
+                break;
+
+            case 'A':
+                if (auto_place() < 0)
+                    exit(EXIT_FAILURE);
+                break;
+
+            case 'd':
+                dev_name = optarg;
+                break;
+
+            case 'r':
+                replay_dir = optarg;
+                break;
+
+            case 'V':
+                sim_mode = true;
+                break;
+
+            case 'F':
+                free_run_mode = true;
+                break;
+
+            case 'T':
+                trace_path = optarg;
+                break;
+
+            case 'm':
+                metrics_name = optarg;
+                break;
+
+            case 'P':
+                perfcount_enable();
+                break;
+
+            case 'L':
+                latency_path = optarg;
+                break;
+
+            case 'p':
+                errno = 0;
+                preflight_ms = strtoul(optarg, NULL, 0);
+                if (errno || preflight_ms == 0) {
+                    fprintf(stderr, "invalid preflight time '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'X':
+                preflight_abort = true;
+                break;
+
+            default:
+                usage(stderr, argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+    // a stray word is most likely the value of a mistyped option
+    if (optind < argc) {
+        fprintf(stderr, "Unexpected argument '%s'\n", argv[optind]);
+        usage(stderr, argv);
+        exit(EXIT_FAILURE);
+    }
 
-    int i, rc, scope, flags=0;
+    // select the time source before any service reads it
+    start_time_val.tv_sec = 0;
+    start_time_val.tv_nsec = 0;
+    if (sim_mode && replay_dir == NULL) {
+        fprintf(stderr, "--sim needs a recording to replay, see --replay\n");
+        exit(EXIT_FAILURE);
+    }
+    if (free_run_mode && (replay_dir == NULL || sim_mode)) {
+        fprintf(stderr, "--free-run needs a recording to replay, see --replay, and real time\n");
+        exit(EXIT_FAILURE);
+    }
+    if (preflight_abort && preflight_ms == 0)
+        preflight_ms = PREFLIGHT_DEFAULT_MS;
+    if (preflight_ms > 0 && sim_mode) {
+        fprintf(stderr, "--preflight measures real-time wakeups and cannot run with --sim\n");
+        exit(EXIT_FAILURE);
+    }
+    if (sim_mode && strcmp(sched_mode, "deadline") == 0) {
+        fprintf(stderr, "--mode deadline needs real time and cannot run with --sim\n");
+        exit(EXIT_FAILURE);
+    }
+    // virtual time has no start jitter, its rows would skew the comparison
+    if (sim_mode && jitter_log != NULL) {
+        fprintf(stderr, "--jitter-log records real-time start jitter and cannot run with --sim\n");
+        exit(EXIT_FAILURE);
+    }
+    if (replay_dir != NULL) {
+        if (replay_open(replay_dir) < 0)
+            exit(EXIT_FAILURE);
+        replay_epoch(&start_time_val);
+    }
+    timesource_init(sim_mode ? TIMESOURCE_VIRTUAL : (free_run_mode ? TIMESOURCE_FREE_RUN : TIMESOURCE_REAL),
+                    &start_time_val, replay_dir != NULL);
+    if (sim_mode) {
+        // virtual time does not rely on priorities, run without privileges
+        services_set_mode(&service_table, SERVICE_POLICY_OTHER);
+        timesource_set_idle_check(writeback_pending);
+    }
+
+    // before any thread is created, so all of them inherit the mask
+    sigemptyset(&stats_set);
+    sigaddset(&stats_set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &stats_set, NULL);
+    if (pthread_create(&stats_thread, NULL, stats_on_signal, &stats_set) != 0) {
+        fprintf(stderr, "Unable to start the stats thread\n");
+        exit(EXIT_FAILURE);
+    }
+    // created before main turns SCHED_FIFO, so it stays a normal thread
+    sem_init(&analysis_due, 0, 0);
+    if (pthread_create(&analysis_thread, NULL, analysis_on_request, NULL) != 0) {
+        fprintf(stderr, "Unable to start the analysis thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (trace_path != NULL && trace_open(trace_path) < 0)
+        exit(EXIT_FAILURE);
 
     //global circular buffer 
     cbuff_struct_t *frame_buffer = (cbuff_struct_t *)calloc(QUEUE_DEPTH, sizeof(cbuff_struct_t));
@@ -74,11 +491,33 @@ void main(void) {
 
     //init_circular_buffer(frame_buffer);
 
+    // render the static frame header fields once, before any service runs
+    init_frame_headers();
+    frameio_init(output_mode, fsync_batch);
+    writer = services_find(&service_table, "writeback");
+    if (writer->instances > WRITEBACK_MAX_WORKERS) {
+        fprintf(stderr, "writeback workers must be 1..%d\n", WRITEBACK_MAX_WORKERS);
+        exit(EXIT_FAILURE);
+    }
+    init_writeback_pool(writer->instances);
+    if (y4m_path != NULL && init_y4m_sink(y4m_path) < 0)
+        exit(EXIT_FAILURE);
+    // the Y4M sink splits the camera YUYV, not the RGB the services see
+    if (y4m_path != NULL && get_frame_format() == FRAME_FORMAT_RGB &&
+        keep_native_frames(frame_buffer, QUEUE_DEPTH) < 0) {
+        fprintf(stderr, "Out of memory for the native frames of the Y4M stream\n");
+        exit(EXIT_FAILURE);
+    }
+    if (latency_path != NULL && init_latency_log(latency_path) < 0)
+        exit(EXIT_FAILURE);
+    if (metrics_name != NULL && metrics_open(metrics_name, &service_table) < 0)
+        exit(EXIT_FAILURE);
+
     printf("ECEN 5623 Realtime Embedded Systems Final project\n");
     syslog(LOG_INFO, "ECEN 5623 Realtime Embedded Systems Final project");
     
-    clock_gettime(MY_CLOCK, &start_time_val);     start_realtime=realtime(&start_time_val);
-    clock_gettime(MY_CLOCK, &current_time_val);   current_realtime=realtime(&current_time_val);
+    timesource_gettime(&start_time_val);          start_realtime=realtime(&start_time_val);
+    timesource_gettime(&current_time_val);        current_realtime=realtime(&current_time_val);
     clock_getres(MY_CLOCK, &current_time_res);    current_realtime_res=realtime(&current_time_res);
     
     printf("START High Rate Sequencer @ sec=%6.9lf with resolution %6.9lf\n", 
@@ -88,30 +527,26 @@ void main(void) {
 
     printf("System has %d processors configured and %d available.\n", get_nprocs_conf(), get_nprocs());
 
-    // clear cpuset
+    // the cores this process may run on, not a fixed board layout
     CPU_ZERO(&allcpuset);
-    for(i=0; i < NUM_CPU_CORES; i++)
-        CPU_SET(i, &allcpuset);
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &allcpuset) < 0)
+        perror("sched_getaffinity");
     printf("Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
     syslog(LOG_INFO, "Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
 
-    // initialize the sequencer semaphores
-    if (sem_init (&semS1, 0, 0)) { printf ("Failed to initialize S1 semaphore\n"); exit (-1); }
-    if (sem_init (&semS2, 0, 0)) { printf ("Failed to initialize S2 semaphore\n"); exit (-1); }
-    if (sem_init (&semS3, 0, 0)) { printf ("Failed to initialize S3 semaphore\n"); exit (-1); }
-    if (sem_init (&semS4, 0, 0)) { printf ("Failed to initialize S4 semaphore\n"); exit (-1); }
-
     mainpid=getpid();
 
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
     rt_min_prio = sched_get_priority_min(SCHED_FIFO);
 
-    // set SCHED_FIFO as scheduler
-    rc=sched_getparam(mainpid, &main_param);
-    main_param.sched_priority=rt_max_prio;
-    rc=sched_setscheduler(getpid(), SCHED_FIFO, &main_param);
-    if(rc < 0) perror("main_param");
-    print_scheduler();
+    // set SCHED_FIFO as scheduler, a simulation run stays unprivileged
+    if(!sim_mode) {
+        rc=sched_getparam(mainpid, &main_param);
+        main_param.sched_priority=rt_max_prio;
+        rc=sched_setscheduler(getpid(), SCHED_FIFO, &main_param);
+        if(rc < 0) perror("main_param");
+        print_scheduler();
+    }
 
 
     pthread_attr_getscope(&main_attr, &scope);
@@ -126,146 +561,103 @@ void main(void) {
     printf("rt_min_prio=%d\n", rt_min_prio);
 
 
-    // set thread 1 on core 1. 
-    // Highest priority thread on core 2 for frame capture
-    CPU_ZERO(&threadcpu);
-    cpuidx=(1);
-    CPU_SET(cpuidx, &threadcpu);
-
-    rc=pthread_attr_init(&rt_sched_attr[0]);
-    rc=pthread_attr_setinheritsched(&rt_sched_attr[0], PTHREAD_EXPLICIT_SCHED);
-    rc=pthread_attr_setschedpolicy(&rt_sched_attr[0], SCHED_FIFO);
-    rc=pthread_attr_setaffinity_np(&rt_sched_attr[0], sizeof(cpu_set_t), &threadcpu);
-
-    rt_param[0].sched_priority=rt_max_prio;
-    pthread_attr_setschedparam(&rt_sched_attr[0], &rt_param[0]);
-    threadParams[0].threadIdx=1;
-    threadParams[0].global_cbuf=frame_buffer;
-
-    // set thread 2 and 3 on core 3. 
-    // Highest priority thread on core 3 for differencing
-    CPU_ZERO(&threadcpu);
-    cpuidx=(2);                    
-    CPU_SET(cpuidx, &threadcpu);
-
-    rc=pthread_attr_init(&rt_sched_attr[1]);
-    rc=pthread_attr_setinheritsched(&rt_sched_attr[1], PTHREAD_EXPLICIT_SCHED);
-    rc=pthread_attr_setschedpolicy(&rt_sched_attr[1], SCHED_FIFO);
-    rc=pthread_attr_setaffinity_np(&rt_sched_attr[1], sizeof(cpu_set_t), &threadcpu);
-
-    rt_param[1].sched_priority=rt_max_prio;
-    pthread_attr_setschedparam(&rt_sched_attr[1], &rt_param[1]);
-    threadParams[1].threadIdx=2;
-    threadParams[1].global_cbuf=frame_buffer;
-
-    // Second highest priority thread on core 3 for frame selection
-    CPU_ZERO(&threadcpu);
-    cpuidx=(2);
-    CPU_SET(cpuidx, &threadcpu);
+    // Create Service threads which will block awaiting release, one generic
+    // launcher for every descriptor of the table
+    services_assign_priorities(&service_table, rt_max_prio);
+    if(services_derive_deadline(&service_table) < 0)
+        exit(EXIT_FAILURE);
+    services_print(&service_table);
+
+    // measure the cores with the service priorities before the services occupy them
+    if(preflight_ms > 0) {
+        rc = preflight_run(&service_table, sequencer_core, rt_max_prio, preflight_ms, &preflight_result);
+        if(rc < 0) {
+            fprintf(stderr, "Unable to run the preflight, real-time privileges are needed\n");
+            exit(EXIT_FAILURE);
+        }
+        preflight_report(&preflight_result);
+        if(rc > 0 && preflight_abort) {
+            fprintf(stderr, "Wakeup latency exceeds the budget, aborting\n");
+            syslog(LOG_CRIT, "Preflight: wakeup latency exceeds the budget, aborting");
+            exit(EXIT_FAILURE);
+        }
+        if(rc > 0)
+            printf("WARNING: wakeup latency exceeds the budget, frame selection may be off by a frame\n");
+    }
 
-    rc=pthread_attr_init(&rt_sched_attr[2]);
-    rc=pthread_attr_setinheritsched(&rt_sched_attr[2], PTHREAD_EXPLICIT_SCHED);
-    rc=pthread_attr_setschedpolicy(&rt_sched_attr[2], SCHED_FIFO);
-    rc=pthread_attr_setaffinity_np(&rt_sched_attr[2], sizeof(cpu_set_t), &threadcpu);
+    if(services_launch(&service_table, frame_buffer) < 0) {
+        fprintf(stderr, "Unable to launch the services\n");
+        exit(-1);
+    }
+    if(services_print_admission(&service_table) > 0) {
+        fprintf(stderr, "SCHED_DEADLINE admission control refused the reservations\n");
+        exit(EXIT_FAILURE);
+    }
 
-    rt_param[2].sched_priority=rt_max_prio-1;
-    pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
-    threadParams[2].threadIdx=3;
-    threadParams[2].global_cbuf=frame_buffer;
+    // Create Sequencer thread, which like a cyclic executive, is highest prio
+    // Sequencer = RT_MAX, alone on its own core, wakes only on release points
+    if(build_schedule() < 0) {
+        fprintf(stderr, "Unable to build the sequencer schedule\n");
+        exit(-1);
+    }
+    schedule_print(&sequencer_schedule);
+    analysis_report(&service_table, true);
 
-    // set thread 4 on core 0. 
-    // Best effort thread for write-back to memory
     CPU_ZERO(&threadcpu);
-    cpuidx=(3);
-    CPU_SET(cpuidx, &threadcpu);
-
-    rc=pthread_attr_init(&rt_sched_attr[3]);
-    // rc=pthread_attr_setinheritsched(&rt_sched_attr[3], PTHREAD_EXPLICIT_SCHED);
-    // rc=pthread_attr_setschedpolicy(&rt_sched_attr[3], SCHED_OTHER);
-    rc=pthread_attr_setaffinity_np(&rt_sched_attr[3], sizeof(cpu_set_t), &threadcpu);
-
-    rt_param[3].sched_priority=rt_max_prio;
-    pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
-    threadParams[3].threadIdx=4;
-    threadParams[3].global_cbuf=frame_buffer;
-
-    // Create Service threads which will block awaiting release for:
-    // Servcie_1 = RT_MAX-1	@ 33 Hz. Frame capture
-    rc=pthread_create(&threads[0],               // pointer to thread descriptor
-                      &rt_sched_attr[0],         // use specific attributes
-                      Service_1,                 // thread function entry point
-                      (void *)&(threadParams[0]) // parameters to pass in
-                     );
-    if(rc < 0)
-        perror("pthread_create for service 1");
-    else
-        printf("pthread_create successful for service 1\n");
+    CPU_SET(sequencer_core, &threadcpu);
 
+    rc=pthread_attr_init(&sequencer_attr);
+    rc=pthread_attr_setinheritsched(&sequencer_attr, PTHREAD_EXPLICIT_SCHED);
+    rc=pthread_attr_setschedpolicy(&sequencer_attr, sim_mode ? SCHED_OTHER : SCHED_FIFO);
+    rc=pthread_attr_setaffinity_np(&sequencer_attr, sizeof(cpu_set_t), &threadcpu);
 
-    // Service_2 = RT_MAX-2	@ 20 Hz. Differencing
-    rc=pthread_create(&threads[1], 
-                      &rt_sched_attr[1],
-                      Service_2, 
-                      (void *)&(threadParams[1])
-                      );
-    if(rc < 0)
-        perror("pthread_create for service 2");
-    else
-        printf("pthread_create successful for service 2\n");
-
-
-    // Service_3 = RT_MAX-3	@ 1 Hz. Frame selection
-    rc=pthread_create(&threads[2], 
-                      &rt_sched_attr[2], 
-                      Service_3, 
-                      (void *)&(threadParams[2])
-                      );
-    if(rc < 0)
-        perror("pthread_create for service 3");
-    else
-        printf("pthread_create successful for service 3\n");
-
+    sequencer_param.sched_priority=sim_mode ? 0 : rt_max_prio;
+    pthread_attr_setschedparam(&sequencer_attr, &sequencer_param);
 
-    // Service_4 = RT_MAX-4, best effort. Write-back
-    rc=pthread_create(&threads[3], 
-                      &rt_sched_attr[3], 
-                      Service_4, 
-                      (void *)&(threadParams[3])
-                      );
-    if(rc < 0)
-        perror("pthread_create for service 4");
-    else
-        printf("pthread_create successful for service 4\n");
- 
-    // Create Sequencer thread, which like a cyclic executive, is highest prio
-    printf("Sequencer thread running on CPU=%d\n", sched_getcpu());
-    syslog(LOG_INFO, "Sequencer thread running on CPU=%d", sched_getcpu());
-
-    printf("Start sequencer\n");
+    printf("Start sequencer on CPU=%d\n", sequencer_core);
     //sequencePeriods=SEQUENCER_EXECUTION_CYCLES;
 
-    // Sequencer = RT_MAX	@ 100 Hz
-    /* set up to signal SIGALRM if timer expires */
-    timer_create(CLOCK_REALTIME, NULL, &timer_1);
-    signal(SIGALRM, (void(*)()) Sequencer);
-
-    /* arm the interval timer */
-    itime.it_interval.tv_sec = 0;
-    itime.it_interval.tv_nsec = 10000000;
-    itime.it_value.tv_sec = 0;
-    itime.it_value.tv_nsec = 10000000;
-
-    timer_settime(timer_1, flags, &itime, &last_itime);
-
-    for(i=0;i<NUM_THREADS;i++) {
-        if(rc=pthread_join(threads[i], NULL) < 0)
-            perror("main pthread_join");
-        else
-            printf("joined thread %d\n", i);
+    rc=pthread_create(&sequencer_thread, &sequencer_attr, Sequencer, (void *)&sequencer_schedule);
+    if(rc != 0) {
+        fprintf(stderr, "pthread_create for sequencer: %s\n", strerror(rc));
+        exit(-1);
     }
+
+    if(pthread_join(sequencer_thread, NULL) != 0)
+        perror("sequencer pthread_join");
+    else
+        printf("joined sequencer thread\n");
+
+    services_join();
+    metrics_close();
+    trace_close();
+    pthread_cancel(stats_thread);
+    pthread_join(stats_thread, NULL);
+    __atomic_store_n(&analysis_done, true, __ATOMIC_RELEASE);
+    sem_post(&analysis_due);
+    pthread_join(analysis_thread, NULL);
+
+   services_report_exec(&service_table);
+   services_report_histograms(&service_table);
+   services_report_perf(&service_table);
+   services_report_overload(&service_table);
+   analysis_report(&service_table, true);
+   services_report_jitter(&service_table, sched_mode, jitter_log);
+   if(jitter_log != NULL)
+       services_compare_jitter(jitter_log);
    
+   writeback_report_latency();
+   close_y4m_sink();
+   close_latency_log();
+   frameio_flush();
+   frameio_print_stats();
+   replay_close();
+
+   if (frame_buffer[0].native != NULL)
+       release_native_frames(frame_buffer, QUEUE_DEPTH);
    free(frame_buffer);
    printf("\nTEST COMPLETE\n");
+   return 0;
 }
 
 void print_scheduler(void) {
@@ -0,0 +1,248 @@
+/**
+*
+* This file contains the live metrics publisher. A thread under
+* SCHED_OTHER wakes every METRICS_PERIOD_MS, reads the counters and
+* histograms the services and the writeback pool keep anyway, and copies
+* a summary into a POSIX shared memory page under a seqlock. The services
+* never touch the page, so monitoring adds no system call and no lock to
+* the real-time threads, and a monitor that stalls cannot stall them.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../includes/metrics.h"
+#include "../includes/circular_buff.h"
+#include "../includes/writeback.h"
+#include "../includes/timesource.h"
+
+// for logging
+#include <syslog.h>
+
+// frame counters of the latest updates, for the frame rates
+typedef struct {
+  int64_t ns;
+  uint64_t captured;
+  uint64_t committed;
+}metrics_sample_t;
+
+static metrics_page_t *page = NULL;
+static metrics_page_t update;                  // built here, copied under the seqlock
+static char page_name[64];
+static service_table_t *services = NULL;
+static metrics_sample_t samples[METRICS_FPS_WINDOW + 1];
+static unsigned long long nsamples = 0;
+
+static volatile bool publisher_running = false;
+static pthread_t publisher_thread;
+
+static int64_t clock_ns(clockid_t clock) {
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int64_t pipeline_ns(void) {
+    struct timespec now;
+
+    timesource_gettime(&now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static double rate(uint64_t count, int64_t ns) {
+    return (ns > 0) ? (double)count * 1e9 / (double)ns : 0.0;
+}
+
+static void collect_services(void) {
+    service_desc_t *svc;
+    metrics_service_t *out;
+    histogram_summary_t latency, exec;
+    int i;
+
+    update.nservices = 0;
+    for(i = 0; (i < services->count) && (i < METRICS_MAX_SERVICES); i++) {
+        svc = &services->services[i];
+        out = &update.services[i];
+
+        // written by the service threads without locks, a value may be one job old
+        snprintf(out->name, METRICS_NAME_LENGTH, "%s", svc->name);
+        out->period_us = svc->period_us;
+        out->releases = __atomic_load_n(&svc->overload_stats.releases, __ATOMIC_RELAXED);
+        out->misses = __atomic_load_n(&svc->overload_stats.misses, __ATOMIC_RELAXED);
+        out->skipped = __atomic_load_n(&svc->overload_stats.skipped, __ATOMIC_RELAXED);
+        out->decimated = __atomic_load_n(&svc->overload_stats.decimated, __ATOMIC_RELAXED);
+        out->level = __atomic_load_n(&svc->overload_stats.level, __ATOMIC_RELAXED);
+        out->max_level = __atomic_load_n(&svc->overload_stats.max_level, __ATOMIC_RELAXED);
+
+        histogram_summarize(&svc->hist_latency, &latency);
+        histogram_summarize(&svc->hist_exec, &exec);
+        out->jobs = exec.count;
+        out->latency_p99 = latency.p99;
+        out->latency_max = latency.max;
+        out->exec_p50 = exec.p50;
+        out->exec_p99 = exec.p99;
+        out->exec_max = exec.max;
+        update.nservices++;
+    }
+}
+
+static void collect(void) {
+    writeback_stats_t wb;
+    histogram_summary_t latency;
+    metrics_sample_t *now, *oldest;
+    unsigned long long window;
+
+    update.update_ns = pipeline_ns();
+    update.update_mono_ns = clock_ns(CLOCK_MONOTONIC);
+    update.updates++;
+
+    writeback_get_stats(&wb);
+    update.frames_captured = get_cbuf_frames();
+    update.frames_queued = wb.queued;
+    update.frames_committed = wb.committed;
+    update.frames_dropped = wb.dropped;
+    update.cbuf_depth = get_cbuf_depth();
+    update.fifo_depth = wb.fifo_depth;
+    update.fifo_high_water = wb.fifo_high_water;
+    update.writeback_workers = get_writeback_workers();
+
+    histogram_summarize(wb.latency, &latency);
+    update.writeback_count = latency.count;
+    update.writeback_p50 = latency.p50;
+    update.writeback_p99 = latency.p99;
+    update.writeback_max = latency.max;
+
+    // frame rates over the last METRICS_FPS_WINDOW updates
+    now = &samples[nsamples % (METRICS_FPS_WINDOW + 1)];
+    now->ns = update.update_ns;
+    now->captured = update.frames_captured;
+    now->committed = update.frames_committed;
+    window = (nsamples < METRICS_FPS_WINDOW) ? nsamples : METRICS_FPS_WINDOW;
+    oldest = &samples[(nsamples - window) % (METRICS_FPS_WINDOW + 1)];
+    nsamples++;
+    update.capture_fps = rate(now->captured - oldest->captured, now->ns - oldest->ns);
+    update.commit_fps = rate(now->committed - oldest->committed, now->ns - oldest->ns);
+    update.commit_fps_avg = rate(update.frames_committed, update.update_ns - update.start_ns);
+
+    collect_services();
+}
+
+// seqlock write side, the only writer of the page
+static void publish(void) {
+    uint32_t seq = page->seq;
+
+    __atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    update.seq = seq + 1;
+    memcpy(page, &update, sizeof(metrics_page_t));
+    __atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void *publisher(void *arg) {
+    struct timespec period = { 0, METRICS_PERIOD_MS * 1000000L };
+
+    (void)arg;
+    while(publisher_running) {
+        collect();
+        publish();
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+int metrics_open(const char *name, service_table_t *table) {
+    pthread_attr_t attr;
+    struct sched_param param;
+    int fd, rc;
+
+    fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if(fd < 0) {
+        fprintf(stderr, "Metrics: shm_open %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    if(ftruncate(fd, sizeof(metrics_page_t)) < 0) {
+        fprintf(stderr, "Metrics: ftruncate %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    page = (metrics_page_t *)mmap(NULL, sizeof(metrics_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(page == MAP_FAILED) {
+        fprintf(stderr, "Metrics: mmap %s: %s\n", name, strerror(errno));
+        page = NULL;
+        shm_unlink(name);
+        return -1;
+    }
+    snprintf(page_name, sizeof(page_name), "%s", name);
+    services = table;
+
+    memset(&update, 0, sizeof(update));
+    update.magic = METRICS_MAGIC;
+    update.version = METRICS_VERSION;
+    update.size = sizeof(metrics_page_t);
+    update.state = METRICS_STATE_STARTING;
+    update.pid = getpid();
+    update.period_ms = METRICS_PERIOD_MS;
+    update.virtual_time = timesource_is_virtual() ? 1 : 0;
+    update.cbuf_capacity = QUEUE_DEPTH;
+    update.fifo_capacity = MAX_FIFO_DEPTH;
+    update.start_ns = pipeline_ns();
+    nsamples = 0;
+    collect();
+    publish();
+
+    // the publisher must not inherit the real-time policy of main
+    param.sched_priority = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+
+    update.state = METRICS_STATE_RUNNING;
+    publisher_running = true;
+    rc = pthread_create(&publisher_thread, &attr, publisher, NULL);
+    pthread_attr_destroy(&attr);
+    if(rc != 0) {
+        fprintf(stderr, "Metrics: pthread_create for the publisher: %s\n", strerror(rc));
+        publisher_running = false;
+        munmap(page, sizeof(metrics_page_t));
+        page = NULL;
+        shm_unlink(name);
+        return -1;
+    }
+    syslog(LOG_INFO, "Metrics: publishing to shared memory %s every %d ms", name, METRICS_PERIOD_MS);
+    return 0;
+}
+
+void metrics_close(void) {
+    if(page == NULL)
+        return;
+
+    publisher_running = false;
+    pthread_join(publisher_thread, NULL);
+
+    // monitors still mapping the page see the final state, new ones find nothing
+    update.state = METRICS_STATE_FINISHED;
+    collect();
+    publish();
+    munmap(page, sizeof(metrics_page_t));
+    page = NULL;
+    shm_unlink(page_name);
+    syslog(LOG_INFO, "Metrics: %llu updates published to %s", (unsigned long long)update.updates, page_name);
+}
@@ -0,0 +1,261 @@
+/**
+*
+* This file contains the optional per-thread performance counters. Every
+* service thread opens one perf_event_open() group counting cycles,
+* instructions, cache misses, LLC loads and context switches, and reads
+* the whole group with one read() at the start and at the end of each
+* job. Where the PMU is missing or perf_event_paranoid forbids it, the
+* thread falls back to the software events of the kernel, and to
+* getrusage() if perf_event_open() is refused altogether, so a run never
+* fails because of the counters.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+#include "../includes/perfcount.h"
+
+// for logging
+#include <syslog.h>
+
+typedef struct {
+  perfcount_event_t event;
+  uint32_t type;
+  uint64_t config;
+}perfcount_def_t;
+
+#define PERFCOUNT_LLC_READ_ACCESS   (PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+                                     (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16))
+
+// the first event of a group is its leader
+static const perfcount_def_t hardware_group[] = {
+  { PERFCOUNT_CYCLES,           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERFCOUNT_INSTRUCTIONS,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERFCOUNT_CACHE_MISSES,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERFCOUNT_LLC_LOADS,        PERF_TYPE_HW_CACHE, PERFCOUNT_LLC_READ_ACCESS },
+  { PERFCOUNT_CONTEXT_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+  { PERFCOUNT_TASK_CLOCK,       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { PERFCOUNT_PAGE_FAULTS,      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+};
+
+static const perfcount_def_t software_group[] = {
+  { PERFCOUNT_TASK_CLOCK,       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { PERFCOUNT_CONTEXT_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+  { PERFCOUNT_PAGE_FAULTS,      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+};
+
+static const char *mode_names[] = { "off", "hardware", "software", "rusage" };
+
+static bool perfcount_on = false;
+
+void perfcount_enable(void) {
+    perfcount_on = true;
+}
+
+bool perfcount_enabled(void) {
+    return perfcount_on;
+}
+
+const char *perfcount_mode_name(perfcount_mode_t mode) {
+    return mode_names[mode];
+}
+
+static int open_event(const perfcount_def_t *def, int group_fd, bool exclude_kernel) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = def->type;
+    attr.config = def->config;
+    attr.disabled = (group_fd == -1);          // the leader starts the whole group
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // this thread, on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void close_group(perfcount_t *perf) {
+    int i;
+
+    for(i = 0; i < PERFCOUNT_EVENTS; i++) {
+        if(perf->fds[i] >= 0)
+            close(perf->fds[i]);
+        perf->fds[i] = -1;
+        perf->slot[i] = PERFCOUNT_NOT_COUNTED;
+    }
+    perf->leader = -1;
+    perf->nslots = 0;
+}
+
+// open a group, a member the kernel does not know is left out
+static int open_group(perfcount_t *perf, const perfcount_def_t *defs, int count, bool exclude_kernel) {
+    int i, fd;
+
+    close_group(perf);
+    perf->leader = open_event(&defs[0], -1, exclude_kernel);
+    if(perf->leader < 0)
+        return -1;
+    perf->fds[defs[0].event] = perf->leader;
+    perf->slot[defs[0].event] = perf->nslots++;
+
+    for(i = 1; i < count; i++) {
+        // switches are counted in the kernel, user only counting reads 0
+        if(exclude_kernel && (defs[i].event == PERFCOUNT_CONTEXT_SWITCHES)) {
+            perf->slot[defs[i].event] = PERFCOUNT_FROM_RUSAGE;
+            continue;
+        }
+        fd = open_event(&defs[i], perf->leader, exclude_kernel);
+        if(fd < 0)
+            continue;
+        perf->fds[defs[i].event] = fd;
+        perf->slot[defs[i].event] = perf->nslots++;
+    }
+
+    ioctl(perf->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return 0;
+}
+
+// user and kernel time first, user time only if perf_event_paranoid asks for it
+static int open_group_any(perfcount_t *perf, const perfcount_def_t *defs, int count) {
+    if(open_group(perf, defs, count, false) == 0)
+        return 0;
+    if((errno != EACCES) && (errno != EPERM))
+        return -1;
+    return open_group(perf, defs, count, true);
+}
+
+perfcount_mode_t perfcount_open(perfcount_t *perf) {
+    int i, err;
+
+    memset(perf, 0, sizeof(perfcount_t));
+    perf->leader = -1;
+    for(i = 0; i < PERFCOUNT_EVENTS; i++) {
+        perf->fds[i] = -1;
+        perf->slot[i] = PERFCOUNT_NOT_COUNTED;
+    }
+    if(!perfcount_on)
+        return perf->mode = PERFCOUNT_OFF;
+
+    if(open_group_any(perf, hardware_group, sizeof(hardware_group) / sizeof(hardware_group[0])) == 0)
+        return perf->mode = PERFCOUNT_HARDWARE;
+    err = errno;
+
+    if(open_group_any(perf, software_group, sizeof(software_group) / sizeof(software_group[0])) == 0) {
+        syslog(LOG_INFO, "Perfcount: no hardware counters (%s), using software events", strerror(err));
+        return perf->mode = PERFCOUNT_SOFTWARE;
+    }
+    syslog(LOG_INFO, "Perfcount: perf_event_open refused (%s), using getrusage", strerror(errno));
+
+    perf->slot[PERFCOUNT_CONTEXT_SWITCHES] = PERFCOUNT_FROM_RUSAGE;
+    perf->slot[PERFCOUNT_TASK_CLOCK] = PERFCOUNT_FROM_RUSAGE;
+    perf->slot[PERFCOUNT_PAGE_FAULTS] = PERFCOUNT_FROM_RUSAGE;
+    return perf->mode = PERFCOUNT_RUSAGE;
+}
+
+// current values by event, and the group enabled and running times
+static int read_counters(perfcount_t *perf, uint64_t *values, uint64_t *enabled, uint64_t *running) {
+    uint64_t buf[3 + PERFCOUNT_EVENTS];
+    uint64_t usage_values[PERFCOUNT_EVENTS];
+    struct rusage usage;
+    bool need_usage = false;
+    int i;
+
+    *enabled = *running = 0;
+    if(perf->leader >= 0) {
+        // nr, time enabled, time running, then one value per member in open order
+        if(read(perf->leader, buf, sizeof(uint64_t) * (3 + perf->nslots)) <= 0)
+            return -1;
+        *enabled = buf[1];
+        *running = buf[2];
+    }
+    for(i = 0; i < PERFCOUNT_EVENTS; i++) {
+        if(perf->slot[i] >= 0)
+            values[i] = buf[3 + perf->slot[i]];
+        else if(perf->slot[i] == PERFCOUNT_FROM_RUSAGE)
+            need_usage = true;
+    }
+    if(!need_usage)
+        return 0;
+
+    if(getrusage(RUSAGE_THREAD, &usage) < 0)
+        return -1;
+    usage_values[PERFCOUNT_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+    usage_values[PERFCOUNT_PAGE_FAULTS] = usage.ru_minflt + usage.ru_majflt;
+    usage_values[PERFCOUNT_TASK_CLOCK] = (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+                                         (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+    for(i = 0; i < PERFCOUNT_EVENTS; i++)
+        if(perf->slot[i] == PERFCOUNT_FROM_RUSAGE)
+            values[i] = usage_values[i];
+    return 0;
+}
+
+void perfcount_job_start(perfcount_t *perf) {
+    if(perf->mode == PERFCOUNT_OFF)
+        return;
+    if(read_counters(perf, perf->start, &perf->start_enabled, &perf->start_running) < 0)
+        perf->mode = PERFCOUNT_OFF;
+}
+
+void perfcount_job_end(perfcount_t *perf) {
+    uint64_t values[PERFCOUNT_EVENTS];
+    uint64_t enabled, running, delta;
+    double scale = 1.0;
+    int i;
+
+    if(perf->mode == PERFCOUNT_OFF)
+        return;
+    if(read_counters(perf, values, &enabled, &running) < 0) {
+        perf->mode = PERFCOUNT_OFF;
+        return;
+    }
+
+    // the PMU was shared with other groups for part of the job, extrapolate
+    enabled -= perf->start_enabled;
+    running -= perf->start_running;
+    if(running < enabled) {
+        scale = (running > 0) ? (double)enabled / (double)running : 0.0;
+        __atomic_store_n(&perf->multiplexed, perf->multiplexed + 1, __ATOMIC_RELAXED);
+    }
+
+    for(i = 0; i < PERFCOUNT_EVENTS; i++) {
+        if(perf->slot[i] == PERFCOUNT_NOT_COUNTED)
+            continue;
+        delta = values[i] - perf->start[i];
+        // a group is scheduled on and off the PMU as a whole, its software
+        // members included, so every member read from it is scaled
+        if((perf->slot[i] >= 0) && (scale != 1.0))
+            delta = (uint64_t)((double)delta * scale);
+        __atomic_store_n(&perf->total[i], perf->total[i] + delta, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&perf->jobs, perf->jobs + 1, __ATOMIC_RELEASE);
+}
+
+void perfcount_close(perfcount_t *perf) {
+    int i;
+
+    if(perf->leader >= 0)
+        ioctl(perf->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // the slots and totals stay for the report
+    for(i = 0; i < PERFCOUNT_EVENTS; i++) {
+        if(perf->fds[i] >= 0)
+            close(perf->fds[i]);
+        perf->fds[i] = -1;
+    }
+    perf->leader = -1;
+}
@@ -0,0 +1,242 @@
+/**
+*
+* This file contains the scheduling latency preflight. How closely the
+* selected frames follow the seconds depends on how late the RT threads
+* wake up on their cores, which is a property of the board, the kernel and
+* whatever else runs on it, so it is measured before the services start
+* instead of being found out from a bad run.
+*
+* Like cyclictest, every measurement thread sleeps to an absolute deadline
+* with clock_nanosleep() and records how late it woke up. The threads take
+* the place, policy and priority of the sequencer and of every periodic
+* service, so each core is measured at the priorities that will run on it.
+* The samples go into one histogram per core and the worst case is checked
+* against a budget of PREFLIGHT_BUDGET_PCT of the capture period.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../includes/preflight.h"
+
+// for logging
+#include <syslog.h>
+
+#define NSEC_PER_SEC           (1000000000LL)
+#define PREFLIGHT_START_NS     (10000000LL)    // lead time for every thread to reach its first sleep
+
+// One measurement thread
+typedef struct {
+  const char *name;
+  int cpu;
+  int policy;
+  int priority;
+  int64_t start_ns;                            // first wakeup, common to all threads
+  int64_t end_ns;
+  preflight_core_t *core;
+}preflight_thread_t;
+
+static pthread_t threads[PREFLIGHT_MAX_THREADS];
+static preflight_thread_t thread_args[PREFLIGHT_MAX_THREADS];
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void *measure(void *arg) {
+    preflight_thread_t *t = (preflight_thread_t *)arg;
+    struct timespec next;
+    int64_t next_ns;
+
+    for(next_ns = t->start_ns; next_ns < t->end_ns; next_ns += PREFLIGHT_INTERVAL_US * 1000LL) {
+        next.tv_sec = next_ns / NSEC_PER_SEC;
+        next.tv_nsec = next_ns % NSEC_PER_SEC;
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+        histogram_record(&t->core->hist, monotonic_ns() - next_ns);
+    }
+    return NULL;
+}
+
+static preflight_core_t *find_core(preflight_result_t *result, int cpu) {
+    preflight_core_t *core;
+    int i;
+
+    for(i = 0; i < result->ncores; i++) {
+        if(result->cores[i].cpu == cpu)
+            return &result->cores[i];
+    }
+    if(result->ncores == PREFLIGHT_MAX_CORES)
+        return NULL;
+    core = &result->cores[result->ncores++];
+    core->cpu = cpu;
+    core->threads = 0;
+    core->max_priority = 0;
+    histogram_reset(&core->hist);
+    return core;
+}
+
+static int add_thread(preflight_result_t *result, int *count, const char *name, int cpu,
+                      int policy, int priority) {
+    preflight_thread_t *t;
+    int i;
+
+    // a service listing one core twice is measured once there
+    for(i = 0; i < *count; i++) {
+        if((thread_args[i].name == name) && (thread_args[i].cpu == cpu))
+            return 0;
+    }
+    if(*count == PREFLIGHT_MAX_THREADS)
+        return -1;
+    t = &thread_args[(*count)++];
+    t->name = name;
+    t->cpu = cpu;
+    t->policy = policy;
+    t->priority = priority;
+    t->core = find_core(result, cpu);
+    if(t->core == NULL)
+        return -1;
+    t->core->threads++;
+    if(priority > t->core->max_priority)
+        t->core->max_priority = priority;
+    return 0;
+}
+
+// the budget follows the capture period, the shortest one if there is no capture service
+static int64_t derive_budget(const service_table_t *table) {
+    const service_desc_t *svc;
+    unsigned int period_us = 0;
+    int i;
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->period_us == 0)
+            continue;
+        if(strcmp(svc->name, "capture") == 0) {
+            period_us = svc->period_us;
+            break;
+        }
+        if((period_us == 0) || (svc->period_us < period_us))
+            period_us = svc->period_us;
+    }
+    return (int64_t)period_us * 1000LL * PREFLIGHT_BUDGET_PCT / 100;
+}
+
+int preflight_run(const service_table_t *table, int sequencer_core, int sequencer_priority,
+                  unsigned int duration_ms, preflight_result_t *result) {
+    const service_desc_t *svc;
+    preflight_thread_t *t;
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t threadcpu;
+    histogram_summary_t s;
+    int64_t start_ns;
+    int i, k, n, policy, priority, rc;
+    int count = 0, started;
+
+    result->ncores = 0;
+    result->worst_ns = 0;
+    result->worst_cpu = -1;
+    result->budget_ns = derive_budget(table);
+
+    if(add_thread(result, &count, "sequencer", sequencer_core, SCHED_FIFO, sequencer_priority) < 0)
+        return -1;
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->period_us == 0)
+            continue;
+        switch(svc->policy) {
+            case SERVICE_POLICY_FIFO:     policy = SCHED_FIFO;  priority = svc->effective_priority; break;
+            case SERVICE_POLICY_RR:       policy = SCHED_RR;    priority = svc->effective_priority; break;
+            case SERVICE_POLICY_DEADLINE: policy = SCHED_FIFO;  priority = sequencer_priority - 1;  break;
+            default:                      policy = SCHED_OTHER; priority = 0;                       break;
+        }
+        // every listed core of a single instance, one core per instance of a pool
+        n = (svc->instances == 1) ? svc->ncpus : svc->instances;
+        for(k = 0; k < n; k++) {
+            if(add_thread(result, &count, svc->name, svc->cpus[k % svc->ncpus], policy, priority) < 0) {
+                fprintf(stderr, "preflight: too many threads or cores to measure\n");
+                return -1;
+            }
+        }
+    }
+
+    printf("Preflight: measuring the wakeup latency of %d threads on %d cores for %u ms\n",
+           count, result->ncores, duration_ms);
+    fflush(stdout);
+
+    start_ns = monotonic_ns() + PREFLIGHT_START_NS;
+    for(started = 0; started < count; started++) {
+        t = &thread_args[started];
+        t->start_ns = start_ns;
+        t->end_ns = start_ns + (int64_t)duration_ms * 1000000LL;
+
+        CPU_ZERO(&threadcpu);
+        CPU_SET(t->cpu, &threadcpu);
+        rc=pthread_attr_init(&attr);
+        rc=pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        rc=pthread_attr_setschedpolicy(&attr, t->policy);
+        rc=pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &threadcpu);
+        param.sched_priority = t->priority;
+        pthread_attr_setschedparam(&attr, &param);
+        rc=pthread_create(&threads[started], &attr, measure, (void *)t);
+        pthread_attr_destroy(&attr);
+        if(rc != 0) {
+            fprintf(stderr, "preflight: pthread_create for %s on core %d: %s\n", t->name, t->cpu, strerror(rc));
+            break;
+        }
+    }
+    for(i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    if(started < count)
+        return -1;
+
+    for(i = 0; i < result->ncores; i++) {
+        histogram_summarize(&result->cores[i].hist, &s);
+        if((s.count > 0) && (s.max > result->worst_ns)) {
+            result->worst_ns = s.max;
+            result->worst_cpu = result->cores[i].cpu;
+        }
+    }
+    return (result->worst_ns > result->budget_ns) ? 1 : 0;
+}
+
+void preflight_report(const preflight_result_t *result) {
+    const preflight_core_t *core;
+    histogram_summary_t s;
+    int i;
+
+    printf("Preflight wakeup latency (us):\n");
+    printf("  %-5s %7s %5s %9s %9s %9s %9s %9s %9s\n", "core", "threads", "prio",
+           "count", "min", "p50", "p99", "p99.9", "max");
+    for(i = 0; i < result->ncores; i++) {
+        core = &result->cores[i];
+        histogram_summarize(&core->hist, &s);
+        printf("  %-5d %7d %5d %9llu %9.1f %9.1f %9.1f %9.1f %9.1f%s\n", core->cpu, core->threads,
+               core->max_priority, (unsigned long long)s.count, s.min / 1000.0, s.p50 / 1000.0,
+               s.p99 / 1000.0, s.p999 / 1000.0, s.max / 1000.0,
+               (s.max > result->budget_ns) ? "  over budget" : "");
+        syslog(LOG_INFO, "Preflight core %d: n=%llu p50=%lld p99=%lld p99.9=%lld max=%lld ns", core->cpu,
+               (unsigned long long)s.count, (long long)s.p50, (long long)s.p99, (long long)s.p999,
+               (long long)s.max);
+    }
+    printf("  worst case %.1f us on core %d, budget %.1f us (%d%% of the capture period): %s\n",
+           result->worst_ns / 1000.0, result->worst_cpu, result->budget_ns / 1000.0, PREFLIGHT_BUDGET_PCT,
+           (result->worst_ns > result->budget_ns) ? "EXCEEDED" : "ok");
+    syslog(LOG_INFO, "Preflight worst case %lld ns on core %d, budget %lld ns", (long long)result->worst_ns,
+           result->worst_cpu, (long long)result->budget_ns);
+    fflush(stdout);
+}
@@ -0,0 +1,205 @@
+/**
+*
+* This file contains the replay frame source. A recording is a directory of
+* frames written by this program (or any P6/P5 file of the capture size)
+* whose header comment carries the capture timestamp. Only the headers are
+* read at startup, a frame is read from disk when it is first shown and
+* kept until the timeline moves past it.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include "../includes/replay.h"
+#include "../includes/framecapture.h"
+
+// for logging
+#include <syslog.h>
+
+#define REPLAY_RGB_SIZE      (HRES * VRES * 3)
+
+// One recorded frame
+typedef struct {
+  char path[REPLAY_PATH_LENGTH];
+  long long offset_ns;                         // capture time since the first frame
+  long payload;                                // file offset of the pixels
+  bool gray;                                   // P5, expanded to RGB on read
+}replay_frame_t;
+
+static replay_frame_t *frames = NULL;
+static int nframes = 0;
+static struct timespec epoch;
+static unsigned char *rgb = NULL;             // frame shown last
+static unsigned char *gray = NULL;
+static int loaded = -1;                        // index of the frame in rgb
+
+static int frame_filter(const struct dirent *entry) {
+    size_t len = strlen(entry->d_name);
+
+    return (len > 4) && ((strcmp(entry->d_name + len - 4, ".ppm") == 0) ||
+                         (strcmp(entry->d_name + len - 4, ".pgm") == 0));
+}
+
+// parse the header of one frame, returns its capture time in ns
+static int parse_header(replay_frame_t *frame, long long *time_ns) {
+    char line[256];
+    long sec = -1, msec = -1;
+    int width, height, maxval, fields = 0;
+    FILE *fp;
+
+    fp = fopen(frame->path, "r");
+    if(fp == NULL)
+        return -1;
+
+    if(fgets(line, sizeof(line), fp) == NULL || (strncmp(line, "P6", 2) != 0 && strncmp(line, "P5", 2) != 0)) {
+        fclose(fp);
+        return -1;
+    }
+    frame->gray = (line[1] == '5');
+
+    // comments carry the timestamp, the size fields follow
+    while(fields == 0 && fgets(line, sizeof(line), fp) != NULL) {
+        if(line[0] == '#') {
+            if(sec < 0)
+                sscanf(line, "#%ld sec %ld msec", &sec, &msec);
+            continue;
+        }
+        fields = sscanf(line, "%d %d", &width, &height);
+    }
+    if(fields != 2 || fscanf(fp, "%d", &maxval) != 1 || fgetc(fp) == EOF ||
+       width != HRES || height != VRES || maxval != 255 || sec < 0 || msec < 0) {
+        fclose(fp);
+        return -1;
+    }
+    frame->payload = ftell(fp);
+    fclose(fp);
+
+    *time_ns = sec * 1000000000LL + msec * 1000000LL;
+    return 0;
+}
+
+int replay_open(const char *dir) {
+    struct dirent **names;
+    long long time_ns, first_ns = 0;
+    int count, i;
+
+    count = scandir(dir, &names, frame_filter, alphasort);
+    if(count < 0) {
+        fprintf(stderr, "Replay: cannot read '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+    if(count > REPLAY_MAX_FRAMES)
+        count = REPLAY_MAX_FRAMES;
+
+    frames = (replay_frame_t *)calloc(count ? count : 1, sizeof(replay_frame_t));
+    rgb = (unsigned char *)malloc(REPLAY_RGB_SIZE);
+    gray = (unsigned char *)malloc(HRES * VRES);
+    if(frames == NULL || rgb == NULL || gray == NULL) {
+        fprintf(stderr, "Replay: out of memory\n");
+        return -1;
+    }
+
+    nframes = 0;
+    for(i = 0; i < count; i++) {
+        snprintf(frames[nframes].path, REPLAY_PATH_LENGTH, "%s/%s", dir, names[i]->d_name);
+        if(parse_header(&frames[nframes], &time_ns) < 0) {
+            fprintf(stderr, "Replay: skipping %s, not a %dx%d frame with a timestamp\n",
+                    frames[nframes].path, HRES, VRES);
+        } else {
+            if(nframes == 0)
+                first_ns = time_ns;
+            // a timeline running backwards would hide frames, keep it monotonic
+            frames[nframes].offset_ns = time_ns - first_ns;
+            if(nframes > 0 && frames[nframes].offset_ns < frames[nframes - 1].offset_ns)
+                frames[nframes].offset_ns = frames[nframes - 1].offset_ns;
+            nframes++;
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    if(nframes == 0) {
+        fprintf(stderr, "Replay: no frames in '%s'\n", dir);
+        return -1;
+    }
+    epoch.tv_sec = first_ns / 1000000000LL;
+    epoch.tv_nsec = first_ns % 1000000000LL;
+
+    printf("Replay: %d frames from %s spanning %.3f sec\n", nframes, dir,
+           frames[nframes - 1].offset_ns / 1e9);
+    syslog(LOG_INFO, "Replay: %d frames from %s", nframes, dir);
+    return nframes;
+}
+
+bool replay_active(void) {
+    return nframes > 0;
+}
+
+void replay_epoch(struct timespec *start) {
+    *start = epoch;
+}
+
+static int load_frame(int index) {
+    FILE *fp;
+    size_t size = frames[index].gray ? (HRES * VRES) : REPLAY_RGB_SIZE;
+    unsigned char *dst = frames[index].gray ? gray : rgb;
+    int pix;
+
+    fp = fopen(frames[index].path, "r");
+    if(fp == NULL)
+        return -1;
+    if(fseek(fp, frames[index].payload, SEEK_SET) < 0 || fread(dst, 1, size, fp) != size) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if(frames[index].gray) {
+        for(pix = 0; pix < HRES * VRES; pix++)
+            rgb[3 * pix] = rgb[3 * pix + 1] = rgb[3 * pix + 2] = gray[pix];
+    }
+    loaded = index;
+    return 0;
+}
+
+const unsigned char *replay_frame_at(long long offset_ns) {
+    int low = 0, high = nframes - 1, mid;
+
+    // last frame recorded at or before the offset
+    while(low < high) {
+        mid = (low + high + 1) / 2;
+        if(frames[mid].offset_ns <= offset_ns)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    if(low != loaded && load_frame(low) < 0) {
+        fprintf(stderr, "Replay: cannot read %s\n", frames[low].path);
+        return NULL;
+    }
+    return rgb;
+}
+
+bool replay_ended(long long offset_ns) {
+    return (nframes > 0) && (offset_ns > frames[nframes - 1].offset_ns);
+}
+
+void replay_close(void) {
+    free(frames);
+    free(rgb);
+    free(gray);
+    frames = NULL;
+    rgb = gray = NULL;
+    nframes = 0;
+    loaded = -1;
+}
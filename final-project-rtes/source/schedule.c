@@ -0,0 +1,98 @@
+/**
+*
+* This file contains the helper functions for building the static
+* cyclic-executive release table of the sequencer. The minor frame is the
+* greatest common divisor of the service periods and the table spans one
+* hyperperiod (their least common multiple). Only minor frames that release
+* at least one service get an entry, so the sequencer never wakes up for an
+* empty tick.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../includes/schedule.h"
+
+// for logging
+#include <syslog.h>
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b) {
+    unsigned long long t;
+
+    while(b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int schedule_build(schedule_t *sched, const schedule_service_t *services, int nservices) {
+    int i;
+    unsigned long long t, divisor;
+    unsigned int mask;
+
+    if((nservices < 1) || (nservices > SCHEDULE_MAX_SERVICES))
+        return -1;
+
+    memset(sched, 0, sizeof(schedule_t));
+    sched->nservices = nservices;
+    memcpy(sched->services, services, nservices * sizeof(schedule_service_t));
+
+    sched->minor_frame_us = services[0].period_us;
+    sched->hyperperiod_us = services[0].period_us;
+    for(i = 0; i < nservices; i++) {
+        if(services[i].period_us == 0) {
+            fprintf(stderr, "Schedule: service %s has no period\n", services[i].name);
+            return -1;
+        }
+        sched->minor_frame_us = gcd(sched->minor_frame_us, services[i].period_us);
+        divisor = gcd(sched->hyperperiod_us, services[i].period_us);
+        sched->hyperperiod_us = (sched->hyperperiod_us / divisor) * services[i].period_us;
+    }
+
+    // walk the minor frames of one hyperperiod and keep the releasing ones
+    for(t = sched->minor_frame_us; t <= sched->hyperperiod_us; t += sched->minor_frame_us) {
+        mask = 0;
+        for(i = 0; i < nservices; i++) {
+            if((t % services[i].period_us) == 0)
+                mask |= (1U << i);
+        }
+        if(mask == 0)
+            continue;
+        if(sched->nentries == SCHEDULE_MAX_ENTRIES) {
+            fprintf(stderr, "Schedule: hyperperiod %llu us needs more than %d release points\n",
+                    sched->hyperperiod_us, SCHEDULE_MAX_ENTRIES);
+            return -1;
+        }
+        sched->entries[sched->nentries].offset_us = t;
+        sched->entries[sched->nentries].release_mask = mask;
+        sched->nentries++;
+    }
+
+    return 0;
+}
+
+void schedule_print(const schedule_t *sched) {
+    int i, j;
+
+    printf("Schedule: minor frame %u us, hyperperiod %llu us, %d release points for %llu minor frames\n",
+           sched->minor_frame_us, sched->hyperperiod_us, sched->nentries,
+           sched->hyperperiod_us / sched->minor_frame_us);
+    syslog(LOG_INFO, "Schedule: minor frame %u us, hyperperiod %llu us, %d release points",
+           sched->minor_frame_us, sched->hyperperiod_us, sched->nentries);
+
+    for(i = 0; i < sched->nentries; i++) {
+        printf("  @%8llu us:", sched->entries[i].offset_us);
+        for(j = 0; j < sched->nservices; j++) {
+            if(sched->entries[i].release_mask & (1U << j))
+                printf(" %s", sched->services[j].name);
+        }
+        printf("\n");
+    }
+}
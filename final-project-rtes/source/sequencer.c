@@ -109,17 +109,24 @@
 #include "../includes/framecapture.h"
 #include "../includes/writeback.h"
 #include "../includes/differencing.h"
+#include "../includes/schedule.h"
+#include "../includes/timesource.h"
+#include "../includes/replay.h"
+#include "../includes/trace.h"
 
 int abortTest=FALSE;
 int abortS1=FALSE, abortS2=FALSE, \
     abortS3=FALSE, abortS4=FALSE;
 
-extern sem_t semS1, semS2, semS3, semS4;
 double start_realtime;
 
 extern unsigned long long sequencePeriods;
-extern timer_t timer_1;
+extern service_table_t service_table;          // declared in main
+extern char *dev_name;                         // capture device, declared in main
+extern sem_t analysis_due;                     // RM analysis request, declared in main
 static unsigned long long seqCnt=0;
+static sequencer_stats_t seq_stats;
+static bool recording_ended = false;           // a replay ran past its last frame, set by the capture
 
 int delta_t(struct timespec *stop, struct timespec *start, struct timespec *delta_t) {
   int dt_sec=stop->tv_sec - start->tv_sec;
@@ -168,101 +175,367 @@ int delta_t(struct timespec *stop, struct timespec *start, struct timespec *delt
 //
 // "sudo apt-get install adjtimex" for an interesting utility to adjust your system clock
 
-void Sequencer(int id) {
-    struct timespec current_time_val;
-    double current_realtime;
-    struct itimerspec itime;
-    struct itimerspec last_itime;
-    int rc, flags=0;
-
-    seqCnt++;
-
-    //clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
-    // printf("Sequencer on core %d for cycle %llu @ sec=%6.9lf\n", 
-    //                                 sched_getcpu(), seqCnt, current_realtime-start_realtime);
-    // syslog(LOG_CRIT, "Sequencer on core %d for cycle %llu @ sec=%6.9lf\n", 
-    //                                 sched_getcpu(), seqCnt, current_realtime-start_realtime);
-
-    // Release each service at a sub-rate of the generic sequencer rate
-    // Servcie_1 = RT_MAX-1	@ 33 Hz
-    if((seqCnt % 3) == 0) sem_post(&semS1);
-
-    // Service_2 = RT_MAX-2	@ 20 Hz
-    if((seqCnt % 5) == 0) sem_post(&semS2);
-
-    // Service_3 = RT_MAX-3	@ 1 Hz
-    //if((seqCnt % 100) == 0) sem_post(&semS3);
-    // Service_3 = RT_MAX-3	@ 10 Hz
-    if((seqCnt % 10) == 0) sem_post(&semS3);
-    
-    if(abortTest || (sequencePeriods >= FRAME_CAPTURE_COUNT)) {
-        // disable interval timer
-        itime.it_interval.tv_sec = 0;
-        itime.it_interval.tv_nsec = 0;
-        itime.it_value.tv_sec = 0;
-        itime.it_value.tv_nsec = 0;
-
-        timer_settime(timer_1, flags, &itime, &last_itime);
-	    printf("Disabling sequencer interval timer with abort=%d and %llu of %lld\n", 
-                                                   abortTest, seqCnt, sequencePeriods);
-
-	    // shutdown all services
-        sem_post(&semS1); sem_post(&semS2); 
-        sem_post(&semS3); sem_post(&semS4);
-
-        abortS1=TRUE; abortS2=TRUE; 
-        abortS3=TRUE; abortS4=TRUE;
+static void timespec_add_ns(struct timespec *ts, long long ns) {
+    ts->tv_nsec += ns % (long long)NANOSEC_PER_SEC;
+    ts->tv_sec  += ns / (long long)NANOSEC_PER_SEC;
+    if(ts->tv_nsec >= NANOSEC_PER_SEC) {
+        ts->tv_nsec -= NANOSEC_PER_SEC;
+        ts->tv_sec++;
+    }
+}
+
+static long long timespec_diff_ns(struct timespec *stop, struct timespec *start) {
+    return ((long long)(stop->tv_sec - start->tv_sec) * (long long)NANOSEC_PER_SEC) +
+           (stop->tv_nsec - start->tv_nsec);
+}
+
+void get_sequencer_stats(sequencer_stats_t *stats) {
+    memcpy(stats, &seq_stats, sizeof(sequencer_stats_t));
+}
+
+// release one periodic service now, as the table walk does at a release point
+static void free_run_release(service_desc_t *svc, sem_t *release, int index) {
+    struct timespec now;
+
+    // same clock as the table walk, service_job_start() measures against it
+    timesource_sequencer_time(&now);
+    trace_event(TRACE_SEM_POST, __atomic_load_n(&svc->trace_ring, __ATOMIC_ACQUIRE), index, 0);
+    __atomic_store_n(&svc->release_ns, (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec, __ATOMIC_RELAXED);
+    sem_post(release);
+}
+
+// CPU time of every service against the length of the free run, and the
+// stage that used up its thread first
+static void free_run_report(int64_t elapsed_ns, const unsigned long long *held, service_desc_t **posted, int nposted) {
+    service_exec_summary_t summary;
+    writeback_stats_t wb;
+    const service_desc_t *svc, *bottleneck = NULL;
+    double seconds = elapsed_ns / NANOSEC_PER_SEC;
+    double cpu_ns, share, thread_share, max_share = 0.0, nominal_fps = 0.0;
+    double core_ns[CPU_SETSIZE] = { 0.0 };
+    unsigned long long captured = get_cbuf_frames();
+    int i, k, held_index;
+
+    writeback_get_stats(&wb);
+    for(i = 0; i < service_table.count; i++)
+        if(strcmp(service_table.services[i].name, "capture") == 0 && service_table.services[i].period_us > 0)
+            nominal_fps = 1000000.0 / service_table.services[i].period_us;
+
+    printf("\nFree run: %llu frames captured, %llu written in %.3f s\n", captured, wb.committed, seconds);
+    printf("  capture %.1f fps", captured / seconds);
+    if(nominal_fps > 0.0)
+        printf(" (%.2fx the %.1f fps of the capture period)", (captured / seconds) / nominal_fps, nominal_fps);
+    printf(", written %.1f fps, %llu dropped\n", wb.committed / seconds, wb.dropped);
+    printf("  %-16s %9s %10s %9s %9s %9s\n", "service", "jobs", "cpu ms", "cpu", "per thread", "held");
+
+    for(i = 0; i < service_table.count; i++) {
+        svc = &service_table.services[i];
+        services_exec_summary(svc, &summary);
+        cpu_ns = (double)summary.avg_ns * summary.jobs;
+        share = cpu_ns / elapsed_ns;
+        thread_share = share / svc->instances;
+        for(k = 0; k < svc->instances; k++)
+            core_ns[svc->cpus[k % svc->ncpus]] += cpu_ns / svc->instances;
+        if(thread_share > max_share) {
+            max_share = thread_share;
+            bottleneck = svc;
+        }
+
+        held_index = -1;
+        for(k = 0; k < nposted; k++)
+            if(posted[k] == svc)
+                held_index = k;
+        printf("  %-16s %9llu %10.1f %8.1f%% %8.1f%% ", svc->name, summary.jobs, cpu_ns / NANOSEC_PER_MSEC,
+               100.0 * share, 100.0 * thread_share);
+        if(held_index >= 0)
+            printf("%9llu\n", held[held_index]);
+        else
+            printf("%9s\n", "-");
+        syslog(LOG_INFO, "Free run %s: jobs=%llu cpu=%.1f ms share=%.1f%%", svc->name, summary.jobs,
+               cpu_ns / NANOSEC_PER_MSEC, 100.0 * share);
+    }
+    for(i = 0; i < CPU_SETSIZE; i++)
+        if(core_ns[i] > 0.0)
+            printf("  core %d busy %.1f%%\n", i, 100.0 * core_ns[i] / elapsed_ns);
+    if(bottleneck != NULL)
+        printf("  saturates first: %s, %.1f%% of its thread\n", bottleneck->name, 100.0 * max_share);
+    syslog(LOG_INFO, "Free run: %llu captured, %llu written in %.3f s, %.1f fps, saturates first: %s",
+           captured, wb.committed, seconds, captured / seconds, (bottleneck != NULL) ? bottleneck->name : "-");
+}
+
+// Free run: instead of sleeping to the release points, every periodic
+// service walks its own releases as fast as it can. The k-th release of a
+// service stands for time k * period of the recording, and it is only
+// released once its last release is finished with and the service before
+// it in the table has finished every release up to that time. The
+// capture stays at most FREE_RUN_MAX_LEAD frames ahead of the last service
+// and the last service waits for room in the writeback queue, so no frame
+// is overwritten or dropped and the pipeline runs at the pace of its
+// slowest stage. Should the frame buffer pointers still wedge with the
+// capture held, nothing progresses for TIMESOURCE_PROGRESS_POLL_MS and the
+// capture is released anyway.
+//
+// This orders the stages but not the jobs of one release point against
+// each other, and the stall escape moves the capture ahead of the rest, so
+// the selected frames are not those of a paced run or of --sim. A free run
+// measures throughput, not the output.
+static void free_run(schedule_t *sched, service_desc_t **posted) {
+    unsigned long long released[SCHEDULE_MAX_SERVICES] = { 0 };
+    unsigned long long held[SCHEDULE_MAX_SERVICES] = { 0 };
+    unsigned long long progress, upstream_us, last_us, forced = 0;
+    writeback_stats_t wb;
+    int64_t start_ns;
+    bool room, stalled = false;
+    int i, last = sched->nservices - 1;
+
+    printf("Free run: releasing every service as soon as it is ready\n");
+    syslog(LOG_INFO, "Free run: releasing every service as soon as it is ready");
+    start_ns = trace_now();
+
+    while(!abortTest && (sequencePeriods < FRAME_CAPTURE_COUNT)) {
+        progress = timesource_progress();
+
+        // past the end of the recording nothing new is captured, the run
+        // ends once the frames already captured stopped moving
+        if(__atomic_load_n(&recording_ended, __ATOMIC_ACQUIRE) && stalled)
+            break;
+
+        // every frame of the run is selected, only the writeback is left
+        writeback_get_stats(&wb);
+        for(i = 0; (wb.queued < FRAME_CAPTURE_COUNT) && (i < sched->nservices); i++) {
+            if(__atomic_load_n(&posted[i]->completed, __ATOMIC_ACQUIRE) != released[i])
+                continue;                               // still busy with its last release
+            if(i > 0) {
+                upstream_us = __atomic_load_n(&posted[i - 1]->completed, __ATOMIC_ACQUIRE) * posted[i - 1]->period_us;
+                if(upstream_us < (released[i] + 1) * posted[i]->period_us)
+                    continue;                           // its input is not there yet
+            }
+
+            room = true;
+            if((i == 0) && __atomic_load_n(&recording_ended, __ATOMIC_ACQUIRE))
+                continue;                               // the recording is over
+            if(i == 0) {
+                last_us = __atomic_load_n(&posted[last]->completed, __ATOMIC_ACQUIRE) * posted[last]->period_us;
+                room = (released[0] + 1) * posted[0]->period_us <= last_us + FREE_RUN_MAX_LEAD * posted[0]->period_us;
+                if(!room && stalled) {
+                    room = true;
+                    forced++;
+                }
+            }
+            if(i == last) {
+                writeback_get_stats(&wb);
+                room = room && (wb.fifo_depth < MAX_FIFO_DEPTH);
+            }
+            if(!room) {
+                held[i]++;
+                continue;
+            }
+
+            released[i]++;
+            seqCnt++;
+            free_run_release(posted[i], sched->services[i].release, i);
+        }
+        timesource_wait_progress(progress);
+        stalled = (timesource_progress() == progress);
+    }
+
+    free_run_report(trace_now() - start_ns, held, posted, sched->nservices);
+    if(forced > 0)
+        printf("  capture released %llu times with the pipeline stalled\n", forced);
+}
+
+// Sequencer thread. Walks the static release table built by
+// schedule_build() and sleeps to the absolute time of the next release
+// point on CLOCK_MONOTONIC, so it only wakes up on ticks that release a
+// service and neither signal delivery nor wall clock steps move them.
+void *Sequencer(void *threadp) {
+    schedule_t *sched = (schedule_t *)threadp;
+    struct timespec cycle_start, next_release, following, now;
+    long long lateness_ns;
+    unsigned long long since_analysis_us = 0;
+    service_desc_t *posted[SCHEDULE_MAX_SERVICES];
+    int rc, i, entry = 0, cycles_ended = 0;
+
+    printf("Sequencer thread running on CPU=%d\n", sched_getcpu());
+    syslog(LOG_INFO, "Sequencer thread running on CPU=%d", sched_getcpu());
+    trace_register("sequencer", 0);
+    for(i = 0; i < sched->nservices; i++)
+        posted[i] = services_find(&service_table, sched->services[i].name);
+
+    memset(&seq_stats, 0, sizeof(seq_stats));
+    seq_stats.min_lateness_ns = LLONG_MAX;
+
+    timesource_sequencer_time(&cycle_start);
+
+    // a free run releases on readiness, the table is not walked
+    if(timesource_is_free_run())
+        free_run(sched, posted);
+
+    while(!timesource_is_free_run()) {
+        next_release = cycle_start;
+        timespec_add_ns(&next_release, sched->entries[entry].offset_us * 1000LL);
+        do {
+            rc = timesource_sleep_until(&next_release);
+        } while(rc == EINTR);
+
+        timesource_sequencer_time(&now);
+
+        // a wakeup past the following release point has missed this one,
+        // skip it instead of releasing a burst to catch up
+        while(1) {
+            following = cycle_start;
+            if(entry + 1 < sched->nentries)
+                timespec_add_ns(&following, sched->entries[entry + 1].offset_us * 1000LL);
+            else
+                timespec_add_ns(&following, (sched->hyperperiod_us + sched->entries[0].offset_us) * 1000LL);
+            if(timespec_diff_ns(&now, &following) < 0)
+                break;
+            seq_stats.overruns++;
+            if(++entry == sched->nentries) {
+                entry = 0;
+                timespec_add_ns(&cycle_start, sched->hyperperiod_us * 1000LL);
+            }
+            next_release = following;
+        }
+        lateness_ns = timespec_diff_ns(&now, &next_release);
+
+        seqCnt++;
+        seq_stats.ticks++;
+        seq_stats.sum_lateness_ns += lateness_ns;
+        if(lateness_ns > seq_stats.max_lateness_ns) seq_stats.max_lateness_ns = lateness_ns;
+        if(lateness_ns < seq_stats.min_lateness_ns) seq_stats.min_lateness_ns = lateness_ns;
+        trace_event(TRACE_SEQ_RELEASE, entry, lateness_ns, sched->entries[entry].release_mask);
+
+        // Release the services of this point of the table. In virtual time
+        // they run one after the other in table (rate monotonic) order, so
+        // which frames a service sees never depends on thread timing.
+        for(i = 0; i < sched->nservices; i++) {
+            if(sched->entries[entry].release_mask & (1U << i)) {
+                if((posted[i]->entry == Service_1) && __atomic_load_n(&recording_ended, __ATOMIC_ACQUIRE))
+                    continue;                           // the recording is over
+                timesource_job_released();
+                trace_event(TRACE_SEM_POST, __atomic_load_n(&posted[i]->trace_ring, __ATOMIC_ACQUIRE), i, 0);
+                __atomic_store_n(&posted[i]->release_ns,
+                                 (int64_t)next_release.tv_sec * 1000000000LL + next_release.tv_nsec, __ATOMIC_RELAXED);
+                sem_post(sched->services[i].release);
+                timesource_wait_idle();
+            }
+        }
+
+        if(++entry == sched->nentries) {
+            entry = 0;
+            timespec_add_ns(&cycle_start, sched->hyperperiod_us * 1000LL);
+
+            // after the recording ended, one more hyperperiod releases every
+            // other service at least once, which takes the last captured
+            // frames through differencing and selection
+            if(__atomic_load_n(&recording_ended, __ATOMIC_ACQUIRE) && (cycles_ended++ > 0))
+                break;
+
+            // ask for a re-check of the schedule with the execution times
+            // measured so far, the analysis thread in main runs it
+            since_analysis_us += sched->hyperperiod_us;
+            if(since_analysis_us >= SEQUENCER_ANALYSIS_US) {
+                since_analysis_us = 0;
+                sem_post(&analysis_due);
+            }
+        }
+
+        if(abortTest || (sequencePeriods >= FRAME_CAPTURE_COUNT))
+            break;
+    }
+
+    if(__atomic_load_n(&recording_ended, __ATOMIC_ACQUIRE)) {
+        // the selected frames still queued are written before the workers stop
+        while(!abortTest && (writeback_pending() > 0))
+            usleep(1000);
+        printf("Replay: the recording ended, stopping with %llu of %d frames written\n",
+               __atomic_load_n(&sequencePeriods, __ATOMIC_RELAXED), FRAME_CAPTURE_COUNT);
+        syslog(LOG_INFO, "Replay: the recording ended, %llu of %d frames written",
+               __atomic_load_n(&sequencePeriods, __ATOMIC_RELAXED), FRAME_CAPTURE_COUNT);
     }
 
+    printf("Stopping sequencer with abort=%d and %llu of %lld\n", 
+                                           abortTest, seqCnt, sequencePeriods);
+
+    abortS1=TRUE; abortS2=TRUE; 
+    abortS3=TRUE; abortS4=TRUE;
+
+    // shutdown all services
+    for(i = 0; i < sched->nservices; i++)
+        sem_post(sched->services[i].release);
+    stop_writeback_pool();
+
+    // a free run has no release points to be late for
+    if(!timesource_is_free_run()) {
+        printf("Sequencer: %llu wakeups, %llu skipped release points, lateness min=%lld avg=%lld max=%lld nsec\n",
+               seq_stats.ticks, seq_stats.overruns, seq_stats.min_lateness_ns,
+               seq_stats.ticks ? (seq_stats.sum_lateness_ns / (long long)seq_stats.ticks) : 0,
+               seq_stats.max_lateness_ns);
+        syslog(LOG_INFO, "Sequencer: %llu wakeups, %llu skipped release points, max lateness %lld nsec",
+               seq_stats.ticks, seq_stats.overruns, seq_stats.max_lateness_ns);
+    }
+
+    pthread_exit((void *)0);
 }
 
 void *Service_1(void *threadp) {
     struct timespec current_time_val;
     double current_realtime;
     unsigned long long S1Cnt=0;
-    struct timespec prev_time, delay_time;
+    long long offset_ns;
     threadParams_t *threadParams = (threadParams_t *)threadp;
 
     int fd = -1;                                      // file descriptor 
-    char *dev_name = DEFAULT_VIDEO_DEVICE;            // device name place holder
 
     printf("S1 33Hz thread running on CPU=%d\n", sched_getcpu());
     syslog(LOG_INFO, "S1 33Hz thread running on CPU=%d", sched_getcpu());
 
     // Start up processing and resource initialization
-    clock_gettime(MY_CLOCK, &current_time_val); current_realtime=realtime(&current_time_val);
+    timesource_gettime(&current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S1 33Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S1 33Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    // initialization of V4L2
-    fd = open_device(dev_name);
-    init_device(fd, dev_name);
-    start_capturing(fd);
+    // initialization of V4L2, unless frames are replayed from a recording
+    if(!replay_active()) {
+        fd = open_device(dev_name);
+        init_device(fd, dev_name);
+        start_capturing(fd);
+    }
 
     while(!abortS1) { // check for synchronous abort request
 
 	    // wait for service request from the sequencer, a signal handler or ISR in kernel
-        sem_wait(&semS1);
+        sem_wait(&threadParams->svc->release);
+        if(abortS1)
+            break;                                      // woken up for shutdown, not a release
+        if(!service_job_start(threadParams))
+            continue;                                   // release decimated under overload
         S1Cnt++;
         
         //print_cbuf_info();
-	    read_frames(fd, threadParams->global_cbuf);                                             // capture frame
-        
-	    // on order of up to milliseconds of latency to get time
-        clock_gettime(MY_CLOCK, &current_time_val);     
-        current_realtime=realtime(&current_time_val);
-        delta_t(&current_time_val, &prev_time, &delay_time);        // calculate capture time
-        syslog(LOG_INFO, "S1 33Hz on core %d for release %llu @ sec=%6.9lf frameRate=%f\n", 
-                                            sched_getcpu(), S1Cnt, current_realtime-start_realtime,
-                                            (1.0/((double)(delay_time.tv_sec) + ((double)(delay_time.tv_nsec) / NANOSEC_PER_SEC))));       
-        prev_time.tv_nsec = current_time_val.tv_nsec;
-        prev_time.tv_sec = current_time_val.tv_sec;                             
+        // a recording advances with the releases, also the ones skipped under
+        // overload, and ends with its last frame instead of repeating it
+        if(replay_active()) {
+            offset_ns = (long long)(threadParams->svc->overload_stats.releases +
+                                    threadParams->svc->overload_stats.skipped) *
+                        threadParams->svc->period_us * 1000LL;
+            if(replay_ended(offset_ns))
+                __atomic_store_n(&recording_ended, true, __ATOMIC_RELEASE);
+            else
+                read_replay_frame(threadParams->global_cbuf, offset_ns);
+        } else
+	        read_frames(fd, threadParams->global_cbuf);                                         // capture frame
+        service_job_end(threadParams);
+        // the release, core and frame rate are in the job events of the trace
     }
 
     // shutdown of frame acquisition service
-    stop_capturing(fd);
-    uninit_device();
-    close_device(fd);
+    if(!replay_active()) {
+        stop_capturing(fd);
+        uninit_device();
+        close_device(fd);
+    }
 
     printf("Sequence counts for service 1: %d\n", S1Cnt);
     // Resource shutdown here
@@ -279,22 +552,26 @@ void *Service_2(void *threadp) {
     printf("S2 20Hz thread running on CPU=%d\n", sched_getcpu());
     syslog(LOG_INFO, "S2 20Hz thread running on CPU=%d", sched_getcpu());
 
-    clock_gettime(MY_CLOCK, &current_time_val); current_realtime=realtime(&current_time_val);
+    timesource_gettime(&current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S2 20Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S2 20Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
     while(!abortS2) {
-        sem_wait(&semS2);
+        sem_wait(&threadParams->svc->release);
+        if(abortS2)
+            break;                                      // woken up for shutdown, not a release
+        if(!service_job_start(threadParams))
+            continue;                                   // release decimated under overload
         S2Cnt++;
         
         //print_cbuf_info();
+        set_diff_stride(1 << service_degrade_level(threadParams));   // sampled diff when shedding
         ret = differencing(threadParams->global_cbuf);
+        // before the job ends, in virtual time the clock moves on with it
+        trace_event(TRACE_DIFF_DONE, ret, 1 << service_degrade_level(threadParams), 0);
+        service_job_end(threadParams);
 
         //printf("Frames serviced in differencing %d\n", ret);
-        syslog(LOG_INFO, "Frames serviced in differencing %d\n", ret);
-        clock_gettime(MY_CLOCK, &current_time_val);    current_realtime=realtime(&current_time_val);
-        syslog(LOG_CRIT, "S2 20 Hz on core %d for release %llu @ sec=%6.9lf\n", 
-                                                        sched_getcpu(), S2Cnt, current_realtime-start_realtime);
     }
     printf("Sequence counts for service 2: %d\n", S2Cnt);
     pthread_exit((void *)0);
@@ -310,34 +587,25 @@ void *Service_3(void *threadp) {
     printf("S3 1Hz thread running on CPU=%d\n", sched_getcpu());
     syslog(LOG_INFO, "S3 1Hz thread running on CPU=%d", sched_getcpu());
 
-    clock_gettime(MY_CLOCK, &current_time_val); current_realtime=realtime(&current_time_val);
+    timesource_gettime(&current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S3 1Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S3 1Hz thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
     //init_fifoQ();
 
     while(!abortS3) {
-        sem_wait(&semS3);
+        sem_wait(&threadParams->svc->release);
+        if(abortS3)
+            break;                                      // woken up for shutdown, not a release
+        if(!service_job_start(threadParams))
+            continue;                                   // release decimated under overload
         S3Cnt++;
 
+        set_selection_divider(1 << service_degrade_level(threadParams));
         ret = frame_select(threadParams->global_cbuf);
-        if(ret==-1) {
-            printf("Frame select: first_capture not triggered\n");
-            syslog(LOG_INFO, "Frame select: first_capture not triggered\n");
-        }
-        if(ret==0) {
-            printf("Frame select: No valid frame selected ");
-            print_cbuf_info();
-            syslog(LOG_INFO, "Frame select: No valid frame selected\n");
-        }
-        if(ret>0) {
-            printf("Frame select: Valid frames found - %d\n", ret);
-            syslog(LOG_INFO, "Frame select: Valid frames found - %d\n", ret);
-        }
-
-        clock_gettime(MY_CLOCK, &current_time_val);     current_realtime=realtime(&current_time_val);
-        syslog(LOG_CRIT, "S3 10 Hz on core %d for release %llu @ sec=%6.9lf\n", 
-                                                        sched_getcpu(), S3Cnt, current_realtime-start_realtime);
+        // the outcome is in the trace, nothing is printed at RT priority
+        trace_event(TRACE_SELECT_DONE, ret, 1 << service_degrade_level(threadParams), 0);
+        service_job_end(threadParams);
     }
     printf("Sequence counts for service 3: %d\n", S3Cnt);
     pthread_exit((void *)0);
@@ -350,23 +618,25 @@ void *Service_4(void *threadp) {
     unsigned long long S4Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
 
-    printf("S4 best effort thread running on CPU=%d\n", sched_getcpu());
+    printf("S4 best effort worker %d running on CPU=%d\n", threadParams->instance, sched_getcpu());
     syslog(LOG_INFO, "S4 best effort thread running on CPU=%d", sched_getcpu());
 
-    clock_gettime(MY_CLOCK, &current_time_val); current_realtime=realtime(&current_time_val);
+    timesource_gettime(&current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S4 best effort thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S4 best effor thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
     while(!abortS4) {
-        //sem_wait(&semS4);
         S4Cnt++;
+        // CPU time, the wait for a frame inside writeback() is not counted
+        service_job_start(threadParams);
         ret = writeback();
-        if(ret > -1) {
+        service_job_end(threadParams);
+        if(ret > 0) {
             //printf("Write-back: %d frame written to memory\n", ret);
-            syslog(LOG_INFO, "Write-back: %d frame written to memory\n", ret);
-            sequencePeriods += ret;
+            // frames are committed by whichever worker completes the order
+            __atomic_fetch_add(&sequencePeriods, ret, __ATOMIC_RELAXED);
         }
-        //clock_gettime(MY_CLOCK, &current_time_val);     current_realtime=realtime(&current_time_val);
+        //timesource_gettime(&current_time_val);     current_realtime=realtime(&current_time_val);
         //syslog(LOG_CRIT, "S4 best effort on core %d for release %llu @ sec=%6.9lf\n", 
                                                         //sched_getcpu(), S4Cnt, current_realtime-start_realtime);
     }
@@ -377,7 +647,7 @@ void *Service_4(void *threadp) {
 double getTimeMsec(void) {
   struct timespec event_ts = {0, 0};
 
-  clock_gettime(MY_CLOCK, &event_ts);
+  timesource_gettime(&event_ts);
   return ((event_ts.tv_sec)*1000.0) + ((event_ts.tv_nsec)/1000000.0);
 }
 
@@ -0,0 +1,1008 @@
+/**
+*
+* This file contains the service descriptor table and the generic launcher.
+* Every service of the pipeline is described by its entry function, release
+* period, priority, scheduling policy and CPU affinity. The defaults are set
+* in main.c and can be overridden from a config file or the command line,
+* so thread placement can be tuned per board without recompiling.
+*
+* Under SCHED_DEADLINE the policy cannot be set through the pthread
+* attributes, so every deadline thread starts under SCHED_OTHER and applies
+* its runtime/deadline/period reservation itself before running the service.
+* The launcher waits for all of them, so the kernel's admission control
+* result is known before the sequencer starts.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include "../includes/services.h"
+#include "../includes/timesource.h"
+#include "../includes/trace.h"
+
+// for logging
+#include <syslog.h>
+
+#define SERVICE_MAX_THREADS   (SERVICE_MAX * SERVICE_MAX_INSTANCES)
+#define SERVICE_LINE_LENGTH   (256)
+
+static pthread_t threads[SERVICE_MAX_THREADS];
+static threadParams_t threadParams[SERVICE_MAX_THREADS];
+static int thread_count = 0;
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE        (6)
+#endif
+
+#define SERVICE_DL_MIN_RUNTIME_US   (2)        // the kernel rejects runtimes below 1024 ns
+
+// layout of the kernel's struct sched_attr, glibc has no wrapper for it
+typedef struct {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;                    // ns
+    uint64_t sched_deadline;                   // ns
+    uint64_t sched_period;                     // ns
+}service_sched_attr_t;
+
+static sem_t admission_done;                   // posted once by every deadline thread
+
+static const char *policy_names[] = { "fifo", "rr", "other", "deadline" };
+static const char *overload_names[] = { "none", "skip", "shed", "decimate" };
+
+service_desc_t *services_add(service_table_t *table, const char *name, void *(*entry)(void *),
+                             unsigned int period_us, service_policy_t policy, int cpu) {
+    service_desc_t *svc;
+
+    if(table->count == SERVICE_MAX)
+        return NULL;
+
+    svc = &table->services[table->count++];
+    memset(svc, 0, sizeof(service_desc_t));
+    strncpy(svc->name, name, SERVICE_NAME_LENGTH - 1);
+    svc->entry = entry;
+    svc->period_us = period_us;
+    svc->priority = SERVICE_PRIO_AUTO;
+    svc->policy = policy;
+    svc->cpus[0] = cpu;
+    svc->ncpus = 1;
+    svc->instances = 1;
+    svc->trace_ring = -1;
+    histogram_reset(&svc->hist_latency);
+    histogram_reset(&svc->hist_exec);
+    histogram_reset(&svc->hist_interval);
+
+    return svc;
+}
+
+void services_add_defaults(service_table_t *table, const service_entry_t *entries) {
+    service_desc_t *svc;
+
+    // Service_1 @ 33 Hz. Frame capture, alone on core 1
+    svc = services_add(table, "capture", entries ? entries[0] : NULL, 30000, SERVICE_POLICY_FIFO, 1);
+    svc->wcet_us = 8000;
+    svc->overload = SERVICE_OVERLOAD_SKIP;
+    // Service_2 @ 20 Hz. Differencing on core 2
+    svc = services_add(table, "differencing", entries ? entries[1] : NULL, 50000, SERVICE_POLICY_FIFO, 2);
+    svc->wcet_us = 10000;
+    svc->overload = SERVICE_OVERLOAD_SHED;
+    // Service_3 @ 10 Hz. Frame selection on core 2, below differencing
+    svc = services_add(table, "selection", entries ? entries[2] : NULL, 100000, SERVICE_POLICY_FIFO, 2);
+    svc->wcet_us = 2000;
+    svc->overload = SERVICE_OVERLOAD_DECIMATE;
+    // Service_4, best effort. Write-back pool on core 3, under SCHED_DEADLINE
+    // it gets a bandwidth reservation of its own every 100 ms
+    svc = services_add(table, "writeback", entries ? entries[3] : NULL, 0, SERVICE_POLICY_OTHER, 3);
+    svc->wcet_us = 40000;
+    svc->dl_period_us = 100000;
+}
+
+service_desc_t *services_find(service_table_t *table, const char *name) {
+    int i;
+
+    for(i = 0; i < table->count; i++) {
+        if(strcmp(table->services[i].name, name) == 0)
+            return &table->services[i];
+    }
+    return NULL;
+}
+
+int services_parse_cpus(const char *arg, int *cores, int max_cores) {
+    int count = 0;
+    long core;
+    char *end;
+
+    while(*arg != '\0') {
+        if(count == max_cores)
+            return -1;
+        errno = 0;
+        core = strtol(arg, &end, 0);
+        if(errno || end == arg || core < 0 || core >= CPU_SETSIZE)
+            return -1;
+        if(*end != ',' && *end != '\0')
+            return -1;
+        cores[count++] = core;
+        arg = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+static int parse_number(const char *value, long min, long max, long *result) {
+    char *end;
+
+    errno = 0;
+    *result = strtol(value, &end, 0);
+    if(errno || end == value || *end != '\0' || *result < min || *result > max)
+        return -1;
+    return 0;
+}
+
+int services_set(service_desc_t *svc, const char *key, const char *value) {
+    long number;
+    int cpus[SERVICE_MAX_CPUS];
+    int i, ncpus;
+
+    if(strcmp(key, "period") == 0) {
+        if(parse_number(value, 0, 60000, &number) < 0)
+            return -1;
+        svc->period_us = number * 1000;
+    } else if(strcmp(key, "priority") == 0) {
+        if(strcmp(value, "auto") == 0)
+            svc->priority = SERVICE_PRIO_AUTO;
+        else if(parse_number(value, 0, 99, &number) == 0)
+            svc->priority = number;
+        else
+            return -1;
+    } else if(strcmp(key, "policy") == 0) {
+        for(i = 0; i < (int)(sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+            if(strcmp(value, policy_names[i]) == 0)
+                break;
+        }
+        if(i == (int)(sizeof(policy_names) / sizeof(policy_names[0])))
+            return -1;
+        svc->policy = (service_policy_t)i;
+    } else if(strcmp(key, "cpus") == 0) {
+        ncpus = services_parse_cpus(value, cpus, SERVICE_MAX_CPUS);
+        if(ncpus < 1)
+            return -1;
+        memcpy(svc->cpus, cpus, ncpus * sizeof(int));
+        svc->ncpus = ncpus;
+    } else if(strcmp(key, "instances") == 0) {
+        if(parse_number(value, 1, SERVICE_MAX_INSTANCES, &number) < 0)
+            return -1;
+        svc->instances = number;
+    } else if(strcmp(key, "overload") == 0) {
+        for(i = 0; i < (int)(sizeof(overload_names) / sizeof(overload_names[0])); i++) {
+            if(strcmp(value, overload_names[i]) == 0)
+                break;
+        }
+        if(i == (int)(sizeof(overload_names) / sizeof(overload_names[0])))
+            return -1;
+        svc->overload = (service_overload_t)i;
+    } else if(strcmp(key, "wcet") == 0) {
+        if(parse_number(value, 0, 60000000, &number) < 0)
+            return -1;
+        svc->wcet_us = number;
+    } else if(strcmp(key, "runtime") == 0) {
+        if(parse_number(value, 0, 60000000, &number) < 0)
+            return -1;
+        svc->runtime_us = number;
+    } else if(strcmp(key, "deadline") == 0) {
+        if(parse_number(value, 0, 60000000, &number) < 0)
+            return -1;
+        svc->deadline_us = number;
+    } else if(strcmp(key, "dlperiod") == 0) {
+        if(parse_number(value, 0, 60000000, &number) < 0)
+            return -1;
+        svc->dl_period_us = number;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int services_parse_line(service_table_t *table, const char *line) {
+    char copy[SERVICE_LINE_LENGTH];
+    char *token, *value, *saveptr;
+    service_desc_t *svc;
+
+    strncpy(copy, line, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    if((token = strchr(copy, '#')) != NULL)
+        *token = '\0';
+
+    token = strtok_r(copy, " \t\r\n", &saveptr);
+    if(token == NULL)
+        return 0;                                  // blank or comment line
+
+    svc = services_find(table, token);
+    if(svc == NULL) {
+        fprintf(stderr, "Unknown service '%s'\n", token);
+        return -1;
+    }
+
+    while((token = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+        value = strchr(token, '=');
+        if(value == NULL) {
+            fprintf(stderr, "Service %s: expected key=value, got '%s'\n", svc->name, token);
+            return -1;
+        }
+        *value++ = '\0';
+        if(services_set(svc, token, value) < 0) {
+            fprintf(stderr, "Service %s: invalid %s '%s'\n", svc->name, token, value);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int services_load_config(service_table_t *table, const char *path) {
+    char line[SERVICE_LINE_LENGTH];
+    int lineno = 0;
+    FILE *config;
+
+    config = fopen(path, "r");
+    if(config == NULL) {
+        fprintf(stderr, "Cannot open service config '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    while(fgets(line, sizeof(line), config) != NULL) {
+        lineno++;
+        if(services_parse_line(table, line) < 0) {
+            fprintf(stderr, "%s:%d: invalid service line\n", path, lineno);
+            fclose(config);
+            return -1;
+        }
+    }
+    fclose(config);
+    return 0;
+}
+
+void services_assign_priorities(service_table_t *table, int max_prio) {
+    int i, j, rank;
+    service_desc_t *svc, *other;
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if((svc->policy == SERVICE_POLICY_OTHER) || (svc->policy == SERVICE_POLICY_DEADLINE)) {
+            svc->effective_priority = 0;
+        } else if(svc->priority != SERVICE_PRIO_AUTO) {
+            svc->effective_priority = svc->priority;
+        } else if(svc->period_us == 0) {
+            // best effort service under a RT policy, lowest RT priority
+            svc->effective_priority = sched_get_priority_min(SCHED_FIFO);
+        } else {
+            // rate monotonic: rank by the number of periodic services with a
+            // shorter period, max_prio itself is left to the sequencer
+            rank = 1;
+            for(j = 0; j < table->count; j++) {
+                other = &table->services[j];
+                if((other->period_us != 0) && (other->period_us < svc->period_us))
+                    rank++;
+            }
+            svc->effective_priority = max_prio - rank;
+        }
+    }
+}
+
+const char *services_policy_name(service_policy_t policy) {
+    return policy_names[policy];
+}
+
+void services_set_mode(service_table_t *table, service_policy_t policy) {
+    int i;
+
+    for(i = 0; i < table->count; i++)
+        table->services[i].policy = policy;
+}
+
+int services_derive_deadline(service_table_t *table) {
+    int i;
+    service_desc_t *svc;
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->policy != SERVICE_POLICY_DEADLINE)
+            continue;
+
+        if(svc->dl_period_us == 0)
+            svc->dl_period_us = svc->period_us;
+        if(svc->dl_period_us == 0) {
+            fprintf(stderr, "Service %s: best effort under deadline needs dlperiod\n", svc->name);
+            return -1;
+        }
+        if(svc->runtime_us == 0)
+            svc->runtime_us = (unsigned int)(((unsigned long long)svc->wcet_us *
+                                              (100 + SERVICE_DL_MARGIN_PCT)) / 100);
+        if(svc->runtime_us == 0) {
+            fprintf(stderr, "Service %s: deadline needs wcet or runtime\n", svc->name);
+            return -1;
+        }
+        if(svc->deadline_us == 0)
+            svc->deadline_us = svc->dl_period_us;
+
+        // the kernel requires 1024 ns <= runtime <= deadline <= period
+        if(svc->runtime_us < SERVICE_DL_MIN_RUNTIME_US || svc->runtime_us > svc->deadline_us ||
+           svc->deadline_us > svc->dl_period_us) {
+            fprintf(stderr, "Service %s: need runtime %u <= deadline %u <= period %u us\n",
+                    svc->name, svc->runtime_us, svc->deadline_us, svc->dl_period_us);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void services_print(const service_table_t *table) {
+    int i, j;
+    const service_desc_t *svc;
+
+    printf("Service table:\n");
+    printf("  %-16s %10s %5s %-8s %5s cpus\n", "name", "period(ms)", "prio", "policy", "inst");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        printf("  %-16s %10.3f %5d %-8s %5d ", svc->name, svc->period_us / USEC_PER_MSEC,
+               svc->effective_priority, policy_names[svc->policy], svc->instances);
+        for(j = 0; j < svc->ncpus; j++)
+            printf("%s%d", j ? "," : "", svc->cpus[j]);
+        printf("\n");
+        if(svc->policy == SERVICE_POLICY_DEADLINE)
+            printf("  %-16s runtime=%u us deadline=%u us period=%u us (wcet %u us)\n", "",
+                   svc->runtime_us, svc->deadline_us, svc->dl_period_us, svc->wcet_us);
+        syslog(LOG_INFO, "Service %s: period=%u us prio=%d policy=%s instances=%d cpu=%d",
+               svc->name, svc->period_us, svc->effective_priority, policy_names[svc->policy],
+               svc->instances, svc->cpus[0]);
+    }
+}
+
+static int policy_to_sched(service_policy_t policy) {
+    switch(policy) {
+        case SERVICE_POLICY_FIFO:  return SCHED_FIFO;
+        case SERVICE_POLICY_RR:    return SCHED_RR;
+        default:                   return SCHED_OTHER;
+    }
+}
+
+static int set_deadline(const service_desc_t *svc) {
+    service_sched_attr_t attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = svc->runtime_us * 1000ULL;
+    attr.sched_deadline = svc->deadline_us * 1000ULL;
+    attr.sched_period = svc->dl_period_us * 1000ULL;
+
+    if(syscall(SYS_sched_setattr, 0, &attr, 0) < 0)
+        return errno;
+    return 0;
+}
+
+// Reservation of a deadline thread. The kernel only admits a deadline task
+// whose affinity spans its whole root domain, so a pinned thread is refused
+// with EPERM unless the cores are split by cpuset partitions. In that case
+// the reservation is retried on every core the process may run on, taken
+// from the unpinned main thread, since online cores need not be numbered
+// 0..n-1 nor all be allowed.
+static int deadline_admit(service_desc_t *svc) {
+    cpu_set_t allowed;
+    int rc;
+
+    rc = set_deadline(svc);
+    if(rc == EPERM) {
+        CPU_ZERO(&allowed);
+        if((sched_getaffinity(getpid(), sizeof(cpu_set_t), &allowed) == 0) &&
+           (sched_setaffinity(0, sizeof(cpu_set_t), &allowed) == 0) && ((rc = set_deadline(svc)) == 0))
+            svc->affinity_dropped = true;
+    }
+    if(rc != 0)
+        svc->admission = rc;
+    sem_post(&admission_done);
+    return rc;
+}
+
+// Entry of every service thread, sets up the per thread state before the
+// service function runs
+static void *service_trampoline(void *threadp) {
+    threadParams_t *params = (threadParams_t *)threadp;
+    service_desc_t *svc = params->svc;
+    void *ret;
+    int ring;
+
+    // the sequencer links its releases to the ring of the first instance
+    ring = trace_register(svc->name, params->instance);
+    if(params->instance == 0)
+        __atomic_store_n(&svc->trace_ring, ring, __ATOMIC_RELEASE);
+    perfcount_open(&params->perf);
+
+    // a refused service does not run, main exits on the admission report
+    if((svc->policy == SERVICE_POLICY_DEADLINE) && (deadline_admit(svc) != 0)) {
+        perfcount_close(&params->perf);
+        return NULL;
+    }
+    ret = svc->entry(threadp);
+    perfcount_close(&params->perf);
+    return ret;
+}
+
+int services_launch(service_table_t *table, cbuff_struct_t *frame_buffer) {
+    int i, k, j, rc;
+    int deadline_threads = 0;
+    service_desc_t *svc;
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t threadcpu;
+
+    if(sem_init(&admission_done, 0, 0)) {
+        fprintf(stderr, "Failed to initialize the admission semaphore\n");
+        return -1;
+    }
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(sem_init(&svc->release, 0, 0)) {
+            fprintf(stderr, "Failed to initialize %s semaphore\n", svc->name);
+            return -1;
+        }
+    }
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        for(k = 0; k < svc->instances; k++) {
+            if(thread_count == SERVICE_MAX_THREADS)
+                return -1;
+
+            // a single instance may use every listed core, a pool is
+            // spread round robin with one core per instance
+            CPU_ZERO(&threadcpu);
+            if(svc->instances == 1) {
+                for(j = 0; j < svc->ncpus; j++)
+                    CPU_SET(svc->cpus[j], &threadcpu);
+            } else {
+                CPU_SET(svc->cpus[k % svc->ncpus], &threadcpu);
+            }
+
+            rc=pthread_attr_init(&attr);
+            rc=pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+            rc=pthread_attr_setschedpolicy(&attr, policy_to_sched(svc->policy));
+            rc=pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &threadcpu);
+            param.sched_priority = svc->effective_priority;
+            pthread_attr_setschedparam(&attr, &param);
+
+            threadParams[thread_count].threadIdx = thread_count + 1;
+            threadParams[thread_count].instance = k;
+            threadParams[thread_count].svc = svc;
+            threadParams[thread_count].global_cbuf = frame_buffer;
+
+            // deadline threads start under SCHED_OTHER and switch themselves
+            if(svc->policy == SERVICE_POLICY_DEADLINE)
+                deadline_threads++;
+
+            rc=pthread_create(&threads[thread_count],             // pointer to thread descriptor
+                              &attr,                              // use specific attributes
+                              service_trampoline,                 // thread function entry point
+                              (void *)&threadParams[thread_count] // parameters to pass in
+                             );
+            pthread_attr_destroy(&attr);
+            if(rc != 0) {
+                fprintf(stderr, "pthread_create for %s instance %d: %s\n", svc->name, k, strerror(rc));
+                return -1;
+            }
+            printf("pthread_create successful for %s instance %d\n", svc->name, k);
+            thread_count++;
+        }
+    }
+
+    // wait for the admission result of every deadline thread
+    while(deadline_threads-- > 0) {
+        while(sem_wait(&admission_done) < 0 && errno == EINTR);
+    }
+    return thread_count;
+}
+
+static long read_proc_long(const char *path) {
+    FILE *fp;
+    long value = -1;
+
+    fp = fopen(path, "r");
+    if(fp == NULL)
+        return -1;
+    if(fscanf(fp, "%ld", &value) != 1)
+        value = -1;
+    fclose(fp);
+    return value;
+}
+
+int services_print_admission(const service_table_t *table) {
+    int i, refused = 0, count = 0;
+    long rt_runtime, rt_period;
+    double bandwidth, total = 0.0;
+    const service_desc_t *svc;
+
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->policy != SERVICE_POLICY_DEADLINE)
+            continue;
+        if(count++ == 0)
+            printf("SCHED_DEADLINE admission:\n");
+
+        bandwidth = (double)svc->runtime_us * svc->instances / svc->dl_period_us;
+        total += bandwidth;
+        if(svc->admission != 0)
+            refused++;
+        printf("  %-16s %8u/%-8u us x%d = %5.1f%%  %s%s%s\n", svc->name, svc->runtime_us,
+               svc->dl_period_us, svc->instances, bandwidth * 100.0,
+               svc->admission ? "refused: " : "admitted",
+               svc->admission ? strerror(svc->admission) : "",
+               svc->affinity_dropped ? ", cpus ignored (no cpuset partition)" : "");
+        syslog(LOG_INFO, "Deadline %s: runtime=%u deadline=%u period=%u us %s", svc->name,
+               svc->runtime_us, svc->deadline_us, svc->dl_period_us,
+               svc->admission ? strerror(svc->admission) : "admitted");
+    }
+    if(count == 0)
+        return 0;
+
+    // admission control caps the deadline bandwidth at the RT throttling limit
+    rt_runtime = read_proc_long("/proc/sys/kernel/sched_rt_runtime_us");
+    rt_period = read_proc_long("/proc/sys/kernel/sched_rt_period_us");
+    if(rt_runtime > 0 && rt_period > 0)
+        printf("  total %.1f%% of %.1f%% (%d cpus x %ld/%ld)\n", total * 100.0,
+               get_nprocs() * 100.0 * rt_runtime / rt_period, get_nprocs(), rt_runtime, rt_period);
+    else
+        printf("  total %.1f%%, RT bandwidth limit disabled\n", total * 100.0);
+    if(refused)
+        printf("  EBUSY: bandwidth exceeded, EPERM: needs CAP_SYS_NICE or a full root domain affinity\n");
+    return refused;
+}
+
+void services_join(void) {
+    int i;
+
+    for(i = 0; i < thread_count; i++) {
+        if(pthread_join(threads[i], NULL) != 0)
+            perror("main pthread_join");
+        else
+            printf("joined thread %d\n", i);
+    }
+}
+
+static long long thread_cpu_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// a release of the service is finished with, whether it ran or not
+static void release_done(service_desc_t *svc) {
+    __atomic_fetch_add(&svc->completed, 1, __ATOMIC_RELEASE);
+    timesource_job_done();
+}
+
+bool service_job_start(threadParams_t *params) {
+    struct timespec now;
+    long long now_ns, dev_ns;
+    unsigned long long release;
+    service_desc_t *svc = params->svc;
+    service_jitter_t *jitter = &svc->jitter;
+    service_overload_stats_t *stats = &svc->overload_stats;
+
+    params->exec.start_ns = thread_cpu_ns();
+    perfcount_job_start(&params->perf);
+    if(svc->period_us == 0)
+        return true;
+
+    // the clock the sequencer releases on, virtual in a simulation run
+    timesource_sequencer_time(&now);
+    now_ns = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+    histogram_record(&svc->hist_latency, now_ns - __atomic_load_n(&svc->release_ns, __ATOMIC_RELAXED));
+
+    if(jitter->releases > 0) {
+        histogram_record(&svc->hist_interval, now_ns - jitter->last_start_ns);
+        dev_ns = now_ns - jitter->last_start_ns - svc->period_us * 1000LL;
+        if(jitter->releases == 1 || dev_ns < jitter->min_dev_ns) jitter->min_dev_ns = dev_ns;
+        if(jitter->releases == 1 || dev_ns > jitter->max_dev_ns) jitter->max_dev_ns = dev_ns;
+        jitter->sum_dev_ns += dev_ns;
+        jitter->sum_sq_dev_ns += (double)dev_ns * dev_ns;
+    }
+    jitter->last_start_ns = now_ns;
+    jitter->releases++;
+
+    // a degraded decimating service runs every 2^level-th release only
+    release = stats->releases++;
+    if((svc->overload == SERVICE_OVERLOAD_DECIMATE) && ((release & ((1ULL << stats->level) - 1)) != 0)) {
+        stats->decimated++;
+        trace_event(TRACE_JOB_DECIMATE, (int32_t)release, stats->level, 0);
+        release_done(svc);
+        return false;
+    }
+    trace_event(TRACE_JOB_START, (int32_t)release, 0, 0);
+    return true;
+}
+
+static void deadline_missed(service_desc_t *svc, int pending) {
+    service_overload_stats_t *stats = &svc->overload_stats;
+    int skipped;
+
+    stats->misses++;
+    stats->on_time = 0;
+    trace_event(TRACE_JOB_MISS, pending, stats->level, 0);
+
+    switch(svc->overload) {
+        case SERVICE_OVERLOAD_SKIP:
+            // start fresh at the next release instead of running late jobs
+            skipped = 0;
+            while(pending-- > 0 && sem_trywait(&svc->release) == 0) {
+                skipped++;
+                release_done(svc);
+            }
+            stats->skipped += skipped;
+            trace_event(TRACE_JOB_SKIP, skipped, 0, 0);
+            break;
+        case SERVICE_OVERLOAD_SHED:
+        case SERVICE_OVERLOAD_DECIMATE:
+            if(stats->level < SERVICE_MAX_DEGRADE) {
+                stats->level++;
+                stats->degrades++;
+                if(stats->level > stats->max_level)
+                    stats->max_level = stats->level;
+                syslog(LOG_WARNING, "Overload %s: deadline miss, %s level %d", svc->name,
+                       overload_names[svc->overload], stats->level);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void deadline_met(service_desc_t *svc) {
+    service_overload_stats_t *stats = &svc->overload_stats;
+
+    if((stats->level > 0) && (++stats->on_time >= SERVICE_RECOVER_JOBS)) {
+        stats->level--;
+        stats->recoveries++;
+        stats->on_time = 0;
+        syslog(LOG_INFO, "Overload %s: recovered to level %d", svc->name, stats->level);
+    }
+}
+
+int service_degrade_level(const threadParams_t *params) {
+    return params->svc->overload_stats.level;
+}
+
+void service_job_end(threadParams_t *params) {
+    service_exec_t *exec = &params->exec;
+    unsigned long long jobs = exec->jobs;
+    int pending;
+    long long exec_ns = thread_cpu_ns() - exec->start_ns;
+
+    perfcount_job_end(&params->perf);
+    if(exec_ns > UINT32_MAX)
+        exec_ns = UINT32_MAX;
+    __atomic_store_n(&exec->samples[jobs & (SERVICE_EXEC_SAMPLES - 1)], (uint32_t)exec_ns, __ATOMIC_RELAXED);
+    if(jobs == 0 || exec_ns < exec->min_ns) __atomic_store_n(&exec->min_ns, exec_ns, __ATOMIC_RELAXED);
+    if(exec_ns > exec->max_ns) __atomic_store_n(&exec->max_ns, exec_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&exec->sum_ns, exec->sum_ns + exec_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&exec->jobs, jobs + 1, __ATOMIC_RELEASE);
+    trace_event(TRACE_JOB_END, (int32_t)jobs, exec_ns, sched_getcpu());
+    histogram_record(&params->svc->hist_exec, exec_ns);
+
+    // the next release is already pending: this job ran past its deadline
+    if(params->svc->period_us != 0) {
+        if((sem_getvalue(&params->svc->release, &pending) == 0) && (pending > 0))
+            deadline_missed(params->svc, pending);
+        else
+            deadline_met(params->svc);
+        release_done(params->svc);
+    }
+}
+
+unsigned long long services_report_overload(const service_table_t *table) {
+    int i;
+    unsigned long long total = 0;
+    const service_desc_t *svc;
+    const service_overload_stats_t *stats;
+
+    printf("Deadline misses:\n");
+    printf("  %-16s %-8s %9s %9s %9s %9s %9s %9s %5s\n", "name", "policy", "releases", "misses",
+           "skipped", "decimated", "degrades", "recovers", "level");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->period_us == 0)
+            continue;
+        stats = &svc->overload_stats;
+        total += stats->misses;
+        printf("  %-16s %-8s %9llu %9llu %9llu %9llu %9llu %9llu %2d/%-2d\n", svc->name,
+               overload_names[svc->overload], stats->releases, stats->misses, stats->skipped,
+               stats->decimated, stats->degrades, stats->recoveries, stats->level, stats->max_level);
+        syslog(LOG_INFO, "Overload %s: releases=%llu misses=%llu skipped=%llu decimated=%llu degrades=%llu recoveries=%llu max level=%d",
+               svc->name, stats->releases, stats->misses, stats->skipped, stats->decimated,
+               stats->degrades, stats->recoveries, stats->max_level);
+    }
+    return total;
+}
+
+static int compare_samples(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void services_exec_summary(const service_desc_t *svc, service_exec_summary_t *summary) {
+    static uint32_t snapshot[SERVICE_MAX_INSTANCES * SERVICE_EXEC_SAMPLES];
+    static pthread_mutex_t sgl_snapshot = PTHREAD_MUTEX_INITIALIZER;
+    const service_exec_t *exec;
+    unsigned long long jobs, kept;
+    long long min_ns, max_ns, sum_ns = 0;
+    int i, nsamples = 0;
+
+    memset(summary, 0, sizeof(service_exec_summary_t));
+    pthread_mutex_lock(&sgl_snapshot);
+    for(i = 0; i < thread_count; i++) {
+        if(threadParams[i].svc != svc)
+            continue;
+        exec = &threadParams[i].exec;
+        jobs = __atomic_load_n(&exec->jobs, __ATOMIC_ACQUIRE);
+        if(jobs == 0)
+            continue;
+        min_ns = __atomic_load_n(&exec->min_ns, __ATOMIC_RELAXED);
+        max_ns = __atomic_load_n(&exec->max_ns, __ATOMIC_RELAXED);
+        sum_ns += __atomic_load_n(&exec->sum_ns, __ATOMIC_RELAXED);
+        if(summary->jobs == 0 || min_ns < summary->min_ns) summary->min_ns = min_ns;
+        if(max_ns > summary->max_ns) summary->max_ns = max_ns;
+        summary->jobs += jobs;
+
+        kept = (jobs < SERVICE_EXEC_SAMPLES) ? jobs : SERVICE_EXEC_SAMPLES;
+        while(kept-- > 0)
+            snapshot[nsamples++] = __atomic_load_n(&exec->samples[kept], __ATOMIC_RELAXED);
+    }
+
+    if(summary->jobs != 0) {
+        summary->avg_ns = sum_ns / (long long)summary->jobs;
+        qsort(snapshot, nsamples, sizeof(uint32_t), compare_samples);
+        summary->p99_ns = snapshot[(nsamples * 99) / 100];
+    }
+    pthread_mutex_unlock(&sgl_snapshot);
+}
+
+void services_report_exec(const service_table_t *table) {
+    int i;
+    service_exec_summary_t summary;
+    const service_desc_t *svc;
+
+    printf("Execution time:\n");
+    printf("  %-16s %10s %10s %10s %10s %10s\n", "name", "jobs", "min(us)", "avg(us)", "max(us)", "p99(us)");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        services_exec_summary(svc, &summary);
+        printf("  %-16s %10llu %10.1f %10.1f %10.1f %10.1f\n", svc->name, summary.jobs,
+               summary.min_ns / 1000.0, summary.avg_ns / 1000.0, summary.max_ns / 1000.0,
+               summary.p99_ns / 1000.0);
+        syslog(LOG_INFO, "Exec %s: jobs=%llu min=%lld avg=%lld max=%lld p99=%lld ns", svc->name,
+               summary.jobs, summary.min_ns, summary.avg_ns, summary.max_ns, summary.p99_ns);
+    }
+}
+
+static void print_histogram(const char *name, const char *metric, const histogram_t *hist) {
+    histogram_summary_t s;
+
+    histogram_summarize(hist, &s);
+    if(s.count == 0)
+        return;
+    printf("  %-16s %-9s %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, metric,
+           (unsigned long long)s.count, s.min / 1000.0, s.mean / 1000.0, s.p50 / 1000.0,
+           s.p90 / 1000.0, s.p99 / 1000.0, s.p999 / 1000.0, s.max / 1000.0);
+    syslog(LOG_INFO, "Histogram %s %s: n=%llu min=%lld p50=%lld p99=%lld p99.9=%lld max=%lld ns", name, metric,
+           (unsigned long long)s.count, (long long)s.min, (long long)s.p50, (long long)s.p99,
+           (long long)s.p999, (long long)s.max);
+}
+
+void services_report_histograms(const service_table_t *table) {
+    int i;
+    const service_desc_t *svc;
+
+    printf("Latency histograms (us):\n");
+    printf("  %-16s %-9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "name", "metric", "count",
+           "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        print_histogram(svc->name, "latency", &svc->hist_latency);
+        print_histogram(svc->name, "exec", &svc->hist_exec);
+        print_histogram(svc->name, "interval", &svc->hist_interval);
+    }
+    fflush(stdout);
+}
+
+// per job average of a counter, "-" if the threads did not count it
+static void print_per_job(uint64_t total, unsigned long long jobs, bool counted, double unit) {
+    if(counted)
+        printf(" %10.1f", (double)total / unit / (double)jobs);
+    else
+        printf(" %10s", "-");
+}
+
+void services_report_perf(const service_table_t *table) {
+    uint64_t total[PERFCOUNT_EVENTS];
+    bool counted[PERFCOUNT_EVENTS];
+    unsigned long long jobs, multiplexed;
+    perfcount_mode_t mode;
+    const perfcount_t *perf;
+    const service_desc_t *svc;
+    int i, t, e;
+
+    if(!perfcount_enabled())
+        return;
+
+    printf("Performance counters per job:\n");
+    printf("  %-16s %-8s %8s %10s %10s %6s %10s %10s %8s %10s %10s %10s\n", "name", "source", "jobs",
+           "kcycles", "kinstr", "IPC", "LLC loads", "misses", "MPKI", "ctx sw", "cpu(us)", "faults");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        memset(total, 0, sizeof(total));
+        memset(counted, 0, sizeof(counted));
+        jobs = multiplexed = 0;
+        mode = PERFCOUNT_OFF;
+
+        for(t = 0; t < thread_count; t++) {
+            if(threadParams[t].svc != svc)
+                continue;
+            perf = &threadParams[t].perf;
+            if(__atomic_load_n(&perf->jobs, __ATOMIC_ACQUIRE) == 0)
+                continue;
+            // the threads of a service may have fallen back differently, report the weakest
+            if(perf->mode > mode)
+                mode = perf->mode;
+            jobs += perf->jobs;
+            multiplexed += __atomic_load_n(&perf->multiplexed, __ATOMIC_RELAXED);
+            for(e = 0; e < PERFCOUNT_EVENTS; e++) {
+                if(perf->slot[e] == PERFCOUNT_NOT_COUNTED)
+                    continue;
+                total[e] += __atomic_load_n(&perf->total[e], __ATOMIC_RELAXED);
+                counted[e] = true;
+            }
+        }
+        if(jobs == 0)
+            continue;
+
+        printf("  %-16s %-8s %8llu", svc->name, perfcount_mode_name(mode), jobs);
+        print_per_job(total[PERFCOUNT_CYCLES], jobs, counted[PERFCOUNT_CYCLES], 1000.0);
+        print_per_job(total[PERFCOUNT_INSTRUCTIONS], jobs, counted[PERFCOUNT_INSTRUCTIONS], 1000.0);
+        if(counted[PERFCOUNT_CYCLES] && counted[PERFCOUNT_INSTRUCTIONS] && total[PERFCOUNT_CYCLES] > 0)
+            printf(" %6.2f", (double)total[PERFCOUNT_INSTRUCTIONS] / (double)total[PERFCOUNT_CYCLES]);
+        else
+            printf(" %6s", "-");
+        print_per_job(total[PERFCOUNT_LLC_LOADS], jobs, counted[PERFCOUNT_LLC_LOADS], 1.0);
+        print_per_job(total[PERFCOUNT_CACHE_MISSES], jobs, counted[PERFCOUNT_CACHE_MISSES], 1.0);
+        if(counted[PERFCOUNT_CACHE_MISSES] && counted[PERFCOUNT_INSTRUCTIONS] && total[PERFCOUNT_INSTRUCTIONS] > 0)
+            printf(" %8.2f", (double)total[PERFCOUNT_CACHE_MISSES] * 1000.0 / (double)total[PERFCOUNT_INSTRUCTIONS]);
+        else
+            printf(" %8s", "-");
+        print_per_job(total[PERFCOUNT_CONTEXT_SWITCHES], jobs, counted[PERFCOUNT_CONTEXT_SWITCHES], 1.0);
+        print_per_job(total[PERFCOUNT_TASK_CLOCK], jobs, counted[PERFCOUNT_TASK_CLOCK], 1000.0);
+        print_per_job(total[PERFCOUNT_PAGE_FAULTS], jobs, counted[PERFCOUNT_PAGE_FAULTS], 1.0);
+        printf("\n");
+        if(multiplexed > 0)
+            printf("  %-16s %llu jobs extrapolated, the PMU was shared with other events\n", "", multiplexed);
+
+        syslog(LOG_INFO, "Perf %s: source=%s jobs=%llu cycles=%llu instructions=%llu llc_loads=%llu cache_misses=%llu ctx_switches=%llu task_clock=%llu ns page_faults=%llu multiplexed=%llu",
+               svc->name, perfcount_mode_name(mode), jobs,
+               (unsigned long long)total[PERFCOUNT_CYCLES], (unsigned long long)total[PERFCOUNT_INSTRUCTIONS],
+               (unsigned long long)total[PERFCOUNT_LLC_LOADS], (unsigned long long)total[PERFCOUNT_CACHE_MISSES],
+               (unsigned long long)total[PERFCOUNT_CONTEXT_SWITCHES], (unsigned long long)total[PERFCOUNT_TASK_CLOCK],
+               (unsigned long long)total[PERFCOUNT_PAGE_FAULTS], multiplexed);
+    }
+    printf("  low IPC with a high MPKI (misses per 1000 instructions) points at memory, high IPC at compute\n");
+}
+
+void services_report_jitter(const service_table_t *table, const char *mode, const char *path) {
+    int i;
+    unsigned long long n;
+    double avg, stddev;
+    const service_desc_t *svc;
+    FILE *log = NULL;
+
+    if(path != NULL) {
+        log = fopen(path, "a");
+        if(log == NULL)
+            fprintf(stderr, "Cannot open jitter log '%s': %s\n", path, strerror(errno));
+        else if(ftell(log) == 0)
+            fprintf(log, "mode,service,period_us,intervals,min_us,avg_us,max_us,stddev_us\n");
+    }
+
+    printf("Start jitter (%s):\n", mode);
+    printf("  %-16s %10s %10s %10s %10s %10s\n", "name", "intervals", "min(us)", "avg(us)", "max(us)", "std(us)");
+    for(i = 0; i < table->count; i++) {
+        svc = &table->services[i];
+        if(svc->period_us == 0 || svc->jitter.releases < 2)
+            continue;
+        n = svc->jitter.releases - 1;
+        avg = svc->jitter.sum_dev_ns / n;
+        stddev = sqrt(fmax(0.0, svc->jitter.sum_sq_dev_ns / n - avg * avg));
+        printf("  %-16s %10llu %10.1f %10.1f %10.1f %10.1f\n", svc->name, n,
+               svc->jitter.min_dev_ns / 1000.0, avg / 1000.0, svc->jitter.max_dev_ns / 1000.0, stddev / 1000.0);
+        if(log != NULL)
+            fprintf(log, "%s,%s,%u,%llu,%.1f,%.1f,%.1f,%.1f\n", mode, svc->name, svc->period_us, n,
+                    svc->jitter.min_dev_ns / 1000.0, avg / 1000.0, svc->jitter.max_dev_ns / 1000.0, stddev / 1000.0);
+    }
+    if(log != NULL)
+        fclose(log);
+}
+
+// latest row of one service in one mode of the jitter log
+typedef struct {
+    char name[SERVICE_NAME_LENGTH];
+    bool valid[2];
+    double max_us[2];
+    double stddev_us[2];
+}jitter_row_t;
+
+int services_compare_jitter(const char *path) {
+    char line[SERVICE_LINE_LENGTH], mode[16], name[SERVICE_NAME_LENGTH];
+    double min_us, avg_us, max_us, stddev_us;
+    unsigned long long intervals;
+    unsigned int period_us;
+    jitter_row_t rows[SERVICE_MAX * 2];
+    int nrows = 0, i, m;
+    FILE *log;
+
+    log = fopen(path, "r");
+    if(log == NULL)
+        return -1;
+
+    memset(rows, 0, sizeof(rows));
+    while(fgets(line, sizeof(line), log) != NULL) {
+        if(sscanf(line, "%15[^,],%23[^,],%u,%llu,%lf,%lf,%lf,%lf", mode, name, &period_us,
+                  &intervals, &min_us, &avg_us, &max_us, &stddev_us) != 8)
+            continue;                              // header or foreign line
+        if(strcmp(mode, "fifo") == 0)
+            m = 0;
+        else if(strcmp(mode, "deadline") == 0)
+            m = 1;
+        else
+            continue;
+        for(i = 0; i < nrows; i++) {
+            if(strcmp(rows[i].name, name) == 0)
+                break;
+        }
+        if(i == nrows) {
+            if(nrows == (int)(sizeof(rows) / sizeof(rows[0])))
+                continue;
+            strcpy(rows[nrows++].name, name);
+        }
+        rows[i].valid[m] = true;
+        rows[i].max_us[m] = max_us;
+        rows[i].stddev_us[m] = stddev_us;
+    }
+    fclose(log);
+
+    printf("Start jitter, fifo vs deadline (%s):\n", path);
+    printf("  %-16s %12s %12s %12s %12s\n", "name", "fifo max", "fifo std", "dl max", "dl std");
+    for(i = 0; i < nrows; i++) {
+        printf("  %-16s", rows[i].name);
+        for(m = 0; m < 2; m++) {
+            if(rows[i].valid[m])
+                printf(" %12.1f %12.1f", rows[i].max_us[m], rows[i].stddev_us[m]);
+            else
+                printf(" %12s %12s", "-", "-");
+        }
+        printf("\n");
+    }
+    return 0;
+}
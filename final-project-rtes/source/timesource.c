@@ -0,0 +1,168 @@
+/**
+*
+* This file contains the time source of the sequencer and the services.
+* In real time it is a thin wrapper around MY_CLOCK, SEQUENCER_CLOCK and
+* clock_nanosleep(). In a simulation run time is virtual: the sequencer
+* counts the jobs it releases, the services count them back when done,
+* and the clock only jumps to the next release point once nothing is left
+* to run. A run then takes as long as the services need to compute, not
+* as long as the recording lasts, and every job sees the same time and
+* the same inputs on every run.
+*
+* A real-time replay of the same recording is not expected to select the
+* same frames, even without a deadline miss. The simulation runs the jobs
+* of a release point one after the other in schedule order, while in real
+* time they run at once on their cores, so whether differencing and
+* selection see the frame captured at the same release point depends on
+* which core gets there first.
+*
+* A free run keeps the real clocks but the sequencer does not sleep to the
+* release points: finished jobs bump a progress count, and the sequencer
+* releases the next job of a stage as soon as it is ready, to measure how
+* fast the pipeline can go. Its selected frames are not those of a paced
+* run.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include "../includes/timesource.h"
+#include "../includes/circular_buff.h"
+#include "../includes/sequencer.h"
+
+static timesource_mode_t mode = TIMESOURCE_REAL;
+static bool frame_wallclock = false;
+
+// virtual clock, guarded by sgl_time
+static pthread_mutex_t sgl_time = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static struct timespec virtual_now;
+static int outstanding_jobs = 0;
+static unsigned long long progress = 0;       // finished jobs and notifications
+static int (*idle_check)(void) = NULL;
+
+void timesource_init(timesource_mode_t new_mode, const struct timespec *start, bool use_frame_wallclock) {
+    mode = new_mode;
+    frame_wallclock = use_frame_wallclock;
+    if(start != NULL)
+        virtual_now = *start;
+}
+
+bool timesource_is_virtual(void) {
+    return mode == TIMESOURCE_VIRTUAL;
+}
+
+bool timesource_is_free_run(void) {
+    return mode == TIMESOURCE_FREE_RUN;
+}
+
+void timesource_gettime(struct timespec *ts) {
+    if(mode != TIMESOURCE_VIRTUAL) {
+        clock_gettime(MY_CLOCK, ts);
+        return;
+    }
+    pthread_mutex_lock(&sgl_time);
+    *ts = virtual_now;
+    pthread_mutex_unlock(&sgl_time);
+}
+
+void timesource_sequencer_time(struct timespec *ts) {
+    if(mode != TIMESOURCE_VIRTUAL)
+        clock_gettime(SEQUENCER_CLOCK, ts);
+    else
+        timesource_gettime(ts);
+}
+
+int timesource_sleep_until(const struct timespec *wakeup) {
+    if(mode != TIMESOURCE_VIRTUAL)
+        return clock_nanosleep(SEQUENCER_CLOCK, TIMER_ABSTIME, wakeup, NULL);
+
+    timesource_wait_idle();
+    pthread_mutex_lock(&sgl_time);
+    if((wakeup->tv_sec > virtual_now.tv_sec) ||
+       ((wakeup->tv_sec == virtual_now.tv_sec) && (wakeup->tv_nsec > virtual_now.tv_nsec)))
+        virtual_now = *wakeup;
+    pthread_mutex_unlock(&sgl_time);
+    return 0;
+}
+
+void timesource_wallclock(const struct timespec *frame_time, struct timespec *wall) {
+    if(frame_wallclock)
+        *wall = *frame_time;
+    else
+        clock_gettime(CLOCK_REALTIME, wall);
+}
+
+void timesource_job_released(void) {
+    if(mode != TIMESOURCE_VIRTUAL)
+        return;
+    pthread_mutex_lock(&sgl_time);
+    outstanding_jobs++;
+    pthread_mutex_unlock(&sgl_time);
+}
+
+void timesource_job_done(void) {
+    if(mode == TIMESOURCE_REAL)
+        return;
+    pthread_mutex_lock(&sgl_time);
+    if(outstanding_jobs > 0)
+        outstanding_jobs--;
+    progress++;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&sgl_time);
+}
+
+void timesource_notify(void) {
+    if(mode == TIMESOURCE_REAL)
+        return;
+    pthread_mutex_lock(&sgl_time);
+    progress++;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&sgl_time);
+}
+
+void timesource_set_idle_check(int (*pending)(void)) {
+    idle_check = pending;
+}
+
+void timesource_wait_idle(void) {
+    if(mode != TIMESOURCE_VIRTUAL)
+        return;
+    // the idle check takes no lock, see timesource_set_idle_check()
+    pthread_mutex_lock(&sgl_time);
+    while((outstanding_jobs > 0) || ((idle_check != NULL) && (idle_check() > 0)))
+        pthread_cond_wait(&idle_cond, &sgl_time);
+    pthread_mutex_unlock(&sgl_time);
+}
+
+unsigned long long timesource_progress(void) {
+    unsigned long long count;
+
+    pthread_mutex_lock(&sgl_time);
+    count = progress;
+    pthread_mutex_unlock(&sgl_time);
+    return count;
+}
+
+void timesource_wait_progress(unsigned long long seen) {
+    struct timespec timeout;
+
+    // the condition variable waits on CLOCK_REALTIME
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += TIMESOURCE_PROGRESS_POLL_MS * 1000000L;
+    if(timeout.tv_nsec >= 1000000000L) {
+        timeout.tv_nsec -= 1000000000L;
+        timeout.tv_sec++;
+    }
+    pthread_mutex_lock(&sgl_time);
+    while(progress == seen) {
+        if(pthread_cond_timedwait(&idle_cond, &sgl_time, &timeout) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&sgl_time);
+}
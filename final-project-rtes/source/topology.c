@@ -0,0 +1,295 @@
+/**
+*
+* This file contains the helper functions for reading the CPU topology
+* from sysfs and deriving a core placement plan for the services, so the
+* same binary places itself sensibly on a 4 core board, an SMT x86 rig or
+* a kernel booted with isolcpus/nohz_full.
+*
+* The sequencer goes to a housekeeping core, the first one that is not
+* isolated. Capture and differencing/selection each get a physical core of
+* their own, isolated cores first, and all of them are taken from the last
+* level cache that offers the most cores, so the frames handed from one
+* stage to the next stay in a shared cache. The writeback pool gets the
+* remaining cores of that cache, then any other core, and shares the
+* housekeeping core only when nothing else is left.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../includes/topology.h"
+
+// for logging
+#include <syslog.h>
+
+#define TOPOLOGY_LINE_LENGTH   (1024)
+#define TOPOLOGY_MAX_CACHES    (8)
+
+static int read_line(const char *root, const char *file, char *line, int length) {
+    char path[TOPOLOGY_LINE_LENGTH];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", root, file);
+    fp = fopen(path, "r");
+    if(fp == NULL)
+        return -1;
+    if(fgets(line, length, fp) == NULL)
+        line[0] = '\0';
+    fclose(fp);
+    line[strcspn(line, "\n")] = '\0';
+    return 0;
+}
+
+// parse a kernel cpu list such as "0-3,6,8-9", returns the lowest CPU
+static int parse_cpulist(const char *list, bool *mask) {
+    long first, last, cpu;
+    int lowest = -1;
+    char *end;
+
+    while(*list != '\0') {
+        first = strtol(list, &end, 10);
+        if(end == list)
+            break;
+        last = first;
+        if(*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for(cpu = first; cpu <= last && cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+            if(mask != NULL)
+                mask[cpu] = true;
+            if(lowest < 0)
+                lowest = cpu;
+        }
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return lowest;
+}
+
+static void read_caches(const char *root, int cpu, topology_cpu_t *info) {
+    char file[TOPOLOGY_LINE_LENGTH], line[TOPOLOGY_LINE_LENGTH];
+    int index, level, lowest;
+
+    // without cache information all CPUs are taken to share one cache
+    info->llc = -1;
+    info->llc_level = 0;
+    for(index = 0; index < TOPOLOGY_MAX_CACHES; index++) {
+        snprintf(file, sizeof(file), "cpu%d/cache/index%d/type", cpu, index);
+        if(read_line(root, file, line, sizeof(line)) < 0)
+            break;
+        if(strcmp(line, "Instruction") == 0)
+            continue;
+        snprintf(file, sizeof(file), "cpu%d/cache/index%d/level", cpu, index);
+        if(read_line(root, file, line, sizeof(line)) < 0)
+            continue;
+        level = atoi(line);
+        snprintf(file, sizeof(file), "cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if(level <= info->llc_level || read_line(root, file, line, sizeof(line)) < 0)
+            continue;
+        lowest = parse_cpulist(line, NULL);
+        if(lowest >= 0) {
+            info->llc = lowest;
+            info->llc_level = level;
+        }
+    }
+}
+
+int topology_read(topology_t *topo, const char *root) {
+    char file[TOPOLOGY_LINE_LENGTH], line[TOPOLOGY_LINE_LENGTH];
+    bool online[TOPOLOGY_MAX_CPUS] = { false };
+    bool isolated[TOPOLOGY_MAX_CPUS] = { false };
+    bool nohz_full[TOPOLOGY_MAX_CPUS] = { false };
+    topology_cpu_t *info;
+    int cpu, lowest;
+
+    memset(topo, 0, sizeof(topology_t));
+    if(read_line(root, "online", line, sizeof(line)) < 0 || parse_cpulist(line, online) < 0) {
+        fprintf(stderr, "Topology: cannot read %s/online\n", root);
+        return -1;
+    }
+    if(read_line(root, "isolated", line, sizeof(line)) == 0)
+        parse_cpulist(line, isolated);
+    if(read_line(root, "nohz_full", line, sizeof(line)) == 0)
+        parse_cpulist(line, nohz_full);
+
+    for(cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        info = &topo->cpus[cpu];
+        info->online = online[cpu];
+        info->isolated = isolated[cpu];
+        info->nohz_full = nohz_full[cpu];
+        info->core = cpu;
+        info->llc = -1;
+        if(!online[cpu])
+            continue;
+
+        topo->ncpus = cpu + 1;
+        topo->nonline++;
+
+        snprintf(file, sizeof(file), "cpu%d/topology/physical_package_id", cpu);
+        if(read_line(root, file, line, sizeof(line)) == 0)
+            info->package = atoi(line);
+        snprintf(file, sizeof(file), "cpu%d/topology/thread_siblings_list", cpu);
+        if(read_line(root, file, line, sizeof(line)) == 0 && (lowest = parse_cpulist(line, NULL)) >= 0)
+            info->core = lowest;
+        if(info->core == cpu)
+            topo->ncores++;
+        read_caches(root, cpu, info);
+    }
+    return 0;
+}
+
+static bool cpu_isolated(const topology_t *topo, int cpu) {
+    return topo->cpus[cpu].isolated || topo->cpus[cpu].nohz_full;
+}
+
+// a core counts as isolated if any of its SMT siblings is
+static bool core_isolated(const topology_t *topo, int core) {
+    int cpu;
+
+    for(cpu = core; cpu < topo->ncpus; cpu++) {
+        if(topo->cpus[cpu].online && topo->cpus[cpu].core == core && cpu_isolated(topo, cpu))
+            return true;
+    }
+    return false;
+}
+
+// the CPU of a core a real-time service runs on, an isolated sibling if any
+static int core_cpu(const topology_t *topo, int core) {
+    int cpu;
+
+    for(cpu = core; cpu < topo->ncpus; cpu++) {
+        if(topo->cpus[cpu].online && topo->cpus[cpu].core == core && cpu_isolated(topo, cpu))
+            return cpu;
+    }
+    return core;
+}
+
+void topology_plan(const topology_t *topo, topology_plan_t *plan) {
+    int cores[TOPOLOGY_MAX_CPUS], candidates[TOPOLOGY_MAX_CPUS];
+    int ncores = 0, ncandidates = 0, housekeeping = -1;
+    int i, j, cpu, llc, best_llc = -1, best_count = -1, count, next = 0;
+    const topology_cpu_t *info;
+
+    memset(plan, 0, sizeof(topology_plan_t));
+
+    // one representative CPU per physical core
+    for(cpu = 0; cpu < topo->ncpus; cpu++) {
+        info = &topo->cpus[cpu];
+        if(info->online && info->core == cpu)
+            cores[ncores++] = cpu;
+    }
+    if(ncores == 0)
+        cores[ncores++] = 0;
+
+    for(i = 0; i < ncores && housekeeping < 0; i++) {
+        if(!cpu_isolated(topo, cores[i]))
+            housekeeping = cores[i];
+    }
+    if(housekeeping < 0)
+        housekeeping = cores[0];
+
+    // the cache with the most cores for the pipeline, isolated ones count double
+    for(i = 0; i < ncores; i++) {
+        llc = topo->cpus[cores[i]].llc;
+        count = 0;
+        for(j = 0; j < ncores; j++) {
+            if(cores[j] != housekeeping && topo->cpus[cores[j]].llc == llc)
+                count += core_isolated(topo, cores[j]) ? 2 : 1;
+        }
+        if(count > best_count) {
+            best_count = count;
+            best_llc = llc;
+        }
+    }
+
+    // isolated cores of that cache, then its other cores
+    for(i = 0; i < ncores; i++) {
+        if(cores[i] != housekeeping && topo->cpus[cores[i]].llc == best_llc && core_isolated(topo, cores[i]))
+            candidates[ncandidates++] = cores[i];
+    }
+    for(i = 0; i < ncores; i++) {
+        if(cores[i] != housekeeping && topo->cpus[cores[i]].llc == best_llc && !core_isolated(topo, cores[i]))
+            candidates[ncandidates++] = cores[i];
+    }
+
+    plan->sequencer = housekeeping;
+    plan->capture = (next < ncandidates) ? core_cpu(topo, candidates[next++]) : housekeeping;
+    plan->differencing = (next < ncandidates) ? core_cpu(topo, candidates[next++]) : plan->capture;
+    plan->selection = plan->differencing;
+
+    // the writer is best effort, it may use every SMT sibling of its cores
+    for(; next < ncandidates; next++) {
+        for(cpu = 0; cpu < topo->ncpus; cpu++) {
+            if(topo->cpus[cpu].online && topo->cpus[cpu].core == candidates[next])
+                plan->writer[plan->nwriter++] = cpu;
+        }
+    }
+    // then the cores outside that cache, the housekeeping core last
+    if(plan->nwriter == 0) {
+        for(cpu = 0; cpu < topo->ncpus; cpu++) {
+            info = &topo->cpus[cpu];
+            if(info->online && info->core != housekeeping && topo->cpus[info->core].llc != best_llc)
+                plan->writer[plan->nwriter++] = cpu;
+        }
+    }
+    if(plan->nwriter == 0)
+        plan->writer[plan->nwriter++] = housekeeping;
+}
+
+static void print_mask(const topology_t *topo, const char *label, bool isolated) {
+    int cpu, count = 0;
+
+    printf("  %s:", label);
+    for(cpu = 0; cpu < topo->ncpus; cpu++) {
+        if(topo->cpus[cpu].online && (isolated ? topo->cpus[cpu].isolated : topo->cpus[cpu].nohz_full)) {
+            printf(" %d", cpu);
+            count++;
+        }
+    }
+    printf("%s\n", count ? "" : " none");
+}
+
+static const char *core_note(const topology_t *topo, int cpu) {
+    if(topo->cpus[cpu].isolated)
+        return "isolated";
+    if(topo->cpus[cpu].nohz_full)
+        return "nohz_full";
+    return "shared with the kernel";
+}
+
+void topology_print(const topology_t *topo, const topology_plan_t *plan) {
+    int cpu, i;
+    const topology_cpu_t *info;
+
+    printf("Topology: %d cpus online on %d physical cores\n", topo->nonline, topo->ncores);
+    printf("  %4s %4s %4s %4s %4s\n", "cpu", "pkg", "core", "llc", "lvl");
+    for(cpu = 0; cpu < topo->ncpus; cpu++) {
+        info = &topo->cpus[cpu];
+        if(info->online)
+            printf("  %4d %4d %4d %4d   L%d\n", cpu, info->package, info->core, info->llc, info->llc_level);
+    }
+    if(topo->nonline > 0 && topo->cpus[0].llc_level == 0)
+        printf("  no cache information, all cpus taken to share one cache\n");
+    print_mask(topo, "isolcpus", true);
+    print_mask(topo, "nohz_full", false);
+
+    printf("Placement plan:\n");
+    printf("  %-16s cpu %-4d housekeeping, %s\n", "sequencer", plan->sequencer,
+           core_note(topo, plan->sequencer));
+    printf("  %-16s cpu %-4d %s, llc %d\n", "capture", plan->capture,
+           core_note(topo, plan->capture), topo->cpus[plan->capture].llc);
+    printf("  %-16s cpu %-4d %s, llc %d\n", "differencing", plan->differencing,
+           core_note(topo, plan->differencing), topo->cpus[plan->differencing].llc);
+    printf("  %-16s cpu %-4d with differencing\n", "selection", plan->selection);
+    printf("  %-16s cpus ", "writeback");
+    for(i = 0; i < plan->nwriter; i++)
+        printf("%s%d", i ? "," : "", plan->writer[i]);
+    printf("\n");
+
+    syslog(LOG_INFO, "Placement: sequencer=%d capture=%d differencing=%d selection=%d writeback=%d..(%d cpus)",
+           plan->sequencer, plan->capture, plan->differencing, plan->selection, plan->writer[0], plan->nwriter);
+}
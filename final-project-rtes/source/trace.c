@@ -0,0 +1,232 @@
+/**
+*
+* This file contains the in-memory event tracer. Every service thread owns
+* a single producer ring of fixed size binary events, so recording an
+* event is a clock read and a few stores, without locks, formatting or
+* system calls. A drainer thread under SCHED_OTHER empties the rings into
+* the trace file every TRACE_DRAIN_MS, tools/tracedump turns it into text.
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "../includes/trace.h"
+#include "../includes/timesource.h"
+
+// for logging
+#include <syslog.h>
+
+typedef struct {
+  trace_record_t *events;
+  unsigned long long head;                     // written by the owner only
+  unsigned long long tail;                     // written by the drainer only
+  unsigned long long dropped;
+}trace_ring_t;
+
+static trace_ring_t rings[TRACE_MAX_RINGS];
+static trace_file_header_t header;
+static unsigned int nrings = 0;                 // published with a release store
+static __thread trace_ring_t *my_ring = NULL;
+
+static bool trace_enabled = false;
+static volatile bool drainer_running = false;
+static pthread_t drainer_thread;
+static FILE *trace_fp = NULL;
+static unsigned long long drained = 0;
+
+int trace_register(const char *name, int instance) {
+    unsigned int index;
+    trace_ring_t *ring;
+    trace_record_t *events;
+
+    if(!trace_enabled)
+        return -1;
+    if(my_ring != NULL)
+        return (int)(my_ring - rings);
+
+    index = __atomic_fetch_add(&nrings, 1, __ATOMIC_ACQ_REL);
+    if(index >= TRACE_MAX_RINGS) {
+        syslog(LOG_WARNING, "Trace: no ring left for %s", name);
+        return -1;
+    }
+    ring = &rings[index];
+    if(instance > 0)
+        snprintf(header.names[index], TRACE_NAME_LENGTH, "%s/%d", name, instance);
+    else
+        snprintf(header.names[index], TRACE_NAME_LENGTH, "%s", name);
+
+    // allocated and touched here, before the thread enters its loop, and
+    // published to the drainer once the name is set
+    events = (trace_record_t *)calloc(TRACE_RING_EVENTS, sizeof(trace_record_t));
+    if(events == NULL) {
+        syslog(LOG_WARNING, "Trace: no memory for the ring of %s", name);
+        return -1;
+    }
+    __atomic_store_n(&ring->events, events, __ATOMIC_RELEASE);
+    my_ring = ring;
+    return (int)index;
+}
+
+void trace_event(trace_event_t id, int32_t arg0, int64_t arg1, int64_t arg2) {
+    trace_ring_t *ring = my_ring;
+    trace_record_t *event;
+    unsigned long long head;
+
+    if(ring == NULL)
+        return;
+
+    head = ring->head;
+    if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_EVENTS) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event->ns = trace_now();
+    event->id = id;
+    event->ring = (uint16_t)(ring - rings);
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+    event->arg2 = arg2;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int64_t trace_now(void) {
+    struct timespec now;
+
+    timesource_gettime(&now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int trace_mutex_lock(pthread_mutex_t *mutex, trace_lock_t lock) {
+    int64_t start;
+    int rc;
+
+    if(my_ring == NULL)
+        return pthread_mutex_lock(mutex);
+    rc = pthread_mutex_trylock(mutex);
+    if(rc != EBUSY)
+        return rc;
+
+    start = trace_now();
+    rc = pthread_mutex_lock(mutex);
+    trace_event(TRACE_LOCK_WAIT, lock, trace_now() - start, 0);
+    return rc;
+}
+
+// write out what the owners published so far, in at most two pieces per ring
+static void drain_rings(void) {
+    unsigned int i, count;
+    unsigned long long head, tail, first, length;
+    trace_ring_t *ring;
+
+    count = __atomic_load_n(&nrings, __ATOMIC_ACQUIRE);
+    if(count > TRACE_MAX_RINGS)
+        count = TRACE_MAX_RINGS;
+
+    for(i = 0; i < count; i++) {
+        ring = &rings[i];
+        if(__atomic_load_n(&ring->events, __ATOMIC_ACQUIRE) == NULL)
+            continue;
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        tail = ring->tail;
+        while(tail != head) {
+            first = tail & (TRACE_RING_EVENTS - 1);
+            length = head - tail;
+            if(first + length > TRACE_RING_EVENTS)
+                length = TRACE_RING_EVENTS - first;
+            fwrite(&ring->events[first], sizeof(trace_record_t), length, trace_fp);
+            tail += length;
+            drained += length;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void *drainer(void *arg) {
+    struct timespec period = { 0, TRACE_DRAIN_MS * 1000000L };
+
+    (void)arg;
+    while(drainer_running) {
+        drain_rings();
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+int trace_open(const char *path) {
+    pthread_attr_t attr;
+    struct sched_param param;
+    int rc;
+
+    trace_fp = fopen(path, "wb");
+    if(trace_fp == NULL) {
+        fprintf(stderr, "Trace: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.virtual_time = timesource_is_virtual() ? 1 : 0;
+    fwrite(&header, sizeof(header), 1, trace_fp);
+
+    // the drainer must not inherit the real-time policy of main
+    param.sched_priority = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+
+    trace_enabled = true;
+    drainer_running = true;
+    rc = pthread_create(&drainer_thread, &attr, drainer, NULL);
+    pthread_attr_destroy(&attr);
+    if(rc != 0) {
+        fprintf(stderr, "Trace: pthread_create for the drainer: %s\n", strerror(rc));
+        trace_enabled = false;
+        drainer_running = false;
+        fclose(trace_fp);
+        trace_fp = NULL;
+        return -1;
+    }
+    syslog(LOG_INFO, "Trace: recording to %s", path);
+    return 0;
+}
+
+void trace_close(void) {
+    unsigned int i;
+    unsigned long long dropped = 0;
+
+    if(trace_fp == NULL)
+        return;
+
+    drainer_running = false;
+    pthread_join(drainer_thread, NULL);
+    drain_rings();
+
+    header.nrings = __atomic_load_n(&nrings, __ATOMIC_ACQUIRE);
+    if(header.nrings > TRACE_MAX_RINGS)
+        header.nrings = TRACE_MAX_RINGS;
+    for(i = 0; i < header.nrings; i++) {
+        header.dropped[i] = __atomic_load_n(&rings[i].dropped, __ATOMIC_RELAXED);
+        dropped += header.dropped[i];
+    }
+    fseek(trace_fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, trace_fp);
+    fclose(trace_fp);
+    trace_fp = NULL;
+
+    printf("Trace: %llu events from %u threads, %llu dropped\n", drained, header.nrings, dropped);
+    syslog(LOG_INFO, "Trace: %llu events from %u threads, %llu dropped", drained, header.nrings, dropped);
+}
@@ -21,26 +21,90 @@
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/utsname.h>
 #include "pthread.h"
+#include <semaphore.h>
+#include <signal.h>
 #include <linux/videodev2.h>
 #include "../includes/writeback.h"
 #include "../includes/circular_buff.h"
 #include "../includes/framecapture.h"
 #include "../includes/differencing.h"
+#include "../includes/frameio.h"
+#include "../includes/timesource.h"
+#include "../includes/trace.h"
 
 // for logging
 #include <syslog.h>
 
-char ppm_header[]="P6\n#9999999999 sec 9999999999 msec \n"HRES_STR" "VRES_STR"\n255\n \
-                    Linux raspberrypi 6.1.21-v8+ #1642 SMP PREEMPT Mon Apr  3 17:24:16 BST 2023 aarch64 GNU/Linux\n \
-                    999 99 999 9999 99999999 99 999";
-char ppm_dumpname[]="frames/test0000.ppm";
+#define HEADER_MAX_LENGTH   (512)
+#define WALLCLOCK_WIDTH     (40)              // padded width of the wall clock field
+#define DUMPNAME_TAG_OFFSET (11)              // "frames/test" -> 4 digit frame tag
+
+// Frame header template. Static fields (magic, uname, resolution) are
+// rendered once by init_frame_headers(), per-frame fields are patched in
+// place at the recorded offsets so no formatting is done per frame.
+typedef struct {
+    char text[HEADER_MAX_LENGTH];
+    int length;
+    int sec_offset;                           // 10 digit capture seconds
+    int msec_offset;                          // 10 digit capture milliseconds
+    int wallclock_offset;                     // WALLCLOCK_WIDTH chars of local time
+    char dumpname[32];                        // frames/test0000.ppm
+} frame_header_t;
+
+static frame_header_t ppm_template;
+static frame_header_t pgm_template;
+
+// per-worker copies of the templates, so workers patch their own header
+static __thread frame_header_t local_ppm;
+static __thread frame_header_t local_pgm;
+static __thread bool local_headers_ready = false;
 
 pthread_mutex_t sgl_fifo;
 
-char buffer[256];
-char date_result[1024] = "Sat 10 Aug 2024 06:54:07 PM MDT";                    // To store the final result
-FILE *fp;
+// Reorder buffer. Workers write frames concurrently and park them in the
+// slot for their frame count; frames are committed strictly in frame count
+// order, at most WRITEBACK_REORDER_DEPTH frames ahead of the oldest one.
+typedef struct {
+    bool ready;                               // frame prepared, waiting for its turn
+    int result;                               // bytes written, -1 on error
+    unsigned int frame_count;
+    char path[40];                            // staging file name while out of order
+    char dumpname[32];                        // name the frame is published under
+    unsigned char *stage;                     // planar frame waiting for the Y4M stream
+    int stage_length;
+    int64_t stage_ns[FRAME_STAGES];           // stage times copied from the frame buffer entry
+} reorder_slot_t;
+
+static reorder_slot_t reorder_slots[WRITEBACK_REORDER_DEPTH];
+static unsigned int next_commit = 1;          // frame counts start at 1 in frame_select()
+static unsigned long long frames_queued = 0;   // pushed, atomic, written under sgl_fifo
+static unsigned long long frames_committed = 0; // committed, atomic, written under sgl_reorder
+static unsigned long long frames_dropped = 0;  // queue full, selection is the only pusher
+static int fifo_high_water = 0;                // guarded by sgl_fifo
+static histogram_t writeback_latency;          // queued to committed
+
+// Per-frame latency. stage_latency[s] holds the time from the previous stage
+// the frame reached to stage s, stage_latency[FRAME_STAGE_CAPTURED] the time
+// from the capture to the commit.
+static histogram_t stage_latency[FRAME_STAGES];
+static FILE *latency_log = NULL;               // sidecar CSV, one line per committed frame
+static const char *stage_names[FRAME_STAGES] = {
+    "end-to-end", "convert", "difference", "select", "queue", "wait", "write", "commit"
+};
+static int writeback_workers = 1;
+pthread_mutex_t sgl_reorder = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  reorder_cond = PTHREAD_COND_INITIALIZER;
+sem_t sem_frames;                             // frames waiting in the FIFO
+
+// Y4M stream sink. Selected frames are appended to one YUV4MPEG2 stream
+// (regular file or named pipe) instead of one file per frame.
+#define Y4M_FRAME_MARKER    "FRAME\n"
+#define Y4M_STAGE_LENGTH    (HRES * VRES * 2)   // planar 4:2:2, the largest layout
+
+static int y4m_fd = -1;
+static unsigned long long y4m_frames = 0;
 
 typedef struct {
     cbuff_struct_t *data[MAX_FIFO_DEPTH];
@@ -56,52 +120,298 @@ void init_fifoQ(void) {
     memset(&fifo_queue,0,sizeof(fifo_queue_t));
 }
 
-static void dump_ppm(cbuff_struct_t *element) {
-    int written, i, total, dumpfd;
+void init_writeback_pool(int nworkers) {
+    int i;
+
+    if(nworkers < 1)
+        nworkers = 1;
+    if(nworkers > WRITEBACK_MAX_WORKERS)
+        nworkers = WRITEBACK_MAX_WORKERS;
+    writeback_workers = nworkers;
+
+    memset(reorder_slots, 0, sizeof(reorder_slots));
+    next_commit = 1;
+    histogram_reset(&writeback_latency);
+    for(i = 0; i < FRAME_STAGES; i++)
+        histogram_reset(&stage_latency[i]);
+    sem_init(&sem_frames, 0, 0);
+}
+
+int get_writeback_workers(void) {
+    return writeback_workers;
+}
+
+void stop_writeback_pool(void) {
+    int i;
+
+    // wake every worker blocked on an empty FIFO, async-signal-safe
+    for(i = 0; i < writeback_workers; i++)
+        sem_post(&sem_frames);
+}
 
-    unsigned char *p = &(element->buffer[0]);
-    int size = element->size;
-    unsigned int tag = element->frame_count;
-    struct timespec *time = &(element->timestamp);
+static void patch_digits(char *dst, unsigned long value, int width) {
+    int i;
+
+    for(i = width - 1; i >= 0; i--) {
+        dst[i] = '0' + (value % 10);
+        value /= 10;
+    }
+}
 
-    // printf("dump ppm: size=%d framecount=%d time=%d\n", size, tag, 
-    //                                                 time->tv_sec);
+static void render_template(frame_header_t *header, const char *magic, const char *ext, 
+                            const struct utsname *uts) {
+    int len;
+
+    len = snprintf(header->text, sizeof(header->text), "%s\n#", magic);
+    header->sec_offset = len;
+    len += snprintf(&header->text[len], sizeof(header->text) - len, "0000000000 sec ");
+    header->msec_offset = len;
+    len += snprintf(&header->text[len], sizeof(header->text) - len, "0000000000 msec \n");
+    len += snprintf(&header->text[len], sizeof(header->text) - len, "# %s %s %s %s %s\n# ",
+                    uts->sysname, uts->nodename, uts->release, uts->version, uts->machine);
+    header->wallclock_offset = len;
+    len += snprintf(&header->text[len], sizeof(header->text) - len, "%-*s\n%s %s\n255\n",
+                    WALLCLOCK_WIDTH, "", HRES_STR, VRES_STR);
+    if(len >= (int)sizeof(header->text))
+        len = sizeof(header->text) - 1;
+    header->length = len;
+
+    snprintf(header->dumpname, sizeof(header->dumpname), "frames/test0000.%s", ext);
+}
+
+void init_frame_headers(void) {
+    struct utsname uts;
+
+    if(uname(&uts) < 0) {
+        perror("uname");
+        memset(&uts, 0, sizeof(uts));
+    }
+    // load the timezone once, localtime_r() does not reload it per frame
+    tzset();
 
-    snprintf(&ppm_dumpname[11], 9, "%04d", tag);
-    strncat(&ppm_dumpname[15], ".ppm", 5);
-    dumpfd = open(ppm_dumpname, O_WRONLY | O_NONBLOCK | O_CREAT, 00666);
+    render_template(&ppm_template, "P6", "ppm", &uts);
+    render_template(&pgm_template, "P5", "pgm", &uts);
+}
 
-    snprintf(&ppm_header[4], 11, "%010d", (int)time->tv_sec);
-    strncat(&ppm_header[14], " sec ", 5);
-    snprintf(&ppm_header[19], 11, "%010d", (int)((time->tv_nsec)/1000000));
-    strncat(&ppm_header[29], " msec \n"HRES_STR" "VRES_STR"\n255\n", 19);
-    strncat(&ppm_header[48], "Linux raspberrypi 6.1.21-v8+ #1642 SMP PREEMPT Mon Apr  3 17:24:16 BST 2023 aarch64 GNU/Linux\n", 94);
-    strncat(&ppm_header[142], date_result, sizeof(date_result));
+static void patch_header(frame_header_t *header, cbuff_struct_t *element) {
+    struct timespec wall;
+    struct tm tm_wall;
+    char wallclock[WALLCLOCK_WIDTH + 1];
+    size_t len;
 
-    written=write(dumpfd, ppm_header, sizeof(ppm_header));
+    patch_digits(&header->text[header->sec_offset], element->timestamp.tv_sec, 10);
+    patch_digits(&header->text[header->msec_offset], element->timestamp.tv_nsec / 1000000, 10);
+    patch_digits(&header->dumpname[DUMPNAME_TAG_OFFSET], element->frame_count, 4);
 
-    total=0;
+    // wall clock from the vDSO, replaces popen("date"). A replay takes it
+    // from the frame timestamp so its output does not depend on the date.
+    timesource_wallclock(&element->timestamp, &wall);
+    localtime_r(&wall.tv_sec, &tm_wall);
+    len = strftime(wallclock, sizeof(wallclock), "%a %d %b %Y %I:%M:%S %p %Z", &tm_wall);
+    memset(&header->text[header->wallclock_offset], ' ', WALLCLOCK_WIDTH);
+    memcpy(&header->text[header->wallclock_offset], wallclock, len);
+}
 
-    syslog(LOG_INFO,"Starting frame writes to memory");
+static int write_stream(int fd, const unsigned char *p, int size) {
+    int written, total = 0;
 
     do {
-        written=write(dumpfd, p, size);
-        //printf("written bytes %d\n", written);
-        total+=written;
+        written = write(fd, p + total, size - total);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += written;
     } while(total < size);
 
+    return total;
+}
+
+int init_y4m_sink(const char *path) {
+    char header[128];
+    int i, len;
+    frame_format_t format = get_frame_format();
+
+    // the capture format stays as configured for differencing and
+    // selection, an RGB pipeline keeps the camera YUYV next to each frame
+    // (keep_native_frames()) and stage_y4m() splits that
+    for(i = 0; i < WRITEBACK_REORDER_DEPTH; i++) {
+        reorder_slots[i].stage = malloc(Y4M_STAGE_LENGTH);
+        if(reorder_slots[i].stage == NULL) {
+            fprintf(stderr, "Out of memory for the Y4M staging buffers\n");
+            return -1;
+        }
+    }
+
+    // a reader closing the pipe must not kill the pipeline
+    signal(SIGPIPE, SIG_IGN);
+
+    // opening a named pipe blocks until the consumer (e.g. ffmpeg) opens it
+    y4m_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    if(y4m_fd < 0) {
+        fprintf(stderr, "Cannot open Y4M stream '%s': %d, %s\n", path, errno, strerror(errno));
+        return -1;
+    }
+
+    len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 %s\n",
+                   HRES, VRES, (int)FRAME_SELECTION_RATE_HZ,
+                   (format == FRAME_FORMAT_GRAY) ? "Cmono" : "C422");
+    if(write_stream(y4m_fd, (unsigned char *)header, len) < 0) {
+        close(y4m_fd);
+        y4m_fd = -1;
+        return -1;
+    }
+
+    syslog(LOG_INFO, "Y4M stream sink opened on %s", path);
+    return 0;
+}
+
+void close_y4m_sink(void) {
+    if(y4m_fd >= 0) {
+        close(y4m_fd);
+        y4m_fd = -1;
+        printf("Y4M stream: %llu frames appended\n", y4m_frames);
+    }
+}
+
+// copy the luma of a gray frame, or split the packed YUYV kept next to an
+// RGB frame into the Y, U and V planes of a 4:2:2 Y4M frame
+static int stage_y4m(cbuff_struct_t *element, unsigned char *stage) {
+    int i, pixels;
+    unsigned char *y, *u, *v;
+    unsigned char *p = element->native;
+
+    if(element->format == FRAME_FORMAT_GRAY) {
+        memcpy(stage, element->buffer, element->size);
+        return element->size;
+    }
+    if(p == NULL)
+        return -1;
+
+    pixels = NATIVE_FRAME_LENGTH / 2;
+    y = stage;
+    u = y + pixels;
+    v = u + (pixels / 2);
+    for(i = 0; i < NATIVE_FRAME_LENGTH; i = i + 4) {
+        *y++ = p[i];
+        *u++ = p[i+1];
+        *y++ = p[i+2];
+        *v++ = p[i+3];
+    }
+    return NATIVE_FRAME_LENGTH;
+}
+
+static int dump_frame(cbuff_struct_t *element, reorder_slot_t *slot) {
+    int total;
+    int64_t start_ns;
+    frame_header_t *header;
+
+    if(y4m_fd >= 0) {
+        // the frame is appended to the stream when it commits
+        slot->stage_length = stage_y4m(element, slot->stage);
+        return slot->stage_length;
+    }
+
+    if(!local_headers_ready) {
+        memcpy(&local_ppm, &ppm_template, sizeof(frame_header_t));
+        memcpy(&local_pgm, &pgm_template, sizeof(frame_header_t));
+        local_headers_ready = true;
+    }
+    header = (element->format == FRAME_FORMAT_GRAY) ? &local_pgm : &local_ppm;
+    patch_header(header, element);
+
+    // with several workers the frame is staged under a temporary name and
+    // only published under its real name when its turn to commit comes
+    memcpy(slot->dumpname, header->dumpname, sizeof(slot->dumpname));
+    if(writeback_workers > 1)
+        snprintf(slot->path, sizeof(slot->path), "%s.part", header->dumpname);
+    else
+        memcpy(slot->path, header->dumpname, sizeof(slot->dumpname));
+
+    start_ns = trace_now();
+    total = frameio_write(slot->path, header->text, header->length,
+                          element->buffer, element->size);
+
     //printf("wrote %d bytes\n", total);
-    syslog(LOG_INFO, "wrote %d bytes\n", total);
+    trace_event(TRACE_FRAME_WRITTEN, element->frame_count, trace_now() - start_ns, total);
+    return total;
+}
+
+// record the stage breakdown of a committed frame, called with sgl_reorder held
+static void record_frame_latency(const reorder_slot_t *slot) {
+    const int64_t *stage_ns = slot->stage_ns;
+    int64_t previous = stage_ns[FRAME_STAGE_CAPTURED];
+    int s;
+
+    histogram_record(&writeback_latency, stage_ns[FRAME_STAGE_COMMITTED] - stage_ns[FRAME_STAGE_QUEUED]);
+    histogram_record(&stage_latency[FRAME_STAGE_CAPTURED], stage_ns[FRAME_STAGE_COMMITTED] - previous);
+    if(latency_log != NULL)
+        fprintf(latency_log, "%u,%lld", slot->frame_count, (long long)previous);
+
+    // a stage the frame skipped, such as the difference of the first frame, is folded into the next
+    for(s = FRAME_STAGE_STORED; s < FRAME_STAGES; s++) {
+        if(stage_ns[s] == 0) {
+            if(latency_log != NULL)
+                fprintf(latency_log, ",");
+            continue;
+        }
+        histogram_record(&stage_latency[s], stage_ns[s] - previous);
+        if(latency_log != NULL)
+            fprintf(latency_log, ",%.3f", (stage_ns[s] - previous) / 1000.0);
+        previous = stage_ns[s];
+    }
+    if(latency_log != NULL)
+        fprintf(latency_log, ",%.3f\n", (stage_ns[FRAME_STAGE_COMMITTED] - stage_ns[FRAME_STAGE_CAPTURED]) / 1000.0);
+}
+
+// commit every frame that is next in order, must be called with sgl_reorder held.
+// The commit time is read by the caller before taking the lock, trace_now()
+// takes the time lock in a simulation run.
+static int commit_frames(int64_t now_ns) {
+    int committed = 0;
+    reorder_slot_t *slot = &reorder_slots[next_commit % WRITEBACK_REORDER_DEPTH];
+
+    while(slot->ready && (slot->frame_count == next_commit)) {
+        if((y4m_fd >= 0) && (slot->result > 0)) {
+            if(write_stream(y4m_fd, (unsigned char *)Y4M_FRAME_MARKER, sizeof(Y4M_FRAME_MARKER) - 1) < 0 ||
+               write_stream(y4m_fd, slot->stage, slot->stage_length) < 0) {
+                syslog(LOG_ERR, "Y4M stream write failed: %s", strerror(errno));
+                slot->result = -1;
+            } else {
+                y4m_frames++;
+            }
+        } else if((writeback_workers > 1) && (slot->result > 0)) {
+            rename(slot->path, slot->dumpname);
+        }
+
+        if(slot->result > 0) {
+            slot->stage_ns[FRAME_STAGE_COMMITTED] = now_ns;
+            record_frame_latency(slot);
+        }
+        printf("Write-back: frame %d written to memory\n", slot->frame_count);
+        trace_event(TRACE_FRAME_COMMIT, slot->frame_count, slot->result, 0);
 
-    close(dumpfd);
+        slot->ready = false;
+        next_commit++;
+        committed++;
+        __atomic_add_fetch(&frames_committed, 1, __ATOMIC_RELEASE);
+        slot = &reorder_slots[next_commit % WRITEBACK_REORDER_DEPTH];
+    }
+    if(committed)
+        pthread_cond_broadcast(&reorder_cond);
+
+    return committed;
 }
 
 // Push an element into the queue
 int push_frame_fifo(cbuff_struct_t *element) {
     if(fifo_queue.count == MAX_FIFO_DEPTH) {
         // Queue is full
+        __atomic_store_n(&frames_dropped, frames_dropped + 1, __ATOMIC_RELAXED);
         return -1;
     }
+    element->stage_ns[FRAME_STAGE_QUEUED] = trace_now();
     fifo_queue.data[fifo_queue.rear] = element;
     // memcpy(&(fifo_queue.data[fifo_queue.rear].buffer), element->buffer, element->size);
     // fifo_queue.data[fifo_queue.rear].size = element->size;
@@ -113,9 +423,13 @@ int push_frame_fifo(cbuff_struct_t *element) {
     //                                                 fifo_queue.data[fifo_queue.rear].timestamp.tv_sec);
     fifo_queue.rear = (fifo_queue.rear + 1) % MAX_FIFO_DEPTH;
 
-    pthread_mutex_lock(&sgl_fifo);
+    trace_mutex_lock(&sgl_fifo, TRACE_LOCK_FIFO);
     fifo_queue.count++;
+    __atomic_add_fetch(&frames_queued, 1, __ATOMIC_RELEASE);
+    if(fifo_queue.count > fifo_high_water)
+        fifo_high_water = fifo_queue.count;
     pthread_mutex_unlock(&sgl_fifo);
+    sem_post(&sem_frames);
     //printf("Push: front=%d rear=%d count=%d\n", fifo_queue.front, fifo_queue.rear, fifo_queue.count);
     return 0;
 }
@@ -123,14 +437,15 @@ int push_frame_fifo(cbuff_struct_t *element) {
 cbuff_struct_t *pop_frame_fifo(void) {
     cbuff_struct_t *ret = NULL;
 
+    // several workers may pop concurrently, so front is moved under the lock
+    trace_mutex_lock(&sgl_fifo, TRACE_LOCK_FIFO);
     if(fifo_queue.count == 0) {
         // Queue is empty
+        pthread_mutex_unlock(&sgl_fifo);
         return NULL;
     }
     ret = fifo_queue.data[fifo_queue.front];
     fifo_queue.front = (fifo_queue.front + 1) % MAX_FIFO_DEPTH;
-
-    pthread_mutex_lock(&sgl_fifo);
     fifo_queue.count--;
     pthread_mutex_unlock(&sgl_fifo);
 
@@ -138,36 +453,107 @@ cbuff_struct_t *pop_frame_fifo(void) {
     return ret;
  }
 
-void get_sys_timestamp(void) {
-    fp = popen("date", "r");
-    if (fp == NULL) {
-        perror("popen failed");
-        return;
-    }
-
-    // Read the output a line at a time - output it and store it in uname_result
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        strncat(date_result, buffer, sizeof(date_result) - strlen(date_result) - 1);
-    }
-
-    // Close the file pointer
-    pclose(fp);
-}
-
 int writeback(void) {
     int ret = -1;
+    unsigned int frame_count;
+    reorder_slot_t *slot;
     cbuff_struct_t *local_data;
-    
+    int64_t dequeued_ns, commit_ns;
+
+    // block until frame_select() pushes a frame or the pool is stopped
+    while(sem_wait(&sem_frames) != 0 && errno == EINTR);
+
     local_data = pop_frame_fifo();
 
     if(local_data != NULL) {
+        dequeued_ns = trace_now();
         //print_cbuf_info();
-        get_sys_timestamp();
-        dump_ppm(local_data);
-        printf("Write-back: frame %d written to memory\n", local_data->frame_count);
-        syslog(LOG_INFO,"Write-back: frame %d written to memory\n", local_data->frame_count);
-        ret = 1;
+        frame_count = local_data->frame_count;
+
+        // bound the frames in flight to the reorder window
+        trace_mutex_lock(&sgl_reorder, TRACE_LOCK_REORDER);
+        while(frame_count >= next_commit + WRITEBACK_REORDER_DEPTH)
+            pthread_cond_wait(&reorder_cond, &sgl_reorder);
+        pthread_mutex_unlock(&sgl_reorder);
+
+        slot = &reorder_slots[frame_count % WRITEBACK_REORDER_DEPTH];
+        memcpy(slot->stage_ns, local_data->stage_ns, sizeof(slot->stage_ns));
+        slot->stage_ns[FRAME_STAGE_DEQUEUED] = dequeued_ns;
+        slot->result = dump_frame(local_data, slot);
+        slot->stage_ns[FRAME_STAGE_WRITTEN] = trace_now();
+        slot->frame_count = frame_count;
+
+        commit_ns = trace_now();
+        trace_mutex_lock(&sgl_reorder, TRACE_LOCK_REORDER);
+        slot->ready = true;
+        ret = commit_frames(commit_ns);
+        pthread_mutex_unlock(&sgl_reorder);
+
+        // a simulation run waits for the queue to drain before moving on
+        if(ret > 0)
+            timesource_notify();
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+int writeback_pending(void) {
+    unsigned long long queued, committed;
+
+    // lock free, the sequencer calls it with the time lock held. No frame
+    // is pushed while the caller waits, read the queue side first.
+    queued = __atomic_load_n(&frames_queued, __ATOMIC_ACQUIRE);
+    committed = __atomic_load_n(&frames_committed, __ATOMIC_ACQUIRE);
+
+    return (int)(queued - committed);
+}
+
+void writeback_get_stats(writeback_stats_t *stats) {
+    // plain loads, a monitor may see one counter a frame ahead of another
+    stats->queued = __atomic_load_n(&frames_queued, __ATOMIC_RELAXED);
+    stats->committed = __atomic_load_n(&frames_committed, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&frames_dropped, __ATOMIC_RELAXED);
+    stats->fifo_depth = __atomic_load_n(&fifo_queue.count, __ATOMIC_RELAXED);
+    stats->fifo_high_water = __atomic_load_n(&fifo_high_water, __ATOMIC_RELAXED);
+    stats->latency = &writeback_latency;
+}
+
+int init_latency_log(const char *path) {
+    latency_log = fopen(path, "w");
+    if(latency_log == NULL) {
+        fprintf(stderr, "Latency log: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    // stage columns hold the time since the previous stage the frame reached, in us
+    fprintf(latency_log, "frame,captured_ns,convert_us,difference_us,select_us,queue_us,wait_us,write_us,commit_us,total_us\n");
+    syslog(LOG_INFO, "Latency log: writing the per-frame breakdown to %s", path);
+    return 0;
+}
+
+void close_latency_log(void) {
+    if(latency_log == NULL)
+        return;
+    fclose(latency_log);
+    latency_log = NULL;
+}
+
+void writeback_report_latency(void) {
+    histogram_summary_t s;
+    int i;
+
+    printf("Frame latency by stage (us):\n");
+    printf("  %-12s %9s %9s %9s %9s %9s %9s %9s %9s\n", "stage", "count",
+           "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for(i = 0; i < FRAME_STAGES; i++) {
+        // the capture to commit line goes last, below the stages it adds up
+        histogram_summarize(&stage_latency[(i + 1) % FRAME_STAGES], &s);
+        if(s.count == 0)
+            continue;
+        printf("  %-12s %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", stage_names[(i + 1) % FRAME_STAGES],
+               (unsigned long long)s.count, s.min / 1000.0, s.mean / 1000.0, s.p50 / 1000.0,
+               s.p90 / 1000.0, s.p99 / 1000.0, s.p999 / 1000.0, s.max / 1000.0);
+        syslog(LOG_INFO, "Frame latency %s: n=%llu min=%lld p50=%lld p99=%lld p99.9=%lld max=%lld ns",
+               stage_names[(i + 1) % FRAME_STAGES], (unsigned long long)s.count, (long long)s.min,
+               (long long)s.p50, (long long)s.p99, (long long)s.p999, (long long)s.max);
+    }
+}
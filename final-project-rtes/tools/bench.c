@@ -0,0 +1,473 @@
+/**
+*
+* This is the microbenchmark of the pipeline kernels: the YUYV to RGB and
+* luma conversions of the capture, the frame difference, the circular
+* buffer and writeback queue bookkeeping and the frame file write. The
+* kernels are linked from the sources the pipeline runs, and fed the same
+* fixtures on every run, frames of a recording loaded through the replay
+* source in the format each kernel sees in the pipeline.
+*
+* Every kernel is warmed up, then timed in SAMPLES samples of FRAMES frames
+* on one pinned CPU. The report gives ns/frame (mean, min, median, standard
+* deviation, coefficient of variation), frames per second and GB/s over the
+* frame bytes the kernel reads and writes, as a table, CSV or JSON.
+*
+* Usage: bench [-f DIR] [-k KERNELS] [-n FRAMES] [-s SAMPLES] [-w FRAMES]
+*              [-c CPU] [-p PRIO] [-d DIR] [-l LABEL] [-C|-j]
+*   -f DIR      recording the fixtures are taken from [../frames@10Hz]
+*   -k KERNELS  comma separated kernels to run, e.g. yuv2rgb,diff [all]
+*   -n FRAMES   frames per sample [200]
+*   -s SAMPLES  samples per kernel [10]
+*   -w FRAMES   warm-up frames before the first sample [50]
+*   -c CPU      CPU to pin the benchmark to [last online CPU]
+*   -p PRIO     run SCHED_FIFO at PRIO, needs CAP_SYS_NICE
+*   -d DIR      directory the write kernels write to [a new directory in /tmp]
+*   -l LABEL    label of the run, e.g. the kernel variant under test
+*   -C          CSV, one line per kernel
+*   -j          JSON
+*
+* Build: make bench (or make tools/bench BENCH_CFLAGS="-O3 -march=native")
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../includes/circular_buff.h"
+#include "../includes/framecapture.h"
+#include "../includes/differencing.h"
+#include "../includes/writeback.h"
+#include "../includes/frameio.h"
+#include "../includes/replay.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS           "unknown"
+#endif
+
+#define BENCH_FIXTURES         (16)             // frames taken evenly over the recording
+#define BENCH_MAX_SAMPLES      (1000)
+#define BENCH_DUMP_FILES       (8)              // file names the write kernels cycle through
+#define BENCH_FRAME_PERIOD_NS  (100000000LL)    // the recordings are taken at 10 Hz
+
+#define YUYV_SIZE              (HRES * VRES * 2)
+#define RGB_SIZE               (HRES * VRES * 3)
+#define GRAY_SIZE              (HRES * VRES)
+
+// defined by main.c and sequencer.c in the pipeline
+unsigned char *previous_frame;
+unsigned char *new_frame;
+double start_realtime;
+extern int garbage_frames;
+
+double realtime(struct timespec *tsptr) {
+    return ((double)(tsptr->tv_sec) + (((double)tsptr->tv_nsec)/1000000000.0));
+}
+
+typedef enum {
+  OUTPUT_TABLE,
+  OUTPUT_CSV,
+  OUTPUT_JSON
+}output_t;
+
+typedef struct {
+  const char *name;
+  const char *desc;
+  long bytes;                                  // frame bytes read and written per frame
+  int (*setup)(void);                          // NULL if nothing to prepare, -1 to skip the kernel
+  void (*run)(int frame);
+  void (*teardown)(void);
+}kernel_t;
+
+static cbuff_struct_t *rgb_fixtures;           // with the YUYV kept next to each frame
+static cbuff_struct_t *gray_fixtures;
+static int nfixtures;
+static unsigned char *out;                     // output buffer of the conversions
+static cbuff_struct_t *ring;                   // QUEUE_DEPTH entries for the circular buffer kernel
+static char dump_dir[256];
+static char dump_header[128];
+static int dump_header_length;
+static volatile unsigned long sink;            // keeps the kernel results alive
+static unsigned long cbuf_stalls;              // pointer moves the circular buffer refused
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(MY_CLOCK, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// frames of the recording in one format, stored by the replay capture path
+static cbuff_struct_t *load_fixtures(frame_format_t format, long long step_ns, bool native) {
+    cbuff_struct_t *fixtures;
+    int i;
+
+    fixtures = calloc(nfixtures, sizeof(cbuff_struct_t));
+    if(fixtures == NULL)
+        return NULL;
+    if(native && (keep_native_frames(fixtures, nfixtures) < 0)) {
+        free(fixtures);
+        return NULL;
+    }
+    set_frame_format(format);
+    garbage_frames = 0;
+    reset_queue();
+    for(i = 0; i < nfixtures; i++)
+        read_replay_frame(fixtures, i * step_ns);
+    reset_queue();
+    return fixtures;
+}
+
+static void run_yuv2rgb(int frame) {
+    process_image(rgb_fixtures[frame % nfixtures].native, YUYV_SIZE, out);
+    sink += out[frame % RGB_SIZE];
+}
+
+static void run_yuyv2gray(int frame) {
+    process_image_gray(rgb_fixtures[frame % nfixtures].native, YUYV_SIZE, out);
+    sink += out[frame % GRAY_SIZE];
+}
+
+static void run_diff(int frame) {
+    sink += perform_diff(rgb_fixtures[frame % nfixtures].buffer,
+                         rgb_fixtures[(frame + nfixtures - 1) % nfixtures].buffer, RGB_SIZE, 1);
+}
+
+static void run_diff_stride4(int frame) {
+    sink += perform_diff(rgb_fixtures[frame % nfixtures].buffer,
+                         rgb_fixtures[(frame + nfixtures - 1) % nfixtures].buffer, RGB_SIZE, 4);
+}
+
+static void run_diff_gray(int frame) {
+    sink += perform_diff(gray_fixtures[frame % nfixtures].buffer,
+                         gray_fixtures[(frame + nfixtures - 1) % nfixtures].buffer, GRAY_SIZE, 1);
+}
+
+// the circular buffer holds QUEUE_DEPTH full frames, only the entry
+// headers are touched, so the pages of the frame data are never faulted in
+static int setup_cbuf(void) {
+    struct timespec ts = { 0, 0 };
+
+    if(ring == NULL)
+        ring = malloc(sizeof(cbuff_struct_t) * QUEUE_DEPTH);
+    if(ring == NULL)
+        return -1;
+    for(int i = 0; i < QUEUE_DEPTH; i++)
+        memset(&ring[i], 0, offsetof(cbuff_struct_t, buffer));
+    reset_queue();
+    cbuf_stalls = 0;
+    // differencing runs one frame behind capture, selection one behind differencing
+    write_size_and_time(ring, RGB_SIZE, &ts);
+    write_size_and_time(ring, RGB_SIZE, &ts);
+    return 0;
+}
+
+// capture stores a frame, differencing marks one, selection consumes one
+static void run_cbuf(int frame) {
+    struct timespec ts = { frame, 0 };
+    cbuff_struct_t *entry;
+    unsigned char *p;
+    int size;
+
+    circular_buff_lock();
+    entry = get_wptr(ring);
+    entry->format = FRAME_FORMAT_RGB;
+    write_stage_time(ring, WRITE_POINTER, FRAME_STAGE_STORED, frame);
+    write_size_and_time(ring, RGB_SIZE, &ts);
+    circular_buff_unlock();
+
+    circular_buff_lock();
+    p = read_frame_ptr(ring, READ_DIFF_POINTER, &size);
+    write_usefulness(ring, 1);
+    circular_buff_unlock();
+
+    circular_buff_lock();
+    p = read_frame_ptr(ring, READ_SEL_POINTER, &size);
+    write_framecount(ring, frame);
+    if(!nextPtr(READ_SEL_POINTER))
+        cbuf_stalls++;
+    circular_buff_unlock();
+    sink += (unsigned long)p + size;
+}
+
+static int setup_fifo(void) {
+    init_fifoQ();
+    init_writeback_pool(1);
+    return 0;
+}
+
+// selection pushes, a writeback worker pops
+static void run_fifo(int frame) {
+    push_frame_fifo(&rgb_fixtures[frame % nfixtures]);
+    sink += (unsigned long)pop_frame_fifo();
+}
+
+static int setup_dump(frameio_mode_t mode) {
+    frameio_init(mode, 0);
+    dump_header_length = snprintf(dump_header, sizeof(dump_header),
+                                  "P6\n#0000000000 sec 0000000000 msec \n# bench\n%s %s\n255\n",
+                                  HRES_STR, VRES_STR);
+    return 0;
+}
+
+static int setup_dump_buffered(void) {
+    return setup_dump(FRAMEIO_BUFFERED);
+}
+
+static int setup_dump_direct(void) {
+    return setup_dump(FRAMEIO_DIRECT);
+}
+
+static void run_dump(int frame) {
+    char path[sizeof(dump_dir) + 32];
+
+    snprintf(path, sizeof(path), "%s/test%04d.ppm", dump_dir, frame % BENCH_DUMP_FILES);
+    sink += frameio_write(path, dump_header, dump_header_length,
+                          rgb_fixtures[frame % nfixtures].buffer, RGB_SIZE);
+}
+
+static void teardown_dump(void) {
+    frameio_stats_t stats;
+
+    frameio_flush();
+    frameio_get_stats(&stats);
+    if(stats.direct_fallbacks > 0)
+        fprintf(stderr, "bench: %s refuses O_DIRECT, dump_direct wrote through the page cache\n", dump_dir);
+}
+
+static const kernel_t kernels[] = {
+  { "yuv2rgb",      "process_image, YUYV to RGB24",        YUYV_SIZE + RGB_SIZE,  NULL,                run_yuv2rgb,      NULL },
+  { "yuyv2gray",    "process_image_gray, Y plane",         YUYV_SIZE + GRAY_SIZE, NULL,                run_yuyv2gray,    NULL },
+  { "diff",         "perform_diff, RGB, stride 1",         2 * RGB_SIZE,          NULL,                run_diff,         NULL },
+  { "diff_stride4", "perform_diff, RGB, stride 4",         2 * RGB_SIZE,          NULL,                run_diff_stride4, NULL },
+  { "diff_gray",    "perform_diff, gray, stride 1",        2 * GRAY_SIZE,         NULL,                run_diff_gray,    NULL },
+  { "cbuf",         "circular buffer store/mark/select",   0,                     setup_cbuf,          run_cbuf,         NULL },
+  { "fifo",         "writeback queue push/pop",            0,                     setup_fifo,          run_fifo,         NULL },
+  { "dump",         "frameio_write of a PPM, buffered",    RGB_SIZE,              setup_dump_buffered, run_dump,         teardown_dump },
+  { "dump_direct",  "frameio_write of a PPM, O_DIRECT",    RGB_SIZE,              setup_dump_direct,   run_dump,         teardown_dump }
+};
+#define NKERNELS  ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+typedef struct {
+  double mean, min, median, stddev;            // ns per frame
+}result_t;
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void measure(const kernel_t *k, int frames, int samples, int warmup, result_t *res) {
+    double ns[BENCH_MAX_SAMPLES], sum = 0.0, sq = 0.0;
+    int64_t start;
+    int s, i, frame = 0;
+
+    for(i = 0; i < warmup; i++)
+        k->run(frame++);
+
+    for(s = 0; s < samples; s++) {
+        start = now_ns();
+        for(i = 0; i < frames; i++)
+            k->run(frame++);
+        ns[s] = (double)(now_ns() - start) / frames;
+        sum += ns[s];
+    }
+
+    res->mean = sum / samples;
+    for(s = 0; s < samples; s++)
+        sq += (ns[s] - res->mean) * (ns[s] - res->mean);
+    res->stddev = (samples > 1) ? sqrt(sq / (samples - 1)) : 0.0;
+    qsort(ns, samples, sizeof(double), compare_double);
+    res->min = ns[0];
+    res->median = (samples % 2) ? ns[samples / 2] : (ns[samples / 2 - 1] + ns[samples / 2]) / 2.0;
+}
+
+static bool selected(const char *list, const char *name) {
+    const char *p = list;
+    size_t len = strlen(name);
+
+    if(list == NULL)
+        return true;
+    // a name selects the kernels it is the prefix of, "diff" runs every difference kernel
+    while(*p) {
+        size_t n = strcspn(p, ",");
+        if((n <= len) && (n > 0) && (strncmp(p, name, n) == 0))
+            return true;
+        p += n;
+        if(*p == ',')
+            p++;
+    }
+    return false;
+}
+
+static int pin(int cpu, int prio) {
+    struct sched_param param;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) < 0) {
+        fprintf(stderr, "bench: cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+        return -1;
+    }
+    if(prio > 0) {
+        param.sched_priority = prio;
+        if(sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+            fprintf(stderr, "bench: SCHED_FIFO %d refused (%s), running SCHED_OTHER\n", prio, strerror(errno));
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-f DIR] [-k KERNELS] [-n FRAMES] [-s SAMPLES] [-w FRAMES]\n"
+                    "       %*s [-c CPU] [-p PRIO] [-d DIR] [-l LABEL] [-C|-j]\n"
+                    "Kernels:", prog, (int)strlen(prog), "");
+    for(int i = 0; i < NKERNELS; i++)
+        fprintf(stderr, " %s", kernels[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    const char *recording = "../frames@10Hz";
+    const char *only = NULL, *label = "";
+    output_t output = OUTPUT_TABLE;
+    int frames = 200, samples = 10, warmup = 50, prio = 0;
+    int cpu = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    bool own_dir = true, first = true;
+    result_t res;
+    double gbps;
+    int c, i, count, saved_stdout;
+
+    dump_dir[0] = '\0';
+    while((c = getopt(argc, argv, "f:k:n:s:w:c:p:d:l:Cjh")) != -1) {
+        switch(c) {
+            case 'f': recording = optarg; break;
+            case 'k': only = optarg; break;
+            case 'n': frames = atoi(optarg); break;
+            case 's': samples = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'p': prio = atoi(optarg); break;
+            case 'd':
+                snprintf(dump_dir, sizeof(dump_dir), "%s", optarg);
+                own_dir = false;
+                break;
+            case 'l': label = optarg; break;
+            case 'C': output = OUTPUT_CSV; break;
+            case 'j': output = OUTPUT_JSON; break;
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if((optind != argc) || (frames < 1) || (samples < 1) || (samples > BENCH_MAX_SAMPLES) || (warmup < 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // the replay reports on stdout, keep it free for the results
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    count = replay_open(recording);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    if(count <= 0) {
+        fprintf(stderr, "bench: no frames in %s\n", recording);
+        return EXIT_FAILURE;
+    }
+    nfixtures = (count < BENCH_FIXTURES) ? count : BENCH_FIXTURES;
+    rgb_fixtures = load_fixtures(FRAME_FORMAT_RGB, (count / nfixtures) * BENCH_FRAME_PERIOD_NS, true);
+    gray_fixtures = load_fixtures(FRAME_FORMAT_GRAY, (count / nfixtures) * BENCH_FRAME_PERIOD_NS, false);
+    out = malloc(RGB_SIZE);
+    if((rgb_fixtures == NULL) || (gray_fixtures == NULL) || (out == NULL)) {
+        fprintf(stderr, "bench: out of memory for the fixtures\n");
+        return EXIT_FAILURE;
+    }
+    memset(out, 0, RGB_SIZE);
+    if(own_dir) {
+        snprintf(dump_dir, sizeof(dump_dir), "/tmp/synchronome-bench-XXXXXX");
+        if(mkdtemp(dump_dir) == NULL) {
+            perror("bench: mkdtemp");
+            return EXIT_FAILURE;
+        }
+    }
+    if(pin(cpu, prio) < 0)
+        cpu = -1;
+
+    if(output == OUTPUT_JSON) {
+        printf("{\n  \"label\": \"%s\", \"compiler\": \"%s\", \"cflags\": \"%s\",\n", label, __VERSION__, BENCH_CFLAGS);
+        printf("  \"cpu\": %d, \"frames\": %d, \"samples\": %d, \"warmup\": %d, \"fixtures\": %d,\n",
+               cpu, frames, samples, warmup, nfixtures);
+        printf("  \"kernels\": [");
+    } else if(output == OUTPUT_CSV) {
+        printf("label,kernel,frames,samples,bytes,ns_mean,ns_min,ns_median,ns_stddev,cv_pct,fps,gbps\n");
+    } else {
+        printf("%s%s%d fixtures from %s, CPU %d, %d samples of %d frames, cflags %s\n\n",
+               label, (label[0] != '\0') ? ": " : "", nfixtures, recording, cpu, samples, frames, BENCH_CFLAGS);
+        printf("%-13s %12s %12s %12s %10s %7s %10s %8s  %s\n", "kernel", "ns/frame", "min", "median",
+               "stddev", "cv%", "fps", "GB/s", "");
+    }
+
+    for(i = 0; i < NKERNELS; i++) {
+        if(!selected(only, kernels[i].name))
+            continue;
+        if((kernels[i].setup != NULL) && (kernels[i].setup() < 0)) {
+            fprintf(stderr, "bench: %s skipped\n", kernels[i].name);
+            continue;
+        }
+        measure(&kernels[i], frames, samples, warmup, &res);
+        if(kernels[i].teardown != NULL)
+            kernels[i].teardown();
+        gbps = (kernels[i].bytes > 0) ? (double)kernels[i].bytes / res.mean : 0.0;    // bytes per ns is GB/s
+
+        if(output == OUTPUT_JSON) {
+            printf("%s\n    {\"kernel\": \"%s\", \"bytes\": %ld, \"ns_mean\": %.1f, \"ns_min\": %.1f, "
+                   "\"ns_median\": %.1f, \"ns_stddev\": %.1f, \"cv_pct\": %.2f, \"fps\": %.1f, \"gbps\": %.3f}",
+                   first ? "" : ",", kernels[i].name, kernels[i].bytes, res.mean, res.min, res.median,
+                   res.stddev, 100.0 * res.stddev / res.mean, 1e9 / res.mean, gbps);
+        } else if(output == OUTPUT_CSV) {
+            printf("%s,%s,%d,%d,%ld,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%.3f\n", label, kernels[i].name,
+                   frames, samples, kernels[i].bytes, res.mean, res.min, res.median, res.stddev,
+                   100.0 * res.stddev / res.mean, 1e9 / res.mean, gbps);
+        } else {
+            printf("%-13s %12.1f %12.1f %12.1f %10.1f %7.2f %10.1f ", kernels[i].name, res.mean, res.min,
+                   res.median, res.stddev, 100.0 * res.stddev / res.mean, 1e9 / res.mean);
+            if(kernels[i].bytes > 0)
+                printf("%8.3f  %s\n", gbps, kernels[i].desc);
+            else
+                printf("%8s  %s\n", "-", kernels[i].desc);
+        }
+        fflush(stdout);
+        first = false;
+    }
+    if(output == OUTPUT_JSON)
+        printf("\n  ]\n}\n");
+    if(cbuf_stalls > 0)
+        fprintf(stderr, "bench: the circular buffer refused %lu selections\n", cbuf_stalls);
+
+    for(i = 0; i < BENCH_DUMP_FILES; i++) {
+        char path[sizeof(dump_dir) + 32];
+
+        snprintf(path, sizeof(path), "%s/test%04d.ppm", dump_dir, i);
+        unlink(path);
+    }
+    if(own_dir)
+        rmdir(dump_dir);
+    replay_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,605 @@
+/**
+*
+* This is a fake V4L2 camera loaded with LD_PRELOAD. It emulates a YUYV
+* streaming capture device behind the open/ioctl/mmap calls of
+* framecapture.c, so the real capture path (QUERYCAP, S_FMT, REQBUFS,
+* QUERYBUF, QBUF/DQBUF, STREAMON and select) runs without a camera, in CI
+* and on a laptop, under device behaviour that can be reproduced.
+*
+* The device is a thread that fills the queued buffers at the frame rate,
+* like the DMA of a USB camera: a frame with no buffer queued is lost, a
+* filled buffer waits for DQBUF and makes the file descriptor readable.
+* The descriptor is an eventfd, so select() and poll() work unchanged.
+* Frames come from a recording, the frame recorded at the same point of
+* its timeline, or from a test pattern whose bar moves once a second.
+*
+* Environment:
+*   FAKEV4L2_DEVICE     path taken over, /dev/video0 by default
+*   FAKEV4L2_FRAMES     recording directory (PPM/PGM), the test pattern if unset
+*   FAKEV4L2_FPS        frame rate [30]
+*   FAKEV4L2_JITTER_US  each frame arrives up to this much early or late [0]
+*   FAKEV4L2_DROP_PCT   share of the frames the device loses [0]
+*   FAKEV4L2_EAGAIN_PCT share of the DQBUF calls failing with EAGAIN, even
+*                       with a frame ready [0]
+*   FAKEV4L2_SEED       seed of the jitter, drop and EAGAIN draws
+*
+* Usage: LD_PRELOAD=tools/libfakev4l2.so FAKEV4L2_DEVICE=/dev/fakecam ./main -d /dev/fakecam
+*
+* Build: make tools
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/sysmacros.h>
+#include <linux/videodev2.h>
+#include "../includes/framecapture.h"
+#include "../includes/replay.h"
+
+#define FAKE_MAX_BUFFERS       (8)
+#define FAKE_FRAME_SIZE        (HRES * VRES * 2)
+#define FAKE_BUFFER_STRIDE     ((FAKE_FRAME_SIZE + 4095) & ~4095)   // mmap offsets are page aligned
+#define FAKE_VIDEO_MAJOR       (81)
+#define NSEC_PER_SEC           (1000000000LL)
+
+typedef enum { BUF_DEQUEUED, BUF_QUEUED, BUF_DONE } buf_state_t;
+
+// One capture buffer, shared with the application through mmap
+typedef struct {
+  unsigned char *start;
+  buf_state_t state;
+  struct v4l2_buffer info;                     // sequence, timestamp and bytesused once done
+}fake_buffer_t;
+
+static struct {
+  const char *path;                            // NULL until the settings are read
+  int fd;                                      // eventfd standing in for the device, -1 if closed
+  long long period_ns;
+  long long jitter_ns;
+  double drop;
+  double eagain;
+  uint64_t rng;
+  fake_buffer_t buffers[FAKE_MAX_BUFFERS];
+  unsigned int nbuffers;
+  unsigned int queue[FAKE_MAX_BUFFERS];        // indexes in QBUF order
+  unsigned int queued;
+  unsigned int done[FAKE_MAX_BUFFERS];         // indexes in fill order
+  unsigned int ndone;
+  bool streaming;
+  pthread_t device;
+  pthread_mutex_t lock;
+  unsigned long long frames, dropped, overruns, eagains;
+}cam = { .fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_open64)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, unsigned long, ...);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static void *(*real_mmap64)(void *, size_t, int, int, int, off64_t);
+static int (*real_munmap)(void *, size_t);
+static int (*real_stat)(const char *, struct stat *);
+static int (*real_stat64)(const char *, struct stat64 *);
+static int (*real_xstat)(int, const char *, struct stat *);
+static int (*real_xstat64)(int, const char *, struct stat64 *);
+
+static double env_number(const char *name, double fallback) {
+    const char *value = getenv(name);
+
+    return (value != NULL && *value != '\0') ? atof(value) : fallback;
+}
+
+static pthread_once_t symbols_once = PTHREAD_ONCE_INIT;
+static pthread_once_t settings_once = PTHREAD_ONCE_INIT;
+static __thread bool loading = false;          // this thread reads the settings
+
+static void resolve_symbols(void) {
+    real_open = dlsym(RTLD_NEXT, "open");
+    real_open64 = dlsym(RTLD_NEXT, "open64");
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+    real_mmap = dlsym(RTLD_NEXT, "mmap");
+    real_mmap64 = dlsym(RTLD_NEXT, "mmap64");
+    real_munmap = dlsym(RTLD_NEXT, "munmap");
+    real_stat = dlsym(RTLD_NEXT, "stat");
+    real_stat64 = dlsym(RTLD_NEXT, "stat64");
+    real_xstat = dlsym(RTLD_NEXT, "__xstat");
+    real_xstat64 = dlsym(RTLD_NEXT, "__xstat64");
+}
+
+static void read_settings(void) {
+    const char *frames;
+    double fps;
+
+    fps = env_number("FAKEV4L2_FPS", 30.0);
+    cam.period_ns = (long long)(NSEC_PER_SEC / ((fps > 0) ? fps : 30.0));
+    cam.jitter_ns = (long long)(env_number("FAKEV4L2_JITTER_US", 0) * 1000.0);
+    cam.drop = env_number("FAKEV4L2_DROP_PCT", 0) / 100.0;
+    cam.eagain = env_number("FAKEV4L2_EAGAIN_PCT", 0) / 100.0;
+    cam.rng = (uint64_t)env_number("FAKEV4L2_SEED", 1) | 1;
+
+    frames = getenv("FAKEV4L2_FRAMES");
+    if(frames != NULL && replay_open(frames) < 0)
+        fprintf(stderr, "fakev4l2: no frames in %s, serving the test pattern\n", frames);
+
+    // last, a call racing in from another thread waits in pthread_once()
+    cam.path = getenv("FAKEV4L2_DEVICE") ? getenv("FAKEV4L2_DEVICE") : DEFAULT_VIDEO_DEVICE;
+}
+
+// the real calls and the settings, resolved at the first intercepted call.
+// Every thread waits for both, except the one reading the settings: the
+// files replay_open() opens come back here, and go to the real calls.
+static void load(void) {
+    pthread_once(&symbols_once, resolve_symbols);
+    if(loading)
+        return;
+    loading = true;
+    pthread_once(&settings_once, read_settings);
+    loading = false;
+}
+
+static bool is_device(const char *path) {
+    load();
+    return path != NULL && cam.path != NULL && strcmp(path, cam.path) == 0;
+}
+
+// xorshift64*, reproducible for a given seed
+static double uniform(void) {
+    cam.rng ^= cam.rng >> 12;
+    cam.rng ^= cam.rng << 25;
+    cam.rng ^= cam.rng >> 27;
+    return (double)((cam.rng * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static long long monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * frames
+ */
+
+// BT.601 studio swing, the inverse of yuv2rgb() in framecapture.c
+static void rgb_to_yuyv(const unsigned char *rgb, unsigned char *yuyv) {
+    int pix, r, g, b, u, v;
+
+    for(pix = 0; pix < HRES * VRES; pix += 2, rgb += 6, yuyv += 4) {
+        r = rgb[0]; g = rgb[1]; b = rgb[2];
+        yuyv[0] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        r = rgb[3]; g = rgb[4]; b = rgb[5];
+        yuyv[2] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        yuyv[1] = (u + ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128 + 1) / 2;
+        yuyv[3] = (v + ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128 + 1) / 2;
+    }
+}
+
+// mid gray with a white bar, one tenth of the width, moving once a second
+static void test_pattern(long long offset_ns, unsigned char *yuyv) {
+    int x, y, bar = (int)((offset_ns / NSEC_PER_SEC) % 10) * (HRES / 10);
+
+    for(y = 0; y < VRES; y++) {
+        for(x = 0; x < HRES; x++, yuyv += 2) {
+            yuyv[0] = (x >= bar && x < bar + HRES / 10) ? 235 : 126;
+            yuyv[1] = 128;
+        }
+    }
+}
+
+static void render(long long offset_ns, unsigned char *yuyv) {
+    const unsigned char *rgb = replay_active() ? replay_frame_at(offset_ns) : NULL;
+
+    if(rgb != NULL)
+        rgb_to_yuyv(rgb, yuyv);
+    else
+        test_pattern(offset_ns, yuyv);
+}
+
+// the camera: one frame per period into the oldest queued buffer
+static void *device_thread(void *arg) {
+    long long start_ns = monotonic_ns(), due_ns, offset_ns;
+    struct timespec due;
+    unsigned int sequence, index;
+    uint64_t one = 1;
+    fake_buffer_t *buf;
+
+    (void)arg;
+    for(sequence = 0; ; sequence++) {
+        offset_ns = (long long)(sequence + 1) * cam.period_ns;
+        pthread_mutex_lock(&cam.lock);
+        if(cam.jitter_ns > 0)
+            offset_ns += (long long)((2.0 * uniform() - 1.0) * cam.jitter_ns);
+        pthread_mutex_unlock(&cam.lock);
+        due_ns = start_ns + offset_ns;
+        due.tv_sec = due_ns / NSEC_PER_SEC;
+        due.tv_nsec = due_ns % NSEC_PER_SEC;
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR);
+
+        pthread_mutex_lock(&cam.lock);
+        if(!cam.streaming) {
+            pthread_mutex_unlock(&cam.lock);
+            break;
+        }
+        if(cam.drop > 0 && uniform() < cam.drop) {
+            cam.dropped++;
+            pthread_mutex_unlock(&cam.lock);
+            continue;
+        }
+        if(cam.queued == 0) {
+            cam.overruns++;
+            pthread_mutex_unlock(&cam.lock);
+            continue;
+        }
+        index = cam.queue[0];
+        memmove(cam.queue, cam.queue + 1, --cam.queued * sizeof(cam.queue[0]));
+        pthread_mutex_unlock(&cam.lock);
+
+        // the buffer belongs to the device until it is marked done
+        buf = &cam.buffers[index];
+        render(offset_ns, buf->start);
+
+        pthread_mutex_lock(&cam.lock);
+        buf->info.sequence = sequence;
+        buf->info.bytesused = FAKE_FRAME_SIZE;
+        buf->info.flags = V4L2_BUF_FLAG_MAPPED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+        buf->info.timestamp.tv_sec = monotonic_ns() / NSEC_PER_SEC;
+        buf->info.timestamp.tv_usec = (monotonic_ns() % NSEC_PER_SEC) / 1000;
+        buf->state = BUF_DONE;
+        cam.done[cam.ndone++] = index;
+        cam.frames++;
+        pthread_mutex_unlock(&cam.lock);
+        if(write(cam.fd, &one, sizeof(one)) < 0)
+            perror("fakev4l2: eventfd");
+    }
+    return NULL;
+}
+
+/*
+ * ioctls
+ */
+
+static void drain_events(void) {
+    uint64_t count;
+
+    while(read(cam.fd, &count, sizeof(count)) > 0);
+}
+
+static int stream_off(void) {
+    unsigned int i;
+
+    pthread_mutex_lock(&cam.lock);
+    if(!cam.streaming) {
+        pthread_mutex_unlock(&cam.lock);
+        return 0;
+    }
+    cam.streaming = false;
+    pthread_mutex_unlock(&cam.lock);
+    pthread_join(cam.device, NULL);
+
+    // every buffer returns to the application, as after VIDIOC_STREAMOFF
+    for(i = 0; i < cam.nbuffers; i++)
+        cam.buffers[i].state = BUF_DEQUEUED;
+    cam.queued = cam.ndone = 0;
+    drain_events();
+    fprintf(stderr, "fakev4l2: %llu frames, %llu dropped, %llu without a queued buffer, %llu EAGAIN\n",
+            cam.frames, cam.dropped, cam.overruns, cam.eagains);
+    return 0;
+}
+
+static void free_buffers(void) {
+    unsigned int i;
+
+    for(i = 0; i < cam.nbuffers; i++) {
+        if(cam.buffers[i].start != NULL)
+            real_munmap(cam.buffers[i].start, FAKE_BUFFER_STRIDE);
+        cam.buffers[i].start = NULL;
+    }
+    cam.nbuffers = 0;
+}
+
+static int request_buffers(struct v4l2_requestbuffers *req) {
+    unsigned int i;
+
+    if(req->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || req->memory != V4L2_MEMORY_MMAP || cam.streaming) {
+        errno = cam.streaming ? EBUSY : EINVAL;
+        return -1;
+    }
+    free_buffers();
+    if(req->count == 0)
+        return 0;
+    if(req->count < 2)
+        req->count = 2;
+    if(req->count > FAKE_MAX_BUFFERS)
+        req->count = FAKE_MAX_BUFFERS;
+    for(i = 0; i < req->count; i++) {
+        cam.buffers[i].start = real_mmap(NULL, FAKE_BUFFER_STRIDE, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(cam.buffers[i].start == MAP_FAILED) {
+            cam.buffers[i].start = NULL;
+            free_buffers();
+            errno = ENOMEM;
+            return -1;
+        }
+        memset(&cam.buffers[i].info, 0, sizeof(cam.buffers[i].info));
+        cam.buffers[i].info.index = i;
+        cam.buffers[i].info.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        cam.buffers[i].info.memory = V4L2_MEMORY_MMAP;
+        cam.buffers[i].info.length = FAKE_FRAME_SIZE;
+        cam.buffers[i].info.m.offset = i * FAKE_BUFFER_STRIDE;
+        cam.buffers[i].info.field = V4L2_FIELD_NONE;
+        cam.buffers[i].state = BUF_DEQUEUED;
+        cam.nbuffers++;
+    }
+    return 0;
+}
+
+static int dequeue(struct v4l2_buffer *buf) {
+    uint64_t one;
+    unsigned int index;
+
+    pthread_mutex_lock(&cam.lock);
+    if(cam.eagain > 0 && uniform() < cam.eagain) {
+        cam.eagains++;
+        pthread_mutex_unlock(&cam.lock);
+        errno = EAGAIN;
+        return -1;
+    }
+    if(cam.ndone == 0) {
+        pthread_mutex_unlock(&cam.lock);
+        errno = cam.streaming ? EAGAIN : EINVAL;
+        return -1;
+    }
+    index = cam.done[0];
+    memmove(cam.done, cam.done + 1, --cam.ndone * sizeof(cam.done[0]));
+    cam.buffers[index].state = BUF_DEQUEUED;
+    *buf = cam.buffers[index].info;
+    pthread_mutex_unlock(&cam.lock);
+
+    // one event per filled buffer, the descriptor stays readable while any is left
+    if(read(cam.fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        perror("fakev4l2: eventfd");
+    return 0;
+}
+
+static int fake_ioctl(unsigned int request, void *arg) {
+    struct v4l2_capability *cap;
+    struct v4l2_format *fmt;
+    struct v4l2_buffer *buf;
+    int rc = 0;
+
+    switch(request) {
+        case VIDIOC_QUERYCAP:
+            cap = (struct v4l2_capability *)arg;
+            memset(cap, 0, sizeof(*cap));
+            snprintf((char *)cap->driver, sizeof(cap->driver), "fakev4l2");
+            snprintf((char *)cap->card, sizeof(cap->card), "Fake YUYV camera");
+            snprintf((char *)cap->bus_info, sizeof(cap->bus_info), "preload:%s", cam.path);
+            cap->version = 0x00010000;
+            cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+            cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+            return 0;
+        case VIDIOC_G_FMT:
+        case VIDIOC_S_FMT:
+        case VIDIOC_TRY_FMT:
+            // one mode only, like a driver adjusting any request to what it has
+            fmt = (struct v4l2_format *)arg;
+            if(fmt->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+                errno = EINVAL;
+                return -1;
+            }
+            memset(&fmt->fmt.pix, 0, sizeof(fmt->fmt.pix));
+            fmt->fmt.pix.width = HRES;
+            fmt->fmt.pix.height = VRES;
+            fmt->fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+            fmt->fmt.pix.field = V4L2_FIELD_NONE;
+            fmt->fmt.pix.bytesperline = HRES * 2;
+            fmt->fmt.pix.sizeimage = FAKE_FRAME_SIZE;
+            fmt->fmt.pix.colorspace = V4L2_COLORSPACE_SRGB;
+            return 0;
+        case VIDIOC_REQBUFS:
+            return request_buffers((struct v4l2_requestbuffers *)arg);
+        case VIDIOC_QUERYBUF:
+        case VIDIOC_QBUF:
+            buf = (struct v4l2_buffer *)arg;
+            if(buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->index >= cam.nbuffers) {
+                errno = EINVAL;
+                return -1;
+            }
+            pthread_mutex_lock(&cam.lock);
+            if(request == VIDIOC_QUERYBUF) {
+                *buf = cam.buffers[buf->index].info;
+            } else if(cam.buffers[buf->index].state != BUF_DEQUEUED) {
+                errno = EINVAL;
+                rc = -1;
+            } else {
+                cam.buffers[buf->index].state = BUF_QUEUED;
+                cam.queue[cam.queued++] = buf->index;
+            }
+            pthread_mutex_unlock(&cam.lock);
+            return rc;
+        case VIDIOC_DQBUF:
+            return dequeue((struct v4l2_buffer *)arg);
+        case VIDIOC_STREAMON:
+            pthread_mutex_lock(&cam.lock);
+            if(cam.streaming || cam.nbuffers == 0) {
+                rc = cam.streaming ? 0 : -1;
+                pthread_mutex_unlock(&cam.lock);
+                if(rc < 0)
+                    errno = EINVAL;
+                return rc;
+            }
+            cam.streaming = true;
+            cam.frames = cam.dropped = cam.overruns = cam.eagains = 0;
+            pthread_mutex_unlock(&cam.lock);
+            if((rc = pthread_create(&cam.device, NULL, device_thread, NULL)) != 0) {
+                cam.streaming = false;
+                errno = rc;
+                return -1;
+            }
+            return 0;
+        case VIDIOC_STREAMOFF:
+            return stream_off();
+        default:
+            // no cropping, controls or other inputs
+            errno = EINVAL;
+            return -1;
+    }
+}
+
+/*
+ * intercepted calls
+ */
+
+static int open_fake(void) {
+    if(cam.fd >= 0) {
+        errno = EBUSY;
+        return -1;
+    }
+    cam.fd = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE | EFD_CLOEXEC);
+    return cam.fd;
+}
+
+int open(const char *path, int flags, ...) {
+    va_list ap;
+    mode_t mode;
+
+    if(is_device(path))
+        return open_fake();
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return real_open(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...) {
+    va_list ap;
+    mode_t mode;
+
+    if(is_device(path))
+        return open_fake();
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return real_open64(path, flags, mode);
+}
+
+int close(int fd) {
+    load();
+    if(fd >= 0 && fd == cam.fd) {
+        stream_off();
+        free_buffers();
+        cam.fd = -1;
+    }
+    return real_close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+    va_list ap;
+    void *arg;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+    load();
+    // the kernel only looks at 32 bits, xioctl() passes the request as an int
+    if(fd >= 0 && fd == cam.fd)
+        return fake_ioctl((unsigned int)request, arg);
+    return real_ioctl(fd, request, arg);
+}
+
+static void *map_buffer(size_t length, off_t offset) {
+    unsigned int index = offset / FAKE_BUFFER_STRIDE;
+
+    if((offset % FAKE_BUFFER_STRIDE) != 0 || index >= cam.nbuffers || length > FAKE_BUFFER_STRIDE) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    return cam.buffers[index].start;
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    load();
+    if(fd >= 0 && fd == cam.fd)
+        return map_buffer(length, offset);
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+    load();
+    if(fd >= 0 && fd == cam.fd)
+        return map_buffer(length, offset);
+    return real_mmap64(addr, length, prot, flags, fd, offset);
+}
+
+// the buffers stay mapped until REQBUFS or close releases them
+int munmap(void *addr, size_t length) {
+    unsigned int i;
+
+    load();
+    for(i = 0; i < cam.nbuffers; i++)
+        if(addr == cam.buffers[i].start)
+            return 0;
+    return real_munmap(addr, length);
+}
+
+static void fake_stat(struct stat *st) {
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFCHR | 0660;
+    st->st_rdev = makedev(FAKE_VIDEO_MAJOR, 0);
+    st->st_nlink = 1;
+}
+
+int stat(const char *path, struct stat *st) {
+    if(is_device(path)) {
+        fake_stat(st);
+        return 0;
+    }
+    return real_stat(path, st);
+}
+
+int stat64(const char *path, struct stat64 *st) {
+    if(is_device(path)) {
+        fake_stat((struct stat *)st);
+        return 0;
+    }
+    return real_stat64(path, st);
+}
+
+// glibc before 2.33 routes stat() through these
+int __xstat(int ver, const char *path, struct stat *st) {
+    if(is_device(path)) {
+        fake_stat(st);
+        return 0;
+    }
+    return real_xstat(ver, path, st);
+}
+
+int __xstat64(int ver, const char *path, struct stat64 *st) {
+    if(is_device(path)) {
+        fake_stat((struct stat *)st);
+        return 0;
+    }
+    return real_xstat64(ver, path, st);
+}
@@ -0,0 +1,600 @@
+/**
+*
+* This is the offline analyzer of service timing logs. It streams syslog
+* files and binary traces of any size and computes per service the
+* release intervals, start jitter, clock drift, WCET, deadline misses and
+* frame rate stability, replacing the spreadsheets the service*_times.txt
+* excerpts used to go through.
+*
+* Understood inputs, detected per file:
+*   syslog   "S2 20 Hz on core 2 for release 21 @ sec=1.051576647 ..." lines of
+*            the historical runs (S1..S4, "33Hz", "best effort", optional
+*            "time =" or "frameRate=" tails), and the end of run summaries
+*            "Service NAME: period=...", "Exec NAME: ... max=..." and
+*            "Overload NAME: ... misses=..." of the current pipeline
+*   trace    files recorded with --trace, job starts, ends and misses per thread
+*
+* Usage: logstat [-c | -j] [-p NAME=MS] [-t PCT] FILE...
+*   -c          CSV, one line per service
+*   -j          JSON array, one object per service
+*   -p NAME=MS  nominal period of NAME in ms, overrides the rate in the log
+*   -t PCT      frame rate tolerance around the nominal rate [10]
+*   FILE        syslog or trace file, - for a syslog on stdin
+*
+* Build: make tools
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include "../includes/trace.h"
+#include "../includes/histogram.h"
+
+#define MAX_SERVICES           (128)
+#define MAX_PERIODS            (32)
+#define NAME_LENGTH            (32)
+#define TRACE_BLOCK            (65536)          // records read at once
+#define LATE_FACTOR            (1.5)            // interval counted late beyond this many periods
+
+typedef enum { OUT_TABLE, OUT_CSV, OUT_JSON } output_t;
+
+// One service of one input, all statistics are kept streaming
+typedef struct {
+  char file[NAME_LENGTH * 2];
+  char name[NAME_LENGTH];
+  double period_ns;                            // nominal, 0 if unknown
+  unsigned long long releases;
+  unsigned long long first_release;
+  unsigned long long last_release;
+  double first_ns;
+  double last_ns;
+  unsigned long long gaps;                     // release numbers missing between two releases
+  unsigned long long late;                     // intervals beyond LATE_FACTOR periods
+  unsigned long long in_tolerance;             // intervals within the frame rate tolerance
+  // intervals, Welford
+  unsigned long long intervals;
+  double mean;
+  double m2;
+  double min;
+  double max;
+  histogram_t hist;
+  // time against release number, least squares from the first release
+  double sx, sy, sxx, sxy;
+  // execution and misses, from traces and summaries
+  bool has_exec;
+  double wcet_ns;
+  histogram_t exec;
+  bool has_misses;
+  unsigned long long misses;
+}service_stats_t;
+
+// nominal periods given with -p
+typedef struct {
+  char name[NAME_LENGTH];
+  double period_ns;
+}period_override_t;
+
+static service_stats_t *services[MAX_SERVICES];
+static int nservices = 0;
+static period_override_t overrides[MAX_PERIODS];
+static int noverrides = 0;
+static double tolerance = 0.10;
+
+static service_stats_t *find_service(const char *file, const char *name, bool create) {
+    service_stats_t *svc;
+    int i;
+
+    for(i = nservices - 1; i >= 0; i--) {
+        if(strcmp(services[i]->file, file) == 0 && strcmp(services[i]->name, name) == 0)
+            return services[i];
+    }
+    if(!create || nservices == MAX_SERVICES)
+        return NULL;
+
+    svc = (service_stats_t *)calloc(1, sizeof(service_stats_t));
+    if(svc == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(svc->file, sizeof(svc->file), "%s", file);
+    snprintf(svc->name, sizeof(svc->name), "%s", name);
+    histogram_reset(&svc->hist);
+    histogram_reset(&svc->exec);
+    for(i = 0; i < noverrides; i++) {
+        if(strcmp(overrides[i].name, name) == 0)
+            svc->period_ns = overrides[i].period_ns;
+    }
+    services[nservices++] = svc;
+    return svc;
+}
+
+static void set_period(service_stats_t *svc, double period_ns) {
+    int i;
+
+    for(i = 0; i < noverrides; i++) {
+        if(strcmp(overrides[i].name, svc->name) == 0)
+            return;
+    }
+    svc->period_ns = period_ns;
+}
+
+// a release of the service at time ns
+static void add_release(service_stats_t *svc, unsigned long long release, double ns) {
+    double interval, delta, x, y;
+
+    if(svc->releases > 0) {
+        interval = ns - svc->last_ns;
+        if(release > svc->last_release + 1)
+            svc->gaps += release - svc->last_release - 1;
+
+        svc->intervals++;
+        delta = interval - svc->mean;
+        svc->mean += delta / (double)svc->intervals;
+        svc->m2 += delta * (interval - svc->mean);
+        if(svc->intervals == 1 || interval < svc->min) svc->min = interval;
+        if(svc->intervals == 1 || interval > svc->max) svc->max = interval;
+        histogram_record(&svc->hist, (int64_t)interval);
+
+        // one interval may span several periods when releases were skipped
+        if(svc->period_ns > 0) {
+            if(interval > LATE_FACTOR * svc->period_ns * (double)(release - svc->last_release))
+                svc->late++;
+            if(fabs(interval - svc->period_ns) <= tolerance * svc->period_ns)
+                svc->in_tolerance++;
+        }
+    } else {
+        svc->first_release = release;
+        svc->first_ns = ns;
+    }
+
+    x = (double)(release - svc->first_release);
+    y = ns - svc->first_ns;
+    svc->sx += x;
+    svc->sy += y;
+    svc->sxx += x * x;
+    svc->sxy += x * y;
+
+    svc->releases++;
+    svc->last_release = release;
+    svc->last_ns = ns;
+}
+
+static void add_exec(service_stats_t *svc, double ns) {
+    svc->has_exec = true;
+    if(ns > svc->wcet_ns)
+        svc->wcet_ns = ns;
+    histogram_record(&svc->exec, (int64_t)ns);
+}
+
+/*
+ * syslog
+ */
+
+// "... S2 20 Hz on core 2 for release 21 @ sec=1.051576647 ..."
+static bool parse_release_line(const char *line, char *name, double *rate, unsigned long long *release, double *sec) {
+    const char *core, *tag, *p;
+    char *end;
+    size_t length;
+
+    core = strstr(line, " on core ");
+    if(core == NULL)
+        return false;
+
+    // the service tag is the last "S<digits>" word before " on core "
+    for(tag = core - 1; tag > line; tag--) {
+        if(tag[0] == 'S' && (tag[-1] == ' ' || tag[-1] == ':') && tag[1] >= '0' && tag[1] <= '9')
+            break;
+    }
+    if(tag <= line)
+        return false;
+    for(length = 1; tag[length] >= '0' && tag[length] <= '9'; length++);
+    if(length >= NAME_LENGTH || tag[length] != ' ')
+        return false;
+    memcpy(name, tag, length);
+    name[length] = '\0';
+
+    // "33Hz", "20 Hz", or "best effort"
+    *rate = strtod(tag + length + 1, &end);
+    if(end == tag + length + 1)
+        *rate = 0.0;
+
+    p = strstr(core, " for release ");
+    if(p == NULL)
+        return false;
+    *release = strtoull(p + 13, &end, 10);
+    if(end == p + 13)
+        return false;
+    p = strstr(end, "sec=");
+    if(p == NULL)
+        return false;
+    *sec = strtod(p + 4, &end);
+    return end != p + 4;
+}
+
+// "Service NAME: period=30000 us ...", "Exec NAME: ... max=123 ...", "Overload NAME: ... misses=2 ..."
+static void parse_summary_line(const char *file, const char *line) {
+    static const char *keys[] = { "Service ", "Exec ", "Overload " };
+    char name[NAME_LENGTH];
+    const char *p, *colon, *value;
+    service_stats_t *svc;
+    size_t length;
+    int k;
+
+    for(k = 0; k < 3; k++) {
+        p = strstr(line, keys[k]);
+        if(p != NULL)
+            break;
+    }
+    if(p == NULL)
+        return;
+    p += strlen(keys[k]);
+    colon = strstr(p, ": ");
+    if(colon == NULL || colon == p || (size_t)(colon - p) >= NAME_LENGTH || memchr(p, ' ', colon - p) != NULL)
+        return;
+    length = colon - p;
+    memcpy(name, p, length);
+    name[length] = '\0';
+
+    if(k == 0 && (value = strstr(colon, "period=")) != NULL) {
+        svc = find_service(file, name, true);
+        if(svc != NULL && atof(value + 7) > 0)
+            set_period(svc, atof(value + 7) * 1000.0);
+    } else if(k == 1 && (value = strstr(colon, " max=")) != NULL) {
+        svc = find_service(file, name, true);
+        if(svc != NULL)
+            add_exec(svc, atof(value + 5));
+    } else if(k == 2 && strstr(colon, "releases=") != NULL && (value = strstr(colon, " misses=")) != NULL) {
+        svc = find_service(file, name, true);
+        if(svc != NULL) {
+            svc->has_misses = true;
+            svc->misses += strtoull(value + 8, NULL, 10);
+        }
+    }
+}
+
+static void read_syslog(FILE *fp, const char *file) {
+    char name[NAME_LENGTH], run_name[NAME_LENGTH + 16];
+    char *line = NULL;
+    size_t capacity = 0;
+    unsigned long long release;
+    double rate, sec;
+    service_stats_t *svc;
+    int run;
+
+    while(getline(&line, &capacity, fp) >= 0) {
+        if(!parse_release_line(line, name, &rate, &release, &sec)) {
+            parse_summary_line(file, line);
+            continue;
+        }
+
+        // a release number going back starts a new run in the same log
+        svc = NULL;
+        for(run = 1; ; run++) {
+            if(run == 1)
+                snprintf(run_name, sizeof(run_name), "%s", name);
+            else
+                snprintf(run_name, sizeof(run_name), "%s#%d", name, run);
+            svc = find_service(file, run_name, false);
+            if(svc == NULL || release > svc->last_release)
+                break;
+        }
+        if(svc == NULL) {
+            svc = find_service(file, run_name, true);
+            if(svc == NULL)
+                continue;
+            // the log prints the rate, "33Hz" stands for a 30 ms period
+            if(rate > 0)
+                set_period(svc, floor(1000.0 / rate + 0.5) * 1000000.0);
+        }
+        add_release(svc, release, sec * 1e9);
+    }
+    free(line);
+}
+
+/*
+ * traces
+ */
+
+static void read_trace(FILE *fp, const char *file) {
+    trace_file_header_t header;
+    trace_record_t *block;
+    service_stats_t *ring_svc[TRACE_MAX_RINGS];
+    const trace_record_t *rec;
+    service_stats_t *svc;
+    size_t count, i;
+
+    if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", file);
+        return;
+    }
+    if(header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: trace version %u, expected %d\n", file, header.version, TRACE_VERSION);
+        return;
+    }
+    if(header.nrings > TRACE_MAX_RINGS)
+        header.nrings = TRACE_MAX_RINGS;
+    memset(ring_svc, 0, sizeof(ring_svc));
+
+    block = (trace_record_t *)malloc(TRACE_BLOCK * sizeof(trace_record_t));
+    if(block == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the events of one ring are in order, no merge is needed per service
+    while((count = fread(block, sizeof(trace_record_t), TRACE_BLOCK, fp)) > 0) {
+        for(i = 0; i < count; i++) {
+            rec = &block[i];
+            if(rec->ring >= header.nrings)
+                continue;
+            if(rec->id != TRACE_JOB_START && rec->id != TRACE_JOB_END && rec->id != TRACE_JOB_MISS)
+                continue;
+            svc = ring_svc[rec->ring];
+            if(svc == NULL) {
+                svc = ring_svc[rec->ring] = find_service(file, header.names[rec->ring], true);
+                if(svc == NULL)
+                    continue;
+                svc->has_misses = true;
+            }
+            switch(rec->id) {
+                case TRACE_JOB_START:
+                    add_release(svc, (unsigned long long)(uint32_t)rec->arg0, (double)rec->ns);
+                    break;
+                case TRACE_JOB_END:
+                    add_exec(svc, (double)rec->arg1);
+                    break;
+                default:
+                    svc->misses++;
+                    break;
+            }
+        }
+    }
+    free(block);
+}
+
+/*
+ * output
+ */
+
+typedef struct {
+  double period_ms;                            // nominal, or the fitted one if unknown
+  double mean_ms, min_ms, max_ms, std_ms, p50_ms, p99_ms;
+  double jitter_ms;                            // largest deviation of an interval from the period
+  double fitted_ms;                            // period from the least squares fit
+  double drift_ppm;                            // fitted against nominal
+  double drift_ms;                             // last release against the nominal schedule
+  double fps, fps_cv;                          // releases per second and its coefficient of variation
+  double stable_pct;                           // intervals within the tolerance
+  double wcet_ms, exec_p99_ms;
+}service_result_t;
+
+static void compute(const service_stats_t *svc, service_result_t *r) {
+    double n = (double)svc->releases, denominator;
+
+    memset(r, 0, sizeof(service_result_t));
+    if(svc->intervals > 0) {
+        r->mean_ms = svc->mean / 1e6;
+        r->min_ms = svc->min / 1e6;
+        r->max_ms = svc->max / 1e6;
+        r->std_ms = (svc->intervals > 1) ? sqrt(svc->m2 / (double)(svc->intervals - 1)) / 1e6 : 0.0;
+        r->p50_ms = histogram_percentile(&svc->hist, 50.0) / 1e6;
+        r->p99_ms = histogram_percentile(&svc->hist, 99.0) / 1e6;
+        if(r->p50_ms > r->max_ms) r->p50_ms = r->max_ms;
+        if(r->p99_ms > r->max_ms) r->p99_ms = r->max_ms;
+        r->fps = (svc->mean > 0) ? 1e9 / svc->mean : 0.0;
+        r->fps_cv = (r->mean_ms > 0) ? r->std_ms / r->mean_ms : 0.0;
+    }
+
+    denominator = n * svc->sxx - svc->sx * svc->sx;
+    if(svc->releases > 1 && denominator > 0)
+        r->fitted_ms = (n * svc->sxy - svc->sx * svc->sy) / denominator / 1e6;
+
+    r->period_ms = (svc->period_ns > 0) ? svc->period_ns / 1e6 : r->fitted_ms;
+    if(svc->intervals > 0 && r->period_ms > 0) {
+        r->jitter_ms = fmax(fabs(r->max_ms - r->period_ms), fabs(r->min_ms - r->period_ms));
+        r->drift_ppm = (r->fitted_ms - r->period_ms) / r->period_ms * 1e6;
+        r->drift_ms = (svc->last_ns - svc->first_ns) / 1e6 -
+                      (double)(svc->last_release - svc->first_release) * r->period_ms;
+        if(svc->period_ns > 0)
+            r->stable_pct = 100.0 * (double)svc->in_tolerance / (double)svc->intervals;
+    }
+    if(svc->has_exec) {
+        r->wcet_ms = svc->wcet_ns / 1e6;
+        r->exec_p99_ms = fmin(histogram_percentile(&svc->exec, 99.0), svc->wcet_ns) / 1e6;
+    }
+}
+
+static void print_table(void) {
+    service_result_t r;
+    service_stats_t *svc;
+    int i;
+
+    printf("%-20s %-12s %9s %8s %9s %9s %9s %9s %9s %9s %9s %10s %9s %5s %5s %8s %7s %9s %6s\n",
+           "file", "service", "period", "releases", "mean", "min", "max", "stddev", "p99",
+           "jitter", "drift", "drift ppm", "fps", "gaps", "late", "stable%", "fps cv", "wcet", "misses");
+    for(i = 0; i < nservices; i++) {
+        svc = services[i];
+        compute(svc, &r);
+        printf("%-20.20s %-12.12s %7.3fms %8llu %7.3fms %7.3fms %7.3fms %7.3fms %7.3fms %7.3fms %7.3fms %10.1f %9.3f %5llu %5llu",
+               svc->file, svc->name, r.period_ms, svc->releases, r.mean_ms, r.min_ms, r.max_ms, r.std_ms,
+               r.p99_ms, r.jitter_ms, r.drift_ms, r.drift_ppm, r.fps, svc->gaps, svc->late);
+        if(svc->period_ns > 0 && svc->intervals > 0)
+            printf(" %8.2f", r.stable_pct);
+        else
+            printf(" %8s", "-");
+        printf(" %7.4f", r.fps_cv);
+        if(svc->has_exec)
+            printf(" %7.3fms", r.wcet_ms);
+        else
+            printf(" %9s", "-");
+        if(svc->has_misses)
+            printf(" %6llu\n", svc->misses);
+        else
+            printf(" %6s\n", "-");
+    }
+}
+
+static void print_csv(void) {
+    service_result_t r;
+    service_stats_t *svc;
+    int i;
+
+    printf("file,service,period_ms,releases,first_release,last_release,interval_mean_ms,interval_min_ms,"
+           "interval_max_ms,interval_stddev_ms,interval_p50_ms,interval_p99_ms,jitter_ms,fitted_period_ms,"
+           "drift_ms,drift_ppm,fps,fps_cv,stable_pct,gaps,late,wcet_ms,exec_p99_ms,misses\n");
+    for(i = 0; i < nservices; i++) {
+        svc = services[i];
+        compute(svc, &r);
+        printf("%s,%s,%.6f,%llu,%llu,%llu,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f,%.6f,%.6f,",
+               svc->file, svc->name, r.period_ms, svc->releases, svc->first_release, svc->last_release,
+               r.mean_ms, r.min_ms, r.max_ms, r.std_ms, r.p50_ms, r.p99_ms, r.jitter_ms, r.fitted_ms,
+               r.drift_ms, r.drift_ppm, r.fps, r.fps_cv);
+        if(svc->period_ns > 0 && svc->intervals > 0)
+            printf("%.3f", r.stable_pct);
+        printf(",%llu,%llu,", svc->gaps, svc->late);
+        if(svc->has_exec)
+            printf("%.6f,%.6f", r.wcet_ms, r.exec_p99_ms);
+        else
+            printf(",");
+        printf(",");
+        if(svc->has_misses)
+            printf("%llu", svc->misses);
+        printf("\n");
+    }
+}
+
+static void json_string(const char *key, const char *value) {
+    const char *c;
+
+    printf("\"%s\":\"", key);
+    for(c = value; *c; c++) {
+        if(*c == '"' || *c == '\\')
+            printf("\\%c", *c);
+        else if((unsigned char)*c >= 0x20)
+            putchar(*c);
+    }
+    printf("\"");
+}
+
+static void print_json(void) {
+    service_result_t r;
+    service_stats_t *svc;
+    int i;
+
+    printf("[");
+    for(i = 0; i < nservices; i++) {
+        svc = services[i];
+        compute(svc, &r);
+        printf("%s\n  {", i ? "," : "");
+        json_string("file", svc->file);
+        printf(",");
+        json_string("service", svc->name);
+        printf(",\"period_ms\":%.6f,\"releases\":%llu,\"first_release\":%llu,\"last_release\":%llu",
+               r.period_ms, svc->releases, svc->first_release, svc->last_release);
+        printf(",\"interval_ms\":{\"mean\":%.6f,\"min\":%.6f,\"max\":%.6f,\"stddev\":%.6f,\"p50\":%.6f,\"p99\":%.6f}",
+               r.mean_ms, r.min_ms, r.max_ms, r.std_ms, r.p50_ms, r.p99_ms);
+        printf(",\"jitter_ms\":%.6f,\"fitted_period_ms\":%.6f,\"drift_ms\":%.6f,\"drift_ppm\":%.3f",
+               r.jitter_ms, r.fitted_ms, r.drift_ms, r.drift_ppm);
+        printf(",\"fps\":%.6f,\"fps_cv\":%.6f,\"stable_pct\":", r.fps, r.fps_cv);
+        if(svc->period_ns > 0 && svc->intervals > 0)
+            printf("%.3f", r.stable_pct);
+        else
+            printf("null");
+        printf(",\"gaps\":%llu,\"late\":%llu", svc->gaps, svc->late);
+        if(svc->has_exec)
+            printf(",\"wcet_ms\":%.6f,\"exec_p99_ms\":%.6f", r.wcet_ms, r.exec_p99_ms);
+        else
+            printf(",\"wcet_ms\":null,\"exec_p99_ms\":null");
+        if(svc->has_misses)
+            printf(",\"misses\":%llu}", svc->misses);
+        else
+            printf(",\"misses\":null}");
+    }
+    printf("\n]\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c | -j] [-p NAME=MS] [-t PCT] FILE...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    output_t output = OUT_TABLE;
+    char magic[sizeof(((trace_file_header_t *)0)->magic)];
+    const char *path, *base;
+    char *equals;
+    FILE *fp;
+    int c, i;
+    size_t n;
+
+    while((c = getopt(argc, argv, "cjp:t:h")) != -1) {
+        switch(c) {
+            case 'c':
+                output = OUT_CSV;
+                break;
+            case 'j':
+                output = OUT_JSON;
+                break;
+            case 'p':
+                equals = strchr(optarg, '=');
+                if(equals == NULL || noverrides == MAX_PERIODS || atof(equals + 1) <= 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                snprintf(overrides[noverrides].name, NAME_LENGTH, "%.*s", (int)(equals - optarg), optarg);
+                overrides[noverrides++].period_ns = atof(equals + 1) * 1e6;
+                break;
+            case 't':
+                tolerance = atof(optarg) / 100.0;
+                break;
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if(optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for(i = optind; i < argc; i++) {
+        path = argv[i];
+        fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+        if(fp == NULL) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        base = strrchr(path, '/');
+        base = (base != NULL) ? base + 1 : path;
+
+        // a trace starts with its magic, anything else is read as text.
+        // stdin cannot be rewound after the probe, it is always text.
+        n = (fp != stdin) ? fread(magic, 1, sizeof(magic), fp) : 0;
+        if(fp != stdin && fseek(fp, 0, SEEK_SET) != 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if(n == sizeof(magic) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+            read_trace(fp, base);
+        else
+            read_syslog(fp, base);
+        if(fp != stdin)
+            fclose(fp);
+    }
+
+    if(output == OUT_CSV)
+        print_csv();
+    else if(output == OUT_JSON)
+        print_json();
+    else
+        print_table();
+    return EXIT_SUCCESS;
+}
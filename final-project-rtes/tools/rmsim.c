@@ -0,0 +1,551 @@
+/**
+*
+* This is the offline rate monotonic schedule simulator. It replays the
+* fixed priority preemptive schedule of the periodic services over many
+* hyperperiods, drawing every job's execution time from the distribution
+* measured on the target, and reports the response time percentiles and
+* the deadline miss probability of every service. A rate change such as
+* selection at 20 Hz or capture at 50 Hz can be tried here before it costs
+* an hour of camera time.
+*
+* The service table starts from the defaults of main.c and takes the same
+* config files and service lines as the synchronome (-c and -s), so
+* "-s 'capture period=20'" is capture at 50 Hz. Priorities are derived the
+* same way, rate monotonic unless given, and every service runs on the
+* first core of its list. Releases follow the sequencer's table, all
+* periods start together at 0, and the deadline is the next release.
+*
+* The overload policies act as in the services: a job ending with its next
+* release pending is a miss, skip drops the pending releases, decimate
+* runs every 2^level-th release only and shed raises the level only, the
+* measured times already mix the cheaper kernels in.
+*
+* Execution times, per service, first match wins:
+*   -e NAME=MS  a fixed time
+*   trace       exec_ns of every job_end event of files recorded with --trace,
+*               sampled as recorded, pool instances ("writeback/1") pooled
+*   syslog      the "Exec NAME: ... min= avg= max= p99=" end of run summary,
+*               sampled from a piecewise linear distribution through
+*               min, avg (as the median), p99 and max
+*   otherwise   the configured WCET of the service
+*
+* Usage: rmsim [-c FILE] [-s LINE] [-e NAME=MS] [-n HYPERPERIODS] [-S SEED] [FILE...]
+*
+* Build: make tools
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "../includes/services.h"
+#include "../includes/analysis.h"
+#include "../includes/schedule.h"
+#include "../includes/trace.h"
+#include "../includes/histogram.h"
+
+#define RMSIM_PRIO_MAX         (99)             // SCHED_FIFO maximum, left to the sequencer
+#define RMSIM_HYPERPERIODS     (1000)
+#define RMSIM_MAX_PENDING      (256)            // releases queued on one service semaphore
+#define TRACE_BLOCK            (65536)          // records read at once
+
+typedef enum { EXEC_WCET, EXEC_FIXED, EXEC_TRACE, EXEC_SUMMARY } exec_source_t;
+
+static const char *source_names[] = { "wcet", "fixed", "trace", "summary" };
+
+// Execution time distribution of one service
+typedef struct {
+  exec_source_t source;
+  long long fixed_ns;
+  uint32_t *samples;                           // EXEC_TRACE
+  size_t nsamples;
+  size_t capacity;
+  long long min_ns, avg_ns, p99_ns, max_ns;    // EXEC_SUMMARY
+}exec_dist_t;
+
+// Simulated state and results of one periodic service
+typedef struct {
+  service_desc_t *svc;
+  exec_dist_t *exec;
+  int core;
+  long long period_ns;
+  long long next_release_ns;
+  long long pending_ns[RMSIM_MAX_PENDING];     // release times waiting, oldest first
+  int head;
+  int pending;
+  bool running;                                // head job started, remaining_ns is set
+  long long remaining_ns;
+  unsigned long long release;                  // release number of the head job
+  int level;
+  int on_time;
+  // results
+  unsigned long long releases;
+  unsigned long long jobs;
+  unsigned long long misses;
+  unsigned long long skipped;
+  unsigned long long decimated;
+  unsigned long long overflows;                // releases beyond RMSIM_MAX_PENDING
+  int max_level;
+  long long busy_ns;
+  histogram_t response;
+}sim_service_t;
+
+static service_table_t table;
+static exec_dist_t dists[SERVICE_MAX];
+static sim_service_t sims[SERVICE_MAX];
+static int nsims = 0;
+static uint64_t rng_state = 0x5eed5eed5eedULL;
+
+// xorshift64*, reproducible for a given seed
+static double uniform(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+// "writeback/1" is an instance of writeback
+static exec_dist_t *find_dist(const char *name, size_t length) {
+    int i;
+
+    for(i = 0; i < table.count; i++) {
+        if(strlen(table.services[i].name) == length && strncmp(table.services[i].name, name, length) == 0)
+            return &dists[i];
+    }
+    return NULL;
+}
+
+static void add_sample(exec_dist_t *dist, long long ns) {
+    uint32_t *grown;
+
+    // a fixed time wins, a trace beats a summary of the same runs
+    if(dist->source == EXEC_FIXED)
+        return;
+    dist->source = EXEC_TRACE;
+    if(dist->nsamples == dist->capacity) {
+        dist->capacity = dist->capacity ? dist->capacity * 2 : 4096;
+        grown = (uint32_t *)realloc(dist->samples, dist->capacity * sizeof(uint32_t));
+        if(grown == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        dist->samples = grown;
+    }
+    dist->samples[dist->nsamples++] = (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)ns;
+}
+
+static long long draw_exec(const exec_dist_t *dist, const service_desc_t *svc) {
+    double u;
+
+    switch(dist->source) {
+        case EXEC_FIXED:
+            return dist->fixed_ns;
+        case EXEC_TRACE:
+            return dist->samples[(size_t)(uniform() * dist->nsamples)];
+        case EXEC_SUMMARY:
+            u = uniform();
+            if(u < 0.5)
+                return dist->min_ns + (long long)((dist->avg_ns - dist->min_ns) * (u / 0.5));
+            if(u < 0.99)
+                return dist->avg_ns + (long long)((dist->p99_ns - dist->avg_ns) * ((u - 0.5) / 0.49));
+            return dist->p99_ns + (long long)((dist->max_ns - dist->p99_ns) * ((u - 0.99) / 0.01));
+        default:
+            return svc->wcet_us * 1000LL;
+    }
+}
+
+static long long worst_exec(const exec_dist_t *dist, const service_desc_t *svc) {
+    long long worst = 0;
+    size_t i;
+
+    switch(dist->source) {
+        case EXEC_FIXED:
+            return dist->fixed_ns;
+        case EXEC_TRACE:
+            for(i = 0; i < dist->nsamples; i++)
+                if(dist->samples[i] > worst)
+                    worst = dist->samples[i];
+            return worst;
+        case EXEC_SUMMARY:
+            return dist->max_ns;
+        default:
+            return svc->wcet_us * 1000LL;
+    }
+}
+
+/*
+ * inputs
+ */
+
+static void read_trace(FILE *fp, const char *file) {
+    trace_file_header_t header;
+    trace_record_t *block;
+    exec_dist_t *ring_dist[TRACE_MAX_RINGS];
+    bool ring_known[TRACE_MAX_RINGS];
+    const trace_record_t *rec;
+    const char *slash;
+    size_t count, i;
+
+    if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", file);
+        return;
+    }
+    if(header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: trace version %u, expected %d\n", file, header.version, TRACE_VERSION);
+        return;
+    }
+    if(header.nrings > TRACE_MAX_RINGS)
+        header.nrings = TRACE_MAX_RINGS;
+    memset(ring_known, 0, sizeof(ring_known));
+
+    block = (trace_record_t *)malloc(TRACE_BLOCK * sizeof(trace_record_t));
+    if(block == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    while((count = fread(block, sizeof(trace_record_t), TRACE_BLOCK, fp)) > 0) {
+        for(i = 0; i < count; i++) {
+            rec = &block[i];
+            if(rec->id != TRACE_JOB_END || rec->ring >= header.nrings)
+                continue;
+            if(!ring_known[rec->ring]) {
+                header.names[rec->ring][TRACE_NAME_LENGTH - 1] = '\0';
+                slash = strchr(header.names[rec->ring], '/');
+                ring_dist[rec->ring] = find_dist(header.names[rec->ring], slash ? (size_t)(slash - header.names[rec->ring])
+                                                                               : strlen(header.names[rec->ring]));
+                ring_known[rec->ring] = true;
+            }
+            if(ring_dist[rec->ring] != NULL)
+                add_sample(ring_dist[rec->ring], rec->arg1);
+        }
+    }
+    free(block);
+}
+
+// "Exec NAME: jobs=%llu min=%lld avg=%lld max=%lld p99=%lld ns", a later run overrides an earlier one
+static void read_syslog(FILE *fp) {
+    char *line = NULL, *start, *colon;
+    size_t capacity = 0;
+    unsigned long long jobs;
+    long long min, avg, max, p99;
+    exec_dist_t *dist;
+
+    while(getline(&line, &capacity, fp) >= 0) {
+        start = strstr(line, "Exec ");
+        if(start == NULL)
+            continue;
+        start += strlen("Exec ");
+        colon = strchr(start, ':');
+        if(colon == NULL || sscanf(colon + 1, " jobs=%llu min=%lld avg=%lld max=%lld p99=%lld",
+                                   &jobs, &min, &avg, &max, &p99) != 5 || jobs == 0)
+            continue;
+        dist = find_dist(start, colon - start);
+        if(dist == NULL || dist->source == EXEC_FIXED || dist->source == EXEC_TRACE)
+            continue;
+        dist->source = EXEC_SUMMARY;
+        dist->min_ns = min;
+        dist->avg_ns = (avg < min) ? min : avg;
+        dist->p99_ns = (p99 < dist->avg_ns) ? dist->avg_ns : p99;
+        dist->max_ns = (max < dist->p99_ns) ? dist->p99_ns : max;
+    }
+    free(line);
+}
+
+/*
+ * simulation
+ */
+
+static void release(sim_service_t *s, long long now) {
+    int tail;
+
+    s->releases++;
+    if(s->pending == RMSIM_MAX_PENDING) {
+        s->overflows++;
+        return;
+    }
+    tail = (s->head + s->pending) % RMSIM_MAX_PENDING;
+    s->pending_ns[tail] = now;
+    s->pending++;
+}
+
+static void pop(sim_service_t *s) {
+    s->head = (s->head + 1) % RMSIM_MAX_PENDING;
+    s->pending--;
+    s->release++;
+    s->running = false;
+}
+
+// the job of s ends at now, with the overload policy applied as in service_job_end()
+static void complete(sim_service_t *s, long long now) {
+    histogram_record(&s->response, now - s->pending_ns[s->head]);
+    s->jobs++;
+    pop(s);
+    if(s->pending > 0) {
+        s->misses++;
+        s->on_time = 0;
+        if(s->svc->overload == SERVICE_OVERLOAD_SKIP) {
+            s->skipped += s->pending;
+            s->release += s->pending;
+            s->head = (s->head + s->pending) % RMSIM_MAX_PENDING;
+            s->pending = 0;
+        } else if((s->svc->overload == SERVICE_OVERLOAD_SHED || s->svc->overload == SERVICE_OVERLOAD_DECIMATE) &&
+                  s->level < SERVICE_MAX_DEGRADE) {
+            s->level++;
+            if(s->level > s->max_level)
+                s->max_level = s->level;
+        }
+    } else if((s->level > 0) && (++s->on_time >= SERVICE_RECOVER_JOBS)) {
+        s->level--;
+        s->on_time = 0;
+    }
+}
+
+// highest priority pending job of a core, the running one keeps the core against equals
+static sim_service_t *dispatch(int core) {
+    sim_service_t *best = NULL, *s;
+    int i, prio, best_prio = -1;
+
+    for(i = 0; i < nsims; i++) {
+        s = &sims[i];
+        if(s->core != core || s->pending == 0)
+            continue;
+        prio = s->svc->effective_priority;
+        if(best == NULL || prio > best_prio ||
+           (prio == best_prio && !best->running &&
+            (s->running || s->pending_ns[s->head] < best->pending_ns[best->head]))) {
+            best = s;
+            best_prio = prio;
+        }
+    }
+    return best;
+}
+
+static void simulate(long long end_ns) {
+    sim_service_t *running[SERVICE_MAX], *s;
+    long long now = 0, next;
+    int i, c;
+
+    while(now < end_ns) {
+        // start or resume the job each core runs now, decimated releases end at once
+        for(i = 0; i < nsims; i++) {
+            running[i] = NULL;
+            while((s = dispatch(sims[i].core)) != NULL && !s->running) {
+                if((s->svc->overload == SERVICE_OVERLOAD_DECIMATE) &&
+                   ((s->release & ((1ULL << s->level) - 1)) != 0)) {
+                    s->decimated++;
+                    pop(s);
+                    continue;
+                }
+                s->running = true;
+                s->remaining_ns = draw_exec(s->exec, s->svc);
+            }
+            running[i] = s;
+        }
+
+        // advance to the next release or completion
+        next = end_ns;
+        for(i = 0; i < nsims; i++) {
+            if(sims[i].next_release_ns < next)
+                next = sims[i].next_release_ns;
+            if(running[i] != NULL && now + running[i]->remaining_ns < next)
+                next = now + running[i]->remaining_ns;
+        }
+        for(i = 0; i < nsims; i++) {
+            s = running[i];
+            if(s == NULL)
+                continue;
+            // a core shared by several services is listed once per service
+            for(c = 0; c < i; c++)
+                if(running[c] == s)
+                    break;
+            if(c < i)
+                continue;
+            s->remaining_ns -= next - now;
+            s->busy_ns += next - now;
+            if(s->remaining_ns <= 0)
+                complete(s, next);
+        }
+        now = next;
+        for(i = 0; i < nsims; i++) {
+            if(sims[i].next_release_ns == now) {
+                release(&sims[i], now);
+                sims[i].next_release_ns += sims[i].period_ns;
+            }
+        }
+    }
+}
+
+/*
+ * output
+ */
+
+static void report(unsigned long long hyperperiod_us, int hyperperiods) {
+    analysis_result_t results[SERVICE_MAX];
+    analysis_core_t cores[SERVICE_MAX];
+    const analysis_result_t *rta;
+    histogram_summary_t r;
+    sim_service_t *s;
+    long long busy;
+    int nresults, ncores, i, j;
+    double seconds = hyperperiod_us * 1e-6 * hyperperiods;
+
+    analysis_run(&table, results, &nresults, cores, &ncores);
+
+    printf("Simulated %d hyperperiods of %.3f ms, %.1f s\n", hyperperiods, hyperperiod_us / 1000.0, seconds);
+    for(i = 0; i < ncores; i++) {
+        busy = 0;
+        for(j = 0; j < nsims; j++)
+            if(sims[j].core == cores[i].core)
+                busy += sims[j].busy_ns;
+        printf("  core %d: U=%.3f worst case, %.3f simulated\n", cores[i].core, cores[i].utilization,
+               busy / (seconds * 1e9));
+    }
+    printf("Response time (ms):\n");
+    printf("  %-16s %4s %4s %9s %-7s %9s %9s %9s %9s %9s %9s %9s %11s\n", "name", "core", "prio", "period",
+           "exec", "jobs", "p50", "p99", "p99.9", "max", "RTA", "misses", "miss prob");
+    for(i = 0; i < nsims; i++) {
+        s = &sims[i];
+        histogram_summarize(&s->response, &r);
+        rta = NULL;
+        for(j = 0; j < nresults; j++)
+            if(results[j].svc == s->svc)
+                rta = &results[j];
+        printf("  %-16s %4d %4d %9.3f %-7s %9llu %9.3f %9.3f %9.3f %9.3f ", s->svc->name, s->core,
+               s->svc->effective_priority, s->period_ns / 1e6, source_names[s->exec->source], s->jobs,
+               r.p50 / 1e6, r.p99 / 1e6, r.p999 / 1e6, r.max / 1e6);
+        if(rta != NULL && rta->response_ns >= 0)
+            printf("%9.3f ", rta->response_ns / 1e6);
+        else
+            printf("%9s ", "> T");
+        printf("%9llu %10.4f%%\n", s->misses, s->releases ? 100.0 * s->misses / s->releases : 0.0);
+        if(s->skipped || s->decimated || s->max_level || s->overflows)
+            printf("  %-16s %s: %llu releases skipped, %llu decimated, max level %d, %llu beyond the queue\n", "",
+                   (s->svc->overload == SERVICE_OVERLOAD_SKIP) ? "skip" :
+                   (s->svc->overload == SERVICE_OVERLOAD_SHED) ? "shed" :
+                   (s->svc->overload == SERVICE_OVERLOAD_DECIMATE) ? "decimate" : "none",
+                   s->skipped, s->decimated, s->max_level, s->overflows);
+    }
+    printf("  RTA is the exact worst case response with the largest execution time of each service\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c FILE] [-s LINE] [-e NAME=MS] [-n HYPERPERIODS] [-S SEED] [FILE...]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    schedule_service_t periodic[SCHEDULE_MAX_SERVICES];
+    schedule_t schedule;
+    char magic[sizeof(((trace_file_header_t *)0)->magic)];
+    exec_dist_t *dist;
+    service_desc_t *svc;
+    sim_service_t *s;
+    char *equals;
+    const char *path;
+    long long worst;
+    int hyperperiods = RMSIM_HYPERPERIODS;
+    int c, i, n;
+    size_t got;
+    FILE *fp;
+
+    services_add_defaults(&table, NULL);
+    while((c = getopt(argc, argv, "c:s:e:n:S:h")) != -1) {
+        switch(c) {
+            case 'c':
+                if(services_load_config(&table, optarg) < 0)
+                    return EXIT_FAILURE;
+                break;
+            case 's':
+                if(services_parse_line(&table, optarg) < 0)
+                    return EXIT_FAILURE;
+                break;
+            case 'e':
+                equals = strchr(optarg, '=');
+                dist = (equals != NULL) ? find_dist(optarg, equals - optarg) : NULL;
+                if(dist == NULL || atof(equals + 1) <= 0) {
+                    fprintf(stderr, "-e needs NAME=MS of a service in the table\n");
+                    return EXIT_FAILURE;
+                }
+                dist->source = EXEC_FIXED;
+                dist->fixed_ns = (long long)(atof(equals + 1) * 1e6);
+                break;
+            case 'n':
+                hyperperiods = atoi(optarg);
+                if(hyperperiods <= 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                rng_state = strtoull(optarg, NULL, 0) | 1;
+                break;
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for(i = optind; i < argc; i++) {
+        path = argv[i];
+        fp = fopen(path, "rb");
+        if(fp == NULL) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        got = fread(magic, 1, sizeof(magic), fp);
+        rewind(fp);
+        if(got == sizeof(magic) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+            read_trace(fp, path);
+        else
+            read_syslog(fp);
+        fclose(fp);
+    }
+
+    // the same priorities and release table the synchronome would run with
+    services_assign_priorities(&table, RMSIM_PRIO_MAX);
+    for(i = 0, n = 0; i < table.count; i++) {
+        svc = &table.services[i];
+        if(svc->period_us == 0)
+            continue;
+        periodic[n].name = svc->name;
+        periodic[n].period_us = svc->period_us;
+        periodic[n].release = &svc->release;
+        n++;
+    }
+    if(n == 0 || schedule_build(&schedule, periodic, n) < 0) {
+        fprintf(stderr, "no schedule to simulate\n");
+        return EXIT_FAILURE;
+    }
+    services_print(&table);
+
+    for(i = 0; i < table.count; i++) {
+        svc = &table.services[i];
+        if(svc->period_us == 0 || svc->policy == SERVICE_POLICY_OTHER || svc->policy == SERVICE_POLICY_DEADLINE)
+            continue;
+        s = &sims[nsims++];
+        memset(s, 0, sizeof(*s));
+        s->svc = svc;
+        s->exec = &dists[i];
+        s->core = svc->cpus[0];
+        s->period_ns = svc->period_us * 1000LL;
+        histogram_reset(&s->response);
+
+        // the RTA of analysis.c works from the configured WCET, give it the worst drawn time
+        worst = worst_exec(&dists[i], svc);
+        svc->wcet_us = (unsigned int)((worst + 999) / 1000);
+    }
+    if(nsims == 0) {
+        fprintf(stderr, "no periodic SCHED_FIFO/RR service to simulate\n");
+        return EXIT_FAILURE;
+    }
+
+    simulate((long long)schedule.hyperperiod_us * 1000LL * hyperperiods);
+    report(schedule.hyperperiod_us, hyperperiods);
+    return EXIT_SUCCESS;
+}
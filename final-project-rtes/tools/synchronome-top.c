@@ -0,0 +1,181 @@
+/**
+*
+* This is a top style monitor of a running synchronome started with
+* --metrics. It maps the shared memory page read only and redraws the
+* frame rates, queue depths, deadline misses and writeback latency of the
+* pipeline, so nothing is asked of the real-time process itself.
+*
+* Usage: synchronome-top [-1] [-w] [-d SECONDS] [-n NAME]
+*   -1          print one snapshot and exit
+*   -w          wait for the page to appear instead of failing
+*   -d SECONDS  refresh interval [1]
+*   -n NAME     shared memory name [/synchronome]
+*
+* Build: make tools (or gcc -O2 -o synchronome-top tools/synchronome-top.c -lrt)
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../includes/metrics.h"
+
+#define STALE_PERIODS          (10)             // updates missed before the page is reported stale
+
+static const metrics_page_t *map_page(const char *name, bool wait) {
+    struct timespec retry = { 0, 200000000L };
+    metrics_page_t *page;
+    int fd;
+
+    while((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+        if(!wait || errno != ENOENT) {
+            fprintf(stderr, "%s: %s, is synchronome running with --metrics?\n", name, strerror(errno));
+            return NULL;
+        }
+        nanosleep(&retry, NULL);
+    }
+    page = (metrics_page_t *)mmap(NULL, sizeof(metrics_page_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(page == MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    if(page->magic != METRICS_MAGIC || page->size != sizeof(metrics_page_t) ||
+       page->version != METRICS_VERSION) {
+        fprintf(stderr, "%s: metrics version %u, expected %d\n", name, page->version, METRICS_VERSION);
+        munmap(page, sizeof(metrics_page_t));
+        return NULL;
+    }
+    return page;
+}
+
+static double ms(int64_t ns) {
+    return (double)ns / 1e6;
+}
+
+static const char *state_name(const metrics_page_t *m) {
+    struct timespec now;
+    int64_t age;
+
+    if(m->state == METRICS_STATE_FINISHED)
+        return "finished";
+    if(kill(m->pid, 0) < 0 && errno == ESRCH)
+        return "exited";
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    age = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec - m->update_mono_ns;
+    if(age > (int64_t)STALE_PERIODS * m->period_ms * 1000000LL)
+        return "stale";
+    return (m->state == METRICS_STATE_RUNNING) ? "running" : "starting";
+}
+
+static void show(const metrics_page_t *m, const char *name) {
+    const metrics_service_t *svc;
+    unsigned int i;
+
+    printf("synchronome %s  pid %d  %s  %s time %.1f s  update %llu\n\n",
+           name, m->pid, state_name(m), m->virtual_time ? "virtual" : "run",
+           (double)(m->update_ns - m->start_ns) / 1e9, (unsigned long long)m->updates);
+    printf("frames    captured %8llu  selected %6llu  written %6llu  dropped %4llu\n",
+           (unsigned long long)m->frames_captured, (unsigned long long)m->frames_queued,
+           (unsigned long long)m->frames_committed, (unsigned long long)m->frames_dropped);
+    printf("fps       capture %9.2f  written %7.2f  written avg %7.2f\n",
+           m->capture_fps, m->commit_fps, m->commit_fps_avg);
+    printf("queues    frame buffer %3d/%-3d  writeback %2d/%-2d  high water %2d  workers %d\n",
+           m->cbuf_depth, m->cbuf_capacity, m->fifo_depth, m->fifo_capacity,
+           m->fifo_high_water, m->writeback_workers);
+    printf("writeback latency  p50 %8.2f ms  p99 %8.2f ms  max %8.2f ms  (%llu frames)\n\n",
+           ms(m->writeback_p50), ms(m->writeback_p99), ms(m->writeback_max),
+           (unsigned long long)m->writeback_count);
+
+    printf("%-14s %6s %8s %8s %6s %6s %6s %5s %9s %9s %9s %9s\n",
+           "service", "period", "releases", "jobs", "misses", "skip", "decim", "level",
+           "lat p99", "lat max", "exec p99", "exec max");
+    for(i = 0; (i < m->nservices) && (i < METRICS_MAX_SERVICES); i++) {
+        svc = &m->services[i];
+        if(svc->period_us > 0)
+            printf("%-14.14s %4ums ", svc->name, svc->period_us / 1000);
+        else
+            printf("%-14.14s %6s ", svc->name, "-");
+        printf("%8llu %8llu %6llu %6llu %6llu %2d/%-2d %7.3fms %7.3fms %7.3fms %7.3fms\n",
+               (unsigned long long)svc->releases, (unsigned long long)svc->jobs,
+               (unsigned long long)svc->misses, (unsigned long long)svc->skipped,
+               (unsigned long long)svc->decimated, svc->level, svc->max_level,
+               ms(svc->latency_p99), ms(svc->latency_max), ms(svc->exec_p99), ms(svc->exec_max));
+    }
+    fflush(stdout);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-1] [-w] [-d SECONDS] [-n NAME]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *name = METRICS_DEFAULT_NAME;
+    const metrics_page_t *page;
+    metrics_page_t copy;
+    struct timespec interval;
+    bool once = false, wait = false;
+    double seconds = 1.0;
+    int c;
+
+    while((c = getopt(argc, argv, "1wd:n:h")) != -1) {
+        switch(c) {
+            case '1':
+                once = true;
+                break;
+            case 'w':
+                wait = true;
+                break;
+            case 'd':
+                seconds = atof(optarg);
+                if(seconds < 0.05)
+                    seconds = 0.05;
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if(optind != argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    page = map_page(name, wait);
+    if(page == NULL)
+        return EXIT_FAILURE;
+    interval.tv_sec = (time_t)seconds;
+    interval.tv_nsec = (long)((seconds - (double)interval.tv_sec) * 1e9);
+
+    while(1) {
+        if(metrics_read(page, &copy) < 0) {
+            fprintf(stderr, "%s: no consistent snapshot, retrying\n", name);
+        } else {
+            if(!once)
+                printf("\033[H\033[2J");
+            show(&copy, name);
+            // the publisher is gone once it wrote its final update
+            if(once || copy.state == METRICS_STATE_FINISHED)
+                break;
+            if(kill(copy.pid, 0) < 0 && errno == ESRCH)
+                break;
+        }
+        nanosleep(&interval, NULL);
+    }
+    munmap((void *)page, sizeof(metrics_page_t));
+    return EXIT_SUCCESS;
+}
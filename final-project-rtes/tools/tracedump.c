@@ -0,0 +1,390 @@
+/**
+*
+* This is the offline decoder of the binary event traces recorded with
+* --trace. It prints the events of every thread merged in time order,
+* one line per event, or converts the trace to the Chrome trace event
+* JSON format that ui.perfetto.dev and chrome://tracing open.
+*
+* Usage: tracedump [-a] [-j] [-t THREAD] FILE
+*   -a          absolute timestamps instead of seconds since the first event
+*   -j          Chrome trace event JSON: a track per thread with the jobs,
+*               V4L2, mutex wait and write slices, a track per CPU with the
+*               jobs that ran on it, and flow arrows from every release to
+*               the job it started
+*   -t THREAD   only the events of the thread named THREAD, e.g. capture
+*
+* Build: make tools (or gcc -O2 -o tracedump tools/tracedump.c)
+*
+* This program can be used and distributed without restrictions.
+*
+* Author: Deepak E Kapure
+* Project: Visual Synchronome (ECEN 5623 - Real-time Embedded Systems)
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "../includes/trace.h"
+
+typedef struct {
+  const char *name;
+  int kind;
+  const char *args[3];
+}event_info_t;
+
+#define TRACE_EVENT_INFO(id, name, kind, a0, a1, a2)   { name, kind, { a0, a1, a2 } },
+static const event_info_t event_info[TRACE_EVENT_COUNT] = {
+  TRACE_EVENTS(TRACE_EVENT_INFO)
+};
+#undef TRACE_EVENT_INFO
+
+static const char *lock_names[] = { "frame buffer", "writeback queue", "reorder buffer" };
+
+#define JSON_PID_THREADS       (1)
+#define JSON_PID_CPUS          (2)
+#define JSON_MAX_CPUS          (1024)
+
+static bool json_first = true;
+
+static void json_begin(void) {
+    printf("%s\n  {", json_first ? "" : ",");
+    json_first = false;
+}
+
+// microseconds with ns resolution, the unit of the trace event format
+static void json_ts(const char *key, long long ns) {
+    printf("\"%s\":%s%lld.%03lld", key, (ns < 0) ? "-" : "", llabs(ns) / 1000, llabs(ns) % 1000);
+}
+
+static void json_args(const event_info_t *info, const trace_record_t *rec) {
+    int64_t args[3] = { rec->arg0, rec->arg1, rec->arg2 };
+    bool first = true;
+    int k;
+
+    printf(",\"args\":{");
+    for(k = 0; k < 3; k++) {
+        if(info->args[k] == NULL)
+            continue;
+        printf("%s\"%s\":%lld", first ? "" : ",", info->args[k], (long long)args[k]);
+        first = false;
+    }
+    printf("}");
+}
+
+static void json_meta(int pid, int tid, const char *what, const char *name) {
+    json_begin();
+    printf("\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}",
+           pid, tid, what, name);
+}
+
+// Chrome trace events. Jobs are B/E slices on the thread track and a
+// complete slice on the track of the CPU they ended on, spans are complete
+// slices ending at the event, everything else is an instant. A release is
+// linked to the next job start of its service by a flow.
+static void write_json(const trace_file_header_t *header, const trace_record_t *records,
+                       size_t count, long long first_ns, const char *thread) {
+    const trace_record_t *rec;
+    const event_info_t *info;
+    long long job_start[TRACE_MAX_RINGS];
+    long long pending_post[TRACE_MAX_RINGS];
+    bool cpu_seen[JSON_MAX_CPUS] = { false };
+    char name[64];
+    size_t i;
+    int k, ring;
+
+    for(k = 0; k < TRACE_MAX_RINGS; k++) {
+        job_start[k] = -1;
+        pending_post[k] = -1;
+    }
+
+    printf("{\"displayTimeUnit\":\"ns\",\"otherData\":{\"clock\":\"%s\"},\"traceEvents\":[",
+           header->virtual_time ? "virtual" : "CLOCK_MONOTONIC_RAW");
+    json_meta(JSON_PID_THREADS, 0, "process_name", "synchronome threads");
+    json_meta(JSON_PID_CPUS, 0, "process_name", "synchronome cpus");
+    for(k = 0; k < (int)header->nrings; k++) {
+        json_meta(JSON_PID_THREADS, k, "thread_name", header->names[k]);
+        json_begin();
+        printf("\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}",
+               JSON_PID_THREADS, k, k);
+    }
+
+    for(i = 0; i < count; i++) {
+        rec = &records[i];
+        if(thread != NULL && strcmp(thread, header->names[rec->ring]) != 0)
+            continue;
+        info = &event_info[rec->id];
+        ring = rec->ring;
+
+        switch(info->kind) {
+            case TRACE_BEGIN:
+                job_start[ring] = rec->ns;
+                json_begin();
+                printf("\"ph\":\"B\",\"pid\":%d,\"tid\":%d,\"name\":\"%s %s\",",
+                       JSON_PID_THREADS, ring, header->names[ring], info->name);
+                json_ts("ts", rec->ns - first_ns);
+                json_args(info, rec);
+                printf("}");
+                // the release this job answers, skipped releases have no job
+                if(pending_post[ring] >= 0) {
+                    json_begin();
+                    printf("\"ph\":\"f\",\"bp\":\"e\",\"cat\":\"release\",\"name\":\"release\",\"id\":%lld,\"pid\":%d,\"tid\":%d,",
+                           pending_post[ring], JSON_PID_THREADS, ring);
+                    json_ts("ts", rec->ns - first_ns);
+                    printf("}");
+                    pending_post[ring] = -1;
+                }
+                break;
+
+            case TRACE_END:
+                // a job of a best effort service has no begin event
+                if(job_start[ring] < 0)
+                    break;
+                json_begin();
+                printf("\"ph\":\"E\",\"pid\":%d,\"tid\":%d,", JSON_PID_THREADS, ring);
+                json_ts("ts", rec->ns - first_ns);
+                json_args(info, rec);
+                printf("}");
+                if(rec->arg2 >= 0 && rec->arg2 < JSON_MAX_CPUS) {
+                    cpu_seen[rec->arg2] = true;
+                    json_begin();
+                    printf("\"ph\":\"X\",\"pid\":%d,\"tid\":%lld,\"name\":\"%s\",",
+                           JSON_PID_CPUS, (long long)rec->arg2, header->names[ring]);
+                    json_ts("ts", job_start[ring] - first_ns);
+                    printf(",");
+                    json_ts("dur", rec->ns - job_start[ring]);
+                    json_args(info, rec);
+                    printf("}");
+                }
+                job_start[ring] = -1;
+                break;
+
+            case TRACE_SPAN:
+                if(rec->id == TRACE_LOCK_WAIT && rec->arg0 >= 0 && rec->arg0 < 3)
+                    snprintf(name, sizeof(name), "%s %s", info->name, lock_names[rec->arg0]);
+                else
+                    snprintf(name, sizeof(name), "%s", info->name);
+                json_begin();
+                printf("\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",", JSON_PID_THREADS, ring, name);
+                json_ts("ts", rec->ns - rec->arg1 - first_ns);
+                printf(",");
+                json_ts("dur", rec->arg1);
+                json_args(info, rec);
+                printf("}");
+                break;
+
+            default:
+                json_begin();
+                printf("\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",",
+                       JSON_PID_THREADS, ring, info->name);
+                json_ts("ts", rec->ns - first_ns);
+                json_args(info, rec);
+                printf("}");
+                if(rec->id == TRACE_SEM_POST && rec->arg0 >= 0 && rec->arg0 < (int)header->nrings) {
+                    json_begin();
+                    printf("\"ph\":\"s\",\"cat\":\"release\",\"name\":\"release\",\"id\":%zu,\"pid\":%d,\"tid\":%d,",
+                           i, JSON_PID_THREADS, ring);
+                    json_ts("ts", rec->ns - first_ns);
+                    printf("}");
+                    pending_post[rec->arg0] = (long long)i;
+                }
+                break;
+        }
+    }
+
+    for(k = 0; k < JSON_MAX_CPUS; k++) {
+        if(!cpu_seen[k])
+            continue;
+        snprintf(name, sizeof(name), "cpu %d", k);
+        json_meta(JSON_PID_CPUS, k, "thread_name", name);
+    }
+    printf("\n]}\n");
+}
+
+// Merge the rings in time order. The records of one ring are in the file
+// in the order they were recorded, so events of the same time, common in
+// virtual time, keep that order. Across rings the sequencer goes first,
+// its releases precede the jobs they start.
+static trace_record_t *merge_rings(const trace_record_t *records, size_t *count,
+                                   const trace_file_header_t *header) {
+    size_t start[TRACE_MAX_RINGS + 1] = { 0 }, next[TRACE_MAX_RINGS];
+    trace_record_t *bucketed, *merged;
+    size_t i, n = 0;
+    int k, best, order[TRACE_MAX_RINGS], norder = 0;
+
+    bucketed = (trace_record_t *)malloc((*count + 1) * sizeof(trace_record_t));
+    merged = (trace_record_t *)malloc((*count + 1) * sizeof(trace_record_t));
+    if(bucketed == NULL || merged == NULL)
+        return NULL;
+
+    // stable counting sort by ring, bad records are dropped
+    for(i = 0; i < *count; i++) {
+        if(records[i].ring < header->nrings && records[i].id < TRACE_EVENT_COUNT)
+            start[records[i].ring + 1]++;
+    }
+    for(k = 0; k < TRACE_MAX_RINGS; k++)
+        start[k + 1] += start[k];
+    memcpy(next, start, sizeof(next));
+    for(i = 0; i < *count; i++) {
+        if(records[i].ring < header->nrings && records[i].id < TRACE_EVENT_COUNT)
+            bucketed[next[records[i].ring]++] = records[i];
+    }
+
+    for(k = 0; k < (int)header->nrings; k++) {
+        if(strcmp(header->names[k], "sequencer") == 0)
+            order[norder++] = k;
+    }
+    for(k = 0; k < (int)header->nrings; k++) {
+        if(strcmp(header->names[k], "sequencer") != 0)
+            order[norder++] = k;
+    }
+
+    memcpy(next, start, sizeof(next));
+    while(1) {
+        best = -1;
+        for(k = 0; k < norder; k++) {
+            if(next[order[k]] == start[order[k] + 1])
+                continue;
+            if(best < 0 || bucketed[next[order[k]]].ns < bucketed[next[best]].ns)
+                best = order[k];
+        }
+        if(best < 0)
+            break;
+        merged[n++] = bucketed[next[best]++];
+    }
+    if(n < *count)
+        fprintf(stderr, "%zu bad records skipped\n", *count - n);
+    *count = n;
+    free(bucketed);
+    return merged;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-a] [-j] [-t THREAD] FILE\n", prog);
+}
+
+int main(int argc, char **argv) {
+    trace_file_header_t header;
+    trace_record_t *records = NULL, *merged;
+    const trace_record_t *rec;
+    const event_info_t *info;
+    const char *thread = NULL;
+    bool absolute = false, json = false;
+    size_t count = 0, capacity = 0, i;
+    unsigned long long dropped = 0;
+    long long first_ns;
+    double ts;
+    FILE *fp;
+    int c, k;
+    int64_t args[3];
+
+    while((c = getopt(argc, argv, "ajt:h")) != -1) {
+        switch(c) {
+            case 'a':
+                absolute = true;
+                break;
+            case 'j':
+                json = true;
+                break;
+            case 't':
+                thread = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if(optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    fp = fopen(argv[optind], "rb");
+    if(fp == NULL) {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if(fread(&header, sizeof(header), 1, fp) != 1 ||
+       memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if(header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: trace version %u, expected %d\n", argv[optind], header.version, TRACE_VERSION);
+        return EXIT_FAILURE;
+    }
+    if(header.nrings > TRACE_MAX_RINGS)
+        header.nrings = TRACE_MAX_RINGS;
+
+    // the whole trace is sorted in memory, one run is a few MB at most
+    while(1) {
+        if(count == capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            records = (trace_record_t *)realloc(records, capacity * sizeof(trace_record_t));
+            if(records == NULL) {
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        i = fread(&records[count], sizeof(trace_record_t), capacity - count, fp);
+        count += i;
+        if(count < capacity)
+            break;
+    }
+    fclose(fp);
+    merged = merge_rings(records, &count, &header);
+    if(merged == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    free(records);
+    records = merged;
+
+    // time zero is the earliest event, or the start of a slice before it
+    first_ns = (count > 0) ? records[0].ns : 0;
+    for(i = 0; i < count && !absolute; i++) {
+        if(event_info[records[i].id].kind == TRACE_SPAN && records[i].ns - records[i].arg1 < first_ns)
+            first_ns = records[i].ns - records[i].arg1;
+    }
+    if(absolute)
+        first_ns = 0;
+
+    if(json) {
+        write_json(&header, records, count, first_ns, thread);
+        free(records);
+        return EXIT_SUCCESS;
+    }
+
+    printf("# %zu events from %u threads, %s time\n", count, header.nrings,
+           header.virtual_time ? "virtual" : "real");
+    for(k = 0; k < (int)header.nrings; k++) {
+        printf("#   ring %2d %-*s dropped %llu\n", k, TRACE_NAME_LENGTH, header.names[k],
+               (unsigned long long)header.dropped[k]);
+        dropped += header.dropped[k];
+    }
+    if(dropped > 0)
+        printf("# %llu events were lost to full rings\n", dropped);
+
+    for(i = 0; i < count; i++) {
+        rec = &records[i];
+        if(thread != NULL && strcmp(thread, header.names[rec->ring]) != 0)
+            continue;
+
+        info = &event_info[rec->id];
+        ts = (double)(rec->ns - first_ns) / 1000000000.0;
+        printf("%16.6f %-16s %-18s", ts, header.names[rec->ring], info->name);
+        args[0] = rec->arg0;
+        args[1] = rec->arg1;
+        args[2] = rec->arg2;
+        for(k = 0; k < 3; k++) {
+            if(info->args[k] != NULL)
+                printf(" %s=%lld", info->args[k], (long long)args[k]);
+        }
+        printf("\n");
+    }
+
+    free(records);
+    return EXIT_SUCCESS;
+}